@@ -76,7 +76,12 @@ void AOccupancyGridTest::BeginPlay()
 	
 	if (debug_ocgrid_)
 	{
-		ocgrid_.Initialize(5000.0f);
+		naga::OccupancyLogOddsParam log_odds_param;
+		log_odds_param.prior = debug_ocgrid_log_odds_prior_;
+		log_odds_param.occupied_threshold = debug_ocgrid_log_odds_threshold_;
+		log_odds_param.hit = debug_ocgrid_log_odds_hit_;
+		log_odds_param.miss = debug_ocgrid_log_odds_miss_;
+		ocgrid_.Initialize(5000.0f, debug_ocgrid_log_odds_, log_odds_param);
 	}
 }
 
@@ -337,6 +342,9 @@ void AOccupancyGridTest::Tick(float DeltaTime)
 		// パーティクルを投入テスト.
 		ocgrid_.AddParticleTest(view_location + view_dir * 100.0f + view_up * -0.0f + view_right * 50.0f, view_dir * 1000.0f);
 
+		// Grid範囲を視点に追従.
+		ocgrid_.MoveGridCenter(view_location);
+
 		// Occupancyをコリジョンレイで更新.
 		ocgrid_.UpdateOccupancy(view_location, hit_samples);
 
@@ -106,6 +106,17 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 		bool debug_ocgrid_ = false;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		bool debug_ocgrid_log_odds_ = false;
+	// LogOddsカウンタの更新パラメータ. 閾値は prior + hit より大きくする.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int debug_ocgrid_log_odds_prior_ = 6;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int debug_ocgrid_log_odds_threshold_ = 10;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int debug_ocgrid_log_odds_hit_ = 3;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int debug_ocgrid_log_odds_miss_ = 1;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 		bool debug_draw_ocgrid_ = false;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
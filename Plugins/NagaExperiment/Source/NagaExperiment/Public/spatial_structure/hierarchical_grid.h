@@ -18,6 +18,7 @@
 #include <assert.h>
 #include <chrono>
 #include <array>
+#include <atomic>
 #include <tuple>
 #include <bitset>
 #include <unordered_map>
@@ -348,7 +349,7 @@ namespace naga
 			root_cell_width_ = cell_width;
 			root_cell_width_inv_ = 1.0f / cell_width;
 		
-			// 移動によるシフトコピーなどは後で.
+			// 移動はMoveGridCenterで行う.
 			grid_center_pos_ws_ = {};
 			this->grid_aabb_min_wgs_ = math::FVectorFloorToInt(grid_center_pos_ws_ * root_cell_width_inv_ - (k_root_grid_reso / 2.0f));
 			grid_aabb_min_ws_ = FVector(this->grid_aabb_min_wgs_) * root_cell_width_;
@@ -375,9 +376,64 @@ namespace naga
 		{
 			return math::IsInnerWithPositive(cell, FIntVector(k_root_grid_reso - 1));
 		}
+		// ワールドグリッド座標をRootCell配列上の座標へ折り返す.
+		static constexpr int WrapRootCellCoord(int v)
+		{
+			return ((v % k_root_grid_reso) + k_root_grid_reso) % k_root_grid_reso;
+		}
+		// RootGridSpaceのCell座標からRootCellデータのインデックスを計算.
+		//	Grid移動時にRootCellデータのコピーが不要なように, ワールドグリッド座標で折り返したトーラス状の配置とする.
 		constexpr int CalcRootCellIndex(const FIntVector& root_cell_id) const
 		{
-			return root_cell_id.X + (root_cell_id.Y * k_root_grid_reso) + (root_cell_id.Z * k_root_grid_reso * k_root_grid_reso);
+			const int x = WrapRootCellCoord(root_cell_id.X + grid_aabb_min_wgs_.X);
+			const int y = WrapRootCellCoord(root_cell_id.Y + grid_aabb_min_wgs_.Y);
+			const int z = WrapRootCellCoord(root_cell_id.Z + grid_aabb_min_wgs_.Z);
+			return x + (y * k_root_grid_reso) + (z * k_root_grid_reso * k_root_grid_reso);
+		}
+
+		// Grid中心の移動. RootCell単位で移動し, Grid範囲外となったRootCellのデータを解放して無効化する.
+		//	RootCellデータはトーラス状に配置されているため, 範囲内に残るRootCellのデータは移動やコピーが不要. 範囲外となったRootCellのデータ位置は新たに範囲に入ったRootCellで再利用される.
+		//	release_root_cell_data	: 無効化するRootCellのデータを受け取る関数オブジェクト. 無効値のRootCellでは呼ばれない.
+		//	戻り値 : Grid範囲が移動した場合はtrue.
+		template<typename ReleaseRootCellDataFunc>
+		bool MoveGridCenter(const FVector& center_pos_ws, ReleaseRootCellDataFunc&& release_root_cell_data)
+		{
+			const FIntVector new_aabb_min_wgs = math::FVectorFloorToInt(center_pos_ws * root_cell_width_inv_ - (k_root_grid_reso / 2.0f));
+			grid_center_pos_ws_ = center_pos_ws;
+			if (new_aabb_min_wgs == grid_aabb_min_wgs_)
+				return false;
+
+			// 現在のRootGridSpaceの各軸座標について, 移動後の範囲外になるかのテーブル.
+			const FIntVector shift = new_aabb_min_wgs - grid_aabb_min_wgs_;
+			std::array<bool, k_root_grid_reso> is_out_x, is_out_y, is_out_z;
+			for (int i = 0; i < k_root_grid_reso; ++i)
+			{
+				is_out_x[i] = (0 > i - shift.X || k_root_grid_reso <= i - shift.X);
+				is_out_y[i] = (0 > i - shift.Y || k_root_grid_reso <= i - shift.Y);
+				is_out_z[i] = (0 > i - shift.Z || k_root_grid_reso <= i - shift.Z);
+			}
+			for (int z = 0; z < k_root_grid_reso; ++z)
+			{
+				for (int y = 0; y < k_root_grid_reso; ++y)
+				{
+					for (int x = 0; x < k_root_grid_reso; ++x)
+					{
+						if (!is_out_x[x] && !is_out_y[y] && !is_out_z[z])
+							continue;
+
+						auto& root_data = root_cell_data_[CalcRootCellIndex(FIntVector(x, y, z))];
+						if (~0u != root_data)
+						{
+							release_root_cell_data(root_data);
+							root_data = ~0u;
+						}
+					}
+				}
+			}
+
+			grid_aabb_min_wgs_ = new_aabb_min_wgs;
+			grid_aabb_min_ws_ = FVector(grid_aabb_min_wgs_) * root_cell_width_;
+			return true;
 		}
 
 		// DDAによるトレース. Cell到達順はRay始点に近い順.
@@ -678,10 +734,180 @@ namespace naga
 		{
 			Set<false>(x, y, z);
 		}
+		static constexpr uint64_t CalcBitMask(int x, int y, int z)
+		{
+			return uint64_t(1) << (x + (y << 2) + (z << 4));
+		}
+		// 並列書き込み版. 同一Brickの他ビットへの並列書き込みと競合しない. 戻り値は書き込み前の値.
+		template<bool SetBit>
+		uint64_t SetAtomic(int x, int y, int z)
+		{
+			const uint64_t bit = CalcBitMask(x, y, z);
+			volatile int64* p_dst = reinterpret_cast<volatile int64*>(&occupancy_4x4x4);
+			if constexpr (SetBit)
+			{
+				return static_cast<uint64_t>(FPlatformAtomics::InterlockedOr(p_dst, static_cast<int64>(bit)));
+			}
+			else
+			{
+				return static_cast<uint64_t>(FPlatformAtomics::InterlockedAnd(p_dst, static_cast<int64>(~bit)));
+			}
+		}
+		uint64_t Set1Atomic(int x, int y, int z)
+		{
+			return SetAtomic<true>(x, y, z);
+		}
+		uint64_t Set0Atomic(int x, int y, int z)
+		{
+			return SetAtomic<false>(x, y, z);
+		}
 
 		uint64_t occupancy_4x4x4 = {};
 	};
 
+	// 確率的Occupancy更新のパラメータ. カウンタは[0, OccupancyGridLeafLogOdds::k_counter_max].
+	struct OccupancyLogOddsParam
+	{
+		// 未観測の要素の初期値. 閾値未満のため非占有扱い.
+		int prior = 6;
+		// この値以上を占有とする. 単発のノイズで占有とならないよう prior + hit より大きくし, 占有には複数回のヒットを要する.
+		int occupied_threshold = 10;
+		// ヒットで加算, ミスで減算する値. 飽和した要素の除去には複数回のミスが必要.
+		int hit = 3;
+		int miss = 1;
+	};
+
+	// 確率的Occupancy用のBrick. 4x4x4要素それぞれに4bitのLogOddsカウンタを持つ.
+	//	カウンタはヒットで加算, ミスで減算して[0, k_counter_max]にクランプする. OccupancyLogOddsParam::occupied_threshold以上を占有とする.
+	//	トレースには閾値判定から導出したOccupancyGridLeafDataのビットを使用する.
+	struct OccupancyGridLeafLogOdds
+	{
+		static constexpr int k_counter_max = 15;
+
+		// 全要素をpriorで初期化.
+		void Reset(int prior)
+		{
+			const uint64_t fill = 0x1111111111111111ull * static_cast<uint64_t>(prior & 0xf);
+			for (auto& e : counter_4bit)
+				e = fill;
+		}
+
+		int Get(int x, int y, int z) const
+		{
+			const int s = x + (y << 2) + (z << 4);
+			return static_cast<int>((counter_4bit[s >> 4] >> ((s & 15) * 4)) & 0xf);
+		}
+		// 全要素のカウンタがvalue以下か.
+		bool IsAllLessEqual(int value) const
+		{
+			for (const auto e : counter_4bit)
+			{
+				for (int shift = 0; shift < 64; shift += 4)
+				{
+					if (value < static_cast<int>((e >> shift) & 0xf))
+						return false;
+				}
+			}
+			return true;
+		}
+		// カウンタを加算して[0, k_counter_max]にクランプする. 並列書き込み可能. 戻り値は書き込み前のカウンタ値.
+		int AddAtomic(int x, int y, int z, int delta)
+		{
+			const int s = x + (y << 2) + (z << 4);
+			const int shift = (s & 15) * 4;
+			volatile int64* p_dst = reinterpret_cast<volatile int64*>(&counter_4bit[s >> 4]);
+			uint64_t prev_word = counter_4bit[s >> 4];
+			for (;;)
+			{
+				const int prev_counter = static_cast<int>((prev_word >> shift) & 0xf);
+				const int new_counter = FMath::Clamp(prev_counter + delta, 0, k_counter_max);
+				if (prev_counter == new_counter)
+					return prev_counter;
+				const uint64_t new_word = (prev_word & ~(uint64_t(0xf) << shift)) | (static_cast<uint64_t>(new_counter) << shift);
+				const uint64_t observed_word = static_cast<uint64_t>(FPlatformAtomics::InterlockedCompareExchange(p_dst, static_cast<int64>(new_word), static_cast<int64>(prev_word)));
+				if (observed_word == prev_word)
+					return prev_counter;
+				prev_word = observed_word;// 他スレッドに書き換えられていたら再試行.
+			}
+		}
+
+		// 64要素 x 4bit.
+		std::array<uint64_t, 4> counter_4bit = {};
+	};
+
+	// 並列割当可能なプールのインデックスアロケータ. 要素の実体は利用側の配列で保持する.
+	//	容量の変更と解放は並列区間外でのみ可能. 並列区間内ではAllocのみ可能で, 容量不足の場合は無効値を返す.
+	//	並列区間の後はEndConcurrentでカウンタを補正すること.
+	class ConcurrentPoolIndexAllocator
+	{
+	public:
+		static constexpr GridCellAddrType k_invalid_u32 = ~GridCellAddrType(0);
+
+		void Reset()
+		{
+			capacity_ = 0;
+			bump_ = 0;
+			free_list_.Reset();
+			free_list_num_ = 0;
+		}
+		// 容量の拡張. 利用側の配列も同じ要素数に拡張すること.
+		void SetCapacity(int capacity)
+		{
+			check(capacity_ <= capacity);
+			capacity_ = capacity;
+		}
+		int GetCapacity() const
+		{
+			return capacity_;
+		}
+		// 割当可能な残り要素数.
+		int GetFreeCount() const
+		{
+			return (capacity_ - bump_.load()) + free_list_num_.load();
+		}
+		int GetUsedCount() const
+		{
+			return capacity_ - GetFreeCount();
+		}
+
+		// 割当. 並列区間内で呼び出し可能.
+		GridCellAddrType Alloc()
+		{
+			// 解放済み要素を優先.
+			if (0 < free_list_num_.load(std::memory_order_relaxed))
+			{
+				const int free_i = free_list_num_.fetch_sub(1) - 1;
+				if (0 <= free_i)
+					return free_list_[free_i];
+			}
+			// 未使用領域からバンプ割当.
+			const int new_i = bump_.fetch_add(1);
+			if (capacity_ > new_i)
+				return static_cast<GridCellAddrType>(new_i);
+			return k_invalid_u32;// 容量不足.
+		}
+		// 並列区間で容量を超えて進んだカウンタを補正.
+		void EndConcurrent()
+		{
+			free_list_num_ = FMath::Max(0, free_list_num_.load());
+			bump_ = FMath::Min(capacity_, bump_.load());
+		}
+		// 解放. 並列区間外でのみ呼び出し可能.
+		void Free(GridCellAddrType index)
+		{
+			check(static_cast<int>(index) < bump_.load());
+			free_list_.SetNum(free_list_num_.load());
+			free_list_.Add(index);
+			free_list_num_ = free_list_.Num();
+		}
+
+	private:
+		int							capacity_ = 0;
+		std::atomic<int>			bump_ = 0;
+		TArray<GridCellAddrType>	free_list_;
+		std::atomic<int>			free_list_num_ = 0;
+	};
+
 	// Raytrace階層Grid構造を使用してシーンのOccpancyGridを構築するクラス.
 	// 階層OctreeのRay Traversal機能サポート.
 	class HierarchicalOccupancyGrid
@@ -718,6 +944,32 @@ namespace naga
 		};
 		static constexpr auto k_sizeof_ChildCell = sizeof(CellData);
 
+		// 複数Rayのトレースで共有するCellデータ取得のキャッシュ.
+		// 近い経路のRayは同じRootCell, ChildCellを訪問するため, Rootからの探索結果を深度毎に保持して再利用する.
+		// Gridの構造(Cell割当)が変化したら破棄すること. BrickのOccupancyビットの変更は影響しない.
+		struct CellDataFetchCache
+		{
+			static constexpr int k_entry_count = 1024;
+
+			struct Entry
+			{
+				FIntVector			cell = FIntVector::ZeroValue;
+				int					depth = -1;
+				GridCellAddrType	addr = k_invalid_u32;
+			};
+			TArray<Entry> entries;
+
+			CellDataFetchCache()
+			{
+				entries.SetNum(k_entry_count);
+			}
+			Entry& FindEntry(int depth, const FIntVector& cell)
+			{
+				const uint32_t hash = (static_cast<uint32_t>(cell.X) * 73856093u) ^ (static_cast<uint32_t>(cell.Y) * 19349663u) ^ (static_cast<uint32_t>(cell.Z) * 83492791u) ^ (static_cast<uint32_t>(depth) * 2654435761u);
+				return entries[hash & (k_entry_count - 1)];
+			}
+		};
+
 
 	public:
 		HierarchicalOccupancyGrid()
@@ -728,9 +980,21 @@ namespace naga
 		}
 
 		// cell_width : RootCell一つのワールドスペースサイズ.
-		bool Initialize(float cell_width = 1200.0f)
+		// use_log_odds : 要素毎のLogOddsカウンタによる確率的なOccupancy更新をするか. falseの場合は1回のヒット/ミスで直接ビットを更新する.
+		// log_odds_param : LogOddsカウンタの更新パラメータ. 1回のヒットで占有となる閾値は prior + hit + 1 へ引き上げる.
+		bool Initialize(float cell_width = 1200.0f, bool use_log_odds = false, const OccupancyLogOddsParam& log_odds_param = {})
 		{
 			bgrid_.Initialize(cell_width);
+			use_log_odds_ = use_log_odds;
+			log_odds_param_.prior = FMath::Clamp(log_odds_param.prior, 0, OccupancyGridLeafLogOdds::k_counter_max - 2);
+			log_odds_param_.hit = FMath::Clamp(log_odds_param.hit, 1, OccupancyGridLeafLogOdds::k_counter_max - 1 - log_odds_param_.prior);
+			log_odds_param_.miss = FMath::Clamp(log_odds_param.miss, 1, OccupancyGridLeafLogOdds::k_counter_max);
+			log_odds_param_.occupied_threshold = FMath::Clamp(log_odds_param.occupied_threshold, log_odds_param_.prior + log_odds_param_.hit + 1, OccupancyGridLeafLogOdds::k_counter_max);
+			if (use_log_odds_ && log_odds_param_.occupied_threshold != log_odds_param.occupied_threshold)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("[HierarchicalOccupancyGrid] LogOdds occupied_threshold %d is adjusted to %d."), log_odds_param.occupied_threshold, log_odds_param_.occupied_threshold);
+			}
+			log_odds_brick_pool_.SetNum((use_log_odds_) ? bit_occupancy_brick_pool_.Num() : 0);
 			// RootCell毎の最大分割数. ChildCell4分割で深度2なら16.
 			leaf_cell_space_reso_ = std::pow(k_child_cell_reso, k_multigrid_max_depth);
 			// 最下層Cellのワールド空間サイズ
@@ -745,51 +1009,60 @@ namespace naga
 		{
 			return is_initialized_;
 		}
+		bool IsLogOddsEnabled() const
+		{
+			return use_log_odds_;
+		}
+		const OccupancyLogOddsParam& GetLogOddsParam() const
+		{
+			return log_odds_param_;
+		}
 
 		struct LocalFunc
 		{
-			static auto AllocNewCell(HierarchicalOccupancyGrid* p_system) ->int
+			// Cell割当. 並列区間内で呼び出し可能. 容量不足の場合はk_invalid_u32.
+			static auto AllocNewCell(HierarchicalOccupancyGrid* p_system) -> GridCellAddrType
 			{
-				int new_element_index = -1;
+				// リーフ以外ではCell割当.
+				const auto pool_index = p_system->cell_pool_alloc_.Alloc();
+				if (k_invalid_u32 != pool_index)
 				{
-					// リーフ以外ではCell割当.
-					auto pool_index = p_system->cell_pool_flag_.FindAndSetFirstZeroBit();
-					if (INDEX_NONE == pool_index)
-					{
-						pool_index = p_system->cell_pool_flag_.Num();
-						p_system->cell_pool_flag_.Add(true);
-						p_system->cell_pool_.Add(CellData::GetInvalidFilled());// Cellはすべて無効要素で初期化.
-					}
-					else
-					{
-						p_system->cell_pool_flag_[pool_index] = true;
-						p_system->cell_pool_[pool_index] = CellData::GetInvalidFilled();
-					}
-					new_element_index = pool_index;
+					p_system->cell_pool_[pool_index] = CellData::GetInvalidFilled();// Cellはすべて無効要素で初期化.
 				}
-				return new_element_index;
+				return pool_index;
 			}
 			
-			static auto AllocNewBrick(HierarchicalOccupancyGrid* p_system) ->int
+			// Brick割当. 並列区間内で呼び出し可能. 容量不足の場合はk_invalid_u32.
+			static auto AllocNewBrick(HierarchicalOccupancyGrid* p_system) -> GridCellAddrType
 			{
-				int new_element_index = -1;
+				// リーフではBrick割当.
+				const auto pool_index = p_system->bit_occupancy_brick_pool_alloc_.Alloc();
+				if (k_invalid_u32 != pool_index)
 				{
-					// リーフではBrick割当.
-					auto pool_index = p_system->bit_occupancy_brick_pool_flag_.FindAndSetFirstZeroBit();
-					if (INDEX_NONE == pool_index)
-					{
-						pool_index = p_system->bit_occupancy_brick_pool_flag_.Num();
-						p_system->bit_occupancy_brick_pool_flag_.Add(true);
-						p_system->bit_occupancy_brick_pool_.Add({});// Brickはゼロクリア.
-					}
-					else
-					{
-						p_system->bit_occupancy_brick_pool_flag_[pool_index] = true;
-						p_system->bit_occupancy_brick_pool_[pool_index] = {};
-					}
-					new_element_index = pool_index;
+					p_system->bit_occupancy_brick_pool_[pool_index] = {};// Brickはゼロクリア.
+					if (p_system->use_log_odds_)
+						p_system->log_odds_brick_pool_[pool_index].Reset(p_system->log_odds_param_.prior);
+				}
+				return pool_index;
+			}
+
+			// 並列区間の前にプールの空き容量を確保する. 既存要素のアドレスは維持される.
+			static void ReservePoolFreeCount(HierarchicalOccupancyGrid* p_system, int cell_free_count, int brick_free_count)
+			{
+				if (cell_free_count > p_system->cell_pool_alloc_.GetFreeCount())
+				{
+					const int new_capacity = p_system->cell_pool_alloc_.GetCapacity() + cell_free_count - p_system->cell_pool_alloc_.GetFreeCount();
+					p_system->cell_pool_alloc_.SetCapacity(new_capacity);
+					p_system->cell_pool_.SetNum(new_capacity);
+				}
+				if (brick_free_count > p_system->bit_occupancy_brick_pool_alloc_.GetFreeCount())
+				{
+					const int new_capacity = p_system->bit_occupancy_brick_pool_alloc_.GetCapacity() + brick_free_count - p_system->bit_occupancy_brick_pool_alloc_.GetFreeCount();
+					p_system->bit_occupancy_brick_pool_alloc_.SetCapacity(new_capacity);
+					p_system->bit_occupancy_brick_pool_.SetNum(new_capacity);
+					if (p_system->use_log_odds_)
+						p_system->log_odds_brick_pool_.SetNum(new_capacity);
 				}
-				return new_element_index;
 			}
 
 			template<bool IS_ALLOC = true>
@@ -808,7 +1081,10 @@ namespace naga
 						if constexpr (IS_ALLOC)
 						{
 							// CellまたはBrick割当.
-							p_system->bgrid_.root_cell_data_[root_cell_index] = AllocNewCell(p_system);
+							const auto new_addr = AllocNewCell(p_system);
+							if (k_invalid_u32 == new_addr)
+								return std::make_tuple(k_invalid_u32, FVector{});// プール容量不足.
+							p_system->bgrid_.root_cell_data_[root_cell_index] = new_addr;
 						}
 						else
 						{
@@ -833,7 +1109,10 @@ namespace naga
 								// Cell.
 								if constexpr (IS_ALLOC)
 								{
-									p_system->cell_pool_[cell_addr].child_addr[child_cell_index] = AllocNewCell(p_system);// 未割り当てなら割当.
+									const auto new_addr = AllocNewCell(p_system);// 未割り当てなら割当.
+									if (k_invalid_u32 == new_addr)
+										return std::make_tuple(k_invalid_u32, FVector{});// プール容量不足.
+									p_system->cell_pool_[cell_addr].child_addr[child_cell_index] = new_addr;
 								}
 								else
 								{	
@@ -845,7 +1124,10 @@ namespace naga
 								// Brick.
 								if constexpr (IS_ALLOC)
 								{
-									p_system->cell_pool_[cell_addr].child_addr[child_cell_index] = AllocNewBrick(p_system);// 未割り当てなら割当.
+									const auto new_addr = AllocNewBrick(p_system);// 未割り当てなら割当.
+									if (k_invalid_u32 == new_addr)
+										return std::make_tuple(k_invalid_u32, FVector{});// プール容量不足.
+									p_system->cell_pool_[cell_addr].child_addr[child_cell_index] = new_addr;
 								}
 								else
 								{	
@@ -860,48 +1142,223 @@ namespace naga
 				}
 				return std::make_tuple(k_invalid_u32, FVector{});
 			}
+			// Cell以下の階層のCellとBrickをプールへ返却. 並列区間外でのみ呼び出し可能.
+			//	depth : cell_addrのCell自身の深度. RootCellに割り当てたCellは1.
+			static void FreeCellTree(HierarchicalOccupancyGrid* p_system, GridCellAddrType cell_addr, int depth)
+			{
+				for (const auto child_addr : p_system->cell_pool_[cell_addr].child_addr)
+				{
+					if (k_invalid_u32 == child_addr)
+						continue;
+					if (k_multigrid_max_depth > depth)
+						FreeCellTree(p_system, child_addr, depth + 1);
+					else
+						p_system->bit_occupancy_brick_pool_alloc_.Free(child_addr);
+				}
+				p_system->cell_pool_alloc_.Free(cell_addr);
+			}
+			// Brickを返却可能か. ビットが空で, LogOddsモードでは全要素のカウンタが事前値以下まで戻っている.
+			static bool IsReclaimableBrick(const HierarchicalOccupancyGrid* p_system, GridCellAddrType brick_addr)
+			{
+				if (0 != p_system->bit_occupancy_brick_pool_[brick_addr].occupancy_4x4x4)
+					return false;
+				return !p_system->use_log_odds_ || p_system->log_odds_brick_pool_[brick_addr].IsAllLessEqual(p_system->log_odds_param_.prior);
+			}
+			// Cell以下の階層でビットが空のBrick数.
+			//	depth : cell_addrのCell自身の深度. RootCellに割り当てたCellは1.
+			static int CountUnoccupiedBrick(const HierarchicalOccupancyGrid* p_system, GridCellAddrType cell_addr, int depth)
+			{
+				int count = 0;
+				for (const auto child_addr : p_system->cell_pool_[cell_addr].child_addr)
+				{
+					if (k_invalid_u32 == child_addr)
+						continue;
+					if (k_multigrid_max_depth > depth)
+						count += CountUnoccupiedBrick(p_system, child_addr, depth + 1);
+					else if (0 == p_system->bit_occupancy_brick_pool_[child_addr].occupancy_4x4x4)
+						++count;
+				}
+				return count;
+			}
+			// 座標に対応するBrickが返却可能であればプールへ返却し, 子を持たなくなった祖先のCellも返却する. 並列区間外でのみ呼び出し可能.
+			static void ReclaimEmptyBrick(HierarchicalOccupancyGrid* p_system, const FVector& pos_ws)
+			{
+				const auto root_cell = p_system->bgrid_.WorldToRootGridSpace(pos_ws);
+				const auto root_cell_i = math::FVectorFloorToInt(root_cell);
+				if (!p_system->bgrid_.IsInner(root_cell_i))
+					return;
+
+				// Rootから辿った各深度のCellと, Cell内の子インデックス.
+				std::array<GridCellAddrType, k_multigrid_max_depth + 1> path_cell_addr;
+				std::array<int, k_multigrid_max_depth + 1> path_child_index;
+				const auto root_cell_index = p_system->bgrid_.CalcRootCellIndex(root_cell_i);
+				auto cell_addr = p_system->bgrid_.root_cell_data_[root_cell_index];
+				auto cell_frac = root_cell - FVector(root_cell_i);
+				for (int depth_i = 1; depth_i <= k_multigrid_max_depth; ++depth_i)
+				{
+					if (k_invalid_u32 == cell_addr)
+						return;
+					const auto child_cell_pos = cell_frac * k_child_cell_reso;
+					const auto child_cell_pos_i = FIntVector(child_cell_pos);// 0をまたがないはずなのでFloorより高速なint丸め.
+					cell_frac = child_cell_pos - FVector(child_cell_pos_i);
+					const auto child_cell_index = (child_cell_pos_i.X) + (child_cell_pos_i.Y * k_child_cell_reso) + (child_cell_pos_i.Z * k_child_cell_reso * k_child_cell_reso);
+
+					path_cell_addr[depth_i] = cell_addr;
+					path_child_index[depth_i] = child_cell_index;
+					cell_addr = p_system->cell_pool_[cell_addr].child_addr[child_cell_index];
+				}
+				// 末端はBrick.
+				if (k_invalid_u32 == cell_addr || !IsReclaimableBrick(p_system, cell_addr))
+					return;
+				p_system->bit_occupancy_brick_pool_alloc_.Free(cell_addr);
+
+				// 子を持たなくなったCellを末端側から返却.
+				for (int depth_i = k_multigrid_max_depth; depth_i >= 1; --depth_i)
+				{
+					auto& cell = p_system->cell_pool_[path_cell_addr[depth_i]];
+					cell.child_addr[path_child_index[depth_i]] = k_invalid_u32;
+					for (const auto child_addr : cell.child_addr)
+					{
+						if (k_invalid_u32 != child_addr)
+							return;// 他の子が残っている.
+					}
+					p_system->cell_pool_alloc_.Free(path_cell_addr[depth_i]);
+				}
+				p_system->bgrid_.root_cell_data_[root_cell_index] = k_invalid_u32;
+			}
 			// 座標に対応するBrickを検索. LeafBrickまで到達できなかった場合は k_invalid_u32 を返す.
 			static auto SearchBrick(HierarchicalOccupancyGrid* p_system, const FVector& pos_ws) -> std::tuple<GridCellAddrType, FVector>
 			{
 				return SearchOrAddBrick<false>(p_system, pos_ws);
 			}
 		};
+		// Gridの中心を移動する. 視点に追従させて広い範囲でOccupancyを構築するために使用する.
+		//	RootCell境界をまたいだ場合のみ, 範囲外となったRootCell以下のCellとBrickをプールへ返却する. 範囲内のデータはコピーしない.
+		bool MoveGridCenter(const FVector& center_pos_ws)
+		{
+			return bgrid_.MoveGridCenter(center_pos_ws, [this](GridCellAddrType root_cell_data)
+			{
+				LocalFunc::FreeCellTree(this, root_cell_data, 1);
+			});
+		}
+
 		// 視点からのレイヒット地点にOccupanncyを登録する.
 		//	Octree管理.
+		//	Grid範囲の移動はMoveGridCenterで行う.
 		void UpdateOccupancy(const FVector& sample_ray_origin, const TArray<std::tuple<FVector, bool>>& sample_ray_end_and_ishit)
 		{
-			// 移動によるシフトコピーなどは後で.
-
-
 			// Occupancyの追加.
-			for (int i = 0; i < sample_ray_end_and_ishit.Num(); ++i)
+			//	サンプルをRootCell毎に分割して並列処理する. RootCell以下の階層は担当ジョブのみが書き換えるため, 共有するのはプールの割当のみ.
+			const int sample_count = sample_ray_end_and_ishit.Num();
+			const auto CalcBiasedHitPos = [&sample_ray_origin, &sample_ray_end_and_ishit](int sample_i)
+			{
+				const auto hit_pos = std::get<0>(sample_ray_end_and_ishit[sample_i]);
+				// 表面ヒット位置からオフセットした位置を採用する.
+				constexpr float k_sample_bias = 0.0f;//10.0f;
+				return hit_pos - (hit_pos - sample_ray_origin).GetSafeNormal() * k_sample_bias;
+			};
+			update_sample_key_.Reset();
+			update_sample_key_.Reserve(sample_count);
+			for (int i = 0; i < sample_count; ++i)
 			{
 				// ヒットサンプルのみ.
 				if (!std::get<1>(sample_ray_end_and_ishit[i]))
 					continue;
 
-				const auto hit_pos = std::get<0>(sample_ray_end_and_ishit[i]);
-				// 表面ヒット位置からオフセットした位置を採用する.
-				constexpr float k_sample_bias = 0.0f;//10.0f;
-				const auto biased_hit_pos = hit_pos - (hit_pos - sample_ray_origin).GetSafeNormal() * k_sample_bias;
-				
-				const auto brick_addr_frac = LocalFunc::SearchOrAddBrick(this, biased_hit_pos);
+				const auto root_cell_i = math::FVectorFloorToInt(bgrid_.WorldToRootGridSpace(CalcBiasedHitPos(i)));
+				if (!bgrid_.IsInner(root_cell_i))
+					continue;
+				// 上位にRootCellインデックス, 下位にサンプルインデックス.
+				update_sample_key_.Add((static_cast<uint64_t>(bgrid_.CalcRootCellIndex(root_cell_i)) << 32) | static_cast<uint64_t>(i));
+			}
+			update_sample_key_.Sort();
 
-				const auto brick_addr = std::get<0>(brick_addr_frac);
-				if(k_invalid_u32 != brick_addr)
+			// RootCell毎のサンプル範囲.
+			update_root_cell_begin_.Reset();
+			for (int i = 0; i < update_sample_key_.Num(); ++i)
+			{
+				if (0 == i || (update_sample_key_[i - 1] >> 32) != (update_sample_key_[i] >> 32))
+					update_root_cell_begin_.Add(i);
+			}
+			const int update_root_cell_count = update_root_cell_begin_.Num();
+			update_root_cell_begin_.Add(update_sample_key_.Num());
+
+			// 処理するRootCell範囲. プール容量不足で中断したRootCellは容量を拡張して, 中断したサンプルから再開する.
+			//	LogOddsカウンタの加算は冪等ではないため, 処理済みのサンプルを再処理しない.
+			TArray<int> process_root_cell;
+			TArray<int> process_root_cell_key_begin;
+			process_root_cell.SetNumUninitialized(update_root_cell_count);
+			process_root_cell_key_begin.SetNumUninitialized(update_root_cell_count);
+			for (int i = 0; i < update_root_cell_count; ++i)
+			{
+				process_root_cell[i] = i;
+				process_root_cell_key_begin[i] = update_root_cell_begin_[i];
+			}
+			TArray<bool> process_root_cell_failed;
+
+			// 空き容量の初期値. 少なくとも処理するRootCell数, 以降は不足に応じて倍増する.
+			int reserve_cell_free_count = FMath::Max(update_root_cell_count * k_multigrid_max_depth, cell_pool_alloc_.GetCapacity() / 4);
+			int reserve_brick_free_count = FMath::Max(update_root_cell_count, bit_occupancy_brick_pool_alloc_.GetCapacity() / 4);
+			while (0 < process_root_cell.Num())
+			{
+				LocalFunc::ReservePoolFreeCount(this, reserve_cell_free_count, reserve_brick_free_count);
+
+				process_root_cell_failed.Init(false, process_root_cell.Num());
+				ParallelFor(process_root_cell.Num(), [this, &CalcBiasedHitPos, &process_root_cell, &process_root_cell_key_begin, &process_root_cell_failed](int32 job_index)
 				{
-					// リーフの4x4x4 Brickへ書き込み.
-					const auto brick_pos_i = FIntVector(std::get<1>(brick_addr_frac) * k_child_cell_reso);// 0をまたがないはずなのでFloorより高速なint丸めで済ませる
-					bit_occupancy_brick_pool_[std::get<0>(brick_addr_frac)].Set1(brick_pos_i.X, brick_pos_i.Y, brick_pos_i.Z);
+					const int root_cell_i = process_root_cell[job_index];
+					for (int key_i = process_root_cell_key_begin[job_index]; key_i < update_root_cell_begin_[root_cell_i + 1]; ++key_i)
+					{
+						const int sample_i = static_cast<int>(update_sample_key_[key_i] & 0xffffffff);
+						const auto brick_addr_frac = LocalFunc::SearchOrAddBrick(this, CalcBiasedHitPos(sample_i));
+
+						const auto brick_addr = std::get<0>(brick_addr_frac);
+						if (k_invalid_u32 == brick_addr)
+						{
+							// RootCell内のサンプルのため, 失敗はプール容量不足. このサンプルから再開する.
+							process_root_cell_failed[job_index] = true;
+							process_root_cell_key_begin[job_index] = key_i;
+							return;
+						}
+						// リーフの4x4x4 Brickへ書き込み.
+						const auto brick_pos_i = FIntVector(std::get<1>(brick_addr_frac) * k_child_cell_reso);// 0をまたがないはずなのでFloorより高速なint丸めで済ませる
+						if (use_log_odds_)
+						{
+							// ヒットでカウンタを加算し, 閾値以上になればビットを立てる.
+							const int prev_counter = log_odds_brick_pool_[brick_addr].AddAtomic(brick_pos_i.X, brick_pos_i.Y, brick_pos_i.Z, log_odds_param_.hit);
+							if (log_odds_param_.occupied_threshold > prev_counter + log_odds_param_.hit)
+								continue;
+						}
+						bit_occupancy_brick_pool_[brick_addr].Set1Atomic(brick_pos_i.X, brick_pos_i.Y, brick_pos_i.Z);
+					}
+				});
+				cell_pool_alloc_.EndConcurrent();
+				bit_occupancy_brick_pool_alloc_.EndConcurrent();
+
+				// 容量不足で中断したRootCellのみ再処理.
+				int retry_count = 0;
+				for (int i = 0; i < process_root_cell.Num(); ++i)
+				{
+					if (process_root_cell_failed[i])
+					{
+						process_root_cell[retry_count] = process_root_cell[i];
+						process_root_cell_key_begin[retry_count] = process_root_cell_key_begin[i];
+						++retry_count;
+					}
 				}
+				process_root_cell.SetNum(retry_count);
+				process_root_cell_key_begin.SetNum(retry_count);
+				reserve_cell_free_count = FMath::Max(reserve_cell_free_count * 2, cell_pool_alloc_.GetCapacity());
+				reserve_brick_free_count = FMath::Max(reserve_brick_free_count * 2, bit_occupancy_brick_pool_alloc_.GetCapacity());
 			}
 
 			// Occupancyの除去.
 			//	sample ray　の視点終点の間に存在するBrickはすでに存在しないので除去することで, 動的なシーンに対応する.
+			//	全Rayをまとめてトレースしてから除去するため, 各Rayは除去前の状態に対してトレースする. 同一Ray上で手前のBrickに遮られた奥のBrickは次回以降の更新で除去される.
+			TArray<FVector> removal_ray_end;
+			removal_ray_end.Reserve(sample_ray_end_and_ishit.Num());
 			for (int i = 0; i < sample_ray_end_and_ishit.Num(); ++i)
 			{
-				FVector hit_pos, hit_normal;
-
 				const auto sample_hit_pos = std::get<0>(sample_ray_end_and_ishit[i]);
 				// SampleRayのヒット位置から一定距離バイアスをかけた位置でクエリを発行. そこまでにヒットしたBrickはすでに実際のシーンにオブジェクトが存在しなくなっているとして除去する.
 				FVector sample_dir;
@@ -910,19 +1367,101 @@ namespace naga
 				constexpr float k_sample_bias = 100.0f;
 				if(k_sample_bias < sample_length)
 				{
-					const auto biased_sample_hit_pos =  sample_ray_origin + sample_dir * (sample_length - k_sample_bias);
-					if(TraceSingle(hit_pos, hit_normal, sample_ray_origin, biased_sample_hit_pos))
+					removal_ray_end.Add(sample_ray_origin + sample_dir * (sample_length - k_sample_bias));
+				}
+			}
+			constexpr int k_removal_job_size = 1024;
+			if (use_log_odds_)
+			{
+				// LogOddsモードではRayが通過する割当済みBrickの全要素をミスとして減算する.
+				//	ビットの立っていない要素も減算するため, 単発のヒットによるカウンタの増加は後続のミスで事前値まで戻る.
+				//	ビットが空のBrickはジョブ毎に記録し, 並列処理後にカウンタが事前値以下まで戻ったものをプールへ返却する.
+				//	1回のヒットで割り当てられたビットの無いBrickはトレースでヒットしないため, ここで返却しなければ残り続ける.
+				const int removal_job_count = FMath::DivideAndRoundUp(removal_ray_end.Num(), k_removal_job_size);
+				TArray<TMap<GridCellAddrType, FVector>> job_unoccupied_brick;
+				job_unoccupied_brick.SetNum(removal_job_count);
+				ParallelFor(removal_job_count, [this, &sample_ray_origin, &removal_ray_end, &job_unoccupied_brick](int32 job_index)
+				{
+					CellDataFetchCache fetch_cache;
+					MultiGridTraceBrickMissProcess miss_process = { *this, &fetch_cache, &job_unoccupied_brick[job_index] };
+					TraceCellDepthDescendingCheckerForMultiGrid depth_descending = { *this, &fetch_cache };
+
+					const int end_i = FMath::Min(removal_ray_end.Num(), (job_index + 1) * k_removal_job_size);
+					for (int i = job_index * k_removal_job_size; i < end_i; ++i)
 					{
-						const auto brick_addr_frac = LocalFunc::SearchBrick(this, hit_pos);
-						if(k_invalid_u32 != std::get<0>(brick_addr_frac))
-						{
-							// リムーブする.
-							const auto brick_pos_i = FIntVector(std::get<1>(brick_addr_frac) * k_child_cell_reso);// 0をまたがないはずなのでFloorより高速なint丸めで済ませる
-							bit_occupancy_brick_pool_[std::get<0>(brick_addr_frac)].Set0(brick_pos_i.X, brick_pos_i.Y, brick_pos_i.Z);
-						}
+						decltype(miss_process)::Payload payload = {};
+						bgrid_.TraceHierarchicalGrid<true, k_child_cell_reso, k_multigrid_max_depth>(sample_ray_origin, removal_ray_end[i], payload, miss_process, depth_descending);
+					}
+				});
+				TMap<GridCellAddrType, FVector> unoccupied_brick;
+				for (const auto& job_map : job_unoccupied_brick)
+					unoccupied_brick.Append(job_map);
+				for (const auto& e : unoccupied_brick)
+					LocalFunc::ReclaimEmptyBrick(this, e.Value);
+				return;
+			}
+
+			TraceBatchResult removal_trace_result;
+			TraceBatch(MakeArrayView(&sample_ray_origin, 1), removal_ray_end, removal_trace_result);
+			// 複数Rayが同一Brickのビットを除去するためアトミックに書き込む. Cellの割当は変化しない.
+			//	Brickを空にしたRayを記録し, 並列処理後にBrickと空になったCellをプールへ返却する.
+			TArray<bool> removal_emptied_brick;
+			removal_emptied_brick.Init(false, removal_ray_end.Num());
+			ParallelFor(FMath::DivideAndRoundUp(removal_ray_end.Num(), k_removal_job_size), [this, &removal_ray_end, &removal_trace_result, &removal_emptied_brick](int32 job_index)
+			{
+				const int end_i = FMath::Min(removal_ray_end.Num(), (job_index + 1) * k_removal_job_size);
+				for (int i = job_index * k_removal_job_size; i < end_i; ++i)
+				{
+					if (!removal_trace_result.is_hit[i])
+						continue;
+
+					const auto brick_addr_frac = LocalFunc::SearchBrick(this, removal_trace_result.hit_pos_ws[i]);
+					if(k_invalid_u32 != std::get<0>(brick_addr_frac))
+					{
+						// リムーブする.
+						const auto brick_pos_i = FIntVector(std::get<1>(brick_addr_frac) * k_child_cell_reso);// 0をまたがないはずなのでFloorより高速なint丸めで済ませる
+						const auto prev_occupancy = bit_occupancy_brick_pool_[std::get<0>(brick_addr_frac)].Set0Atomic(brick_pos_i.X, brick_pos_i.Y, brick_pos_i.Z);
+						// 除去したビットのみが残っていた場合はこのRayでBrickが空になった.
+						removal_emptied_brick[i] = (OccupancyGridLeafData::CalcBitMask(brick_pos_i.X, brick_pos_i.Y, brick_pos_i.Z) == prev_occupancy);
 					}
 				}
+			});
+			for (int i = 0; i < removal_ray_end.Num(); ++i)
+			{
+				if (removal_emptied_brick[i])
+					LocalFunc::ReclaimEmptyBrick(this, removal_trace_result.hit_pos_ws[i]);
+			}
+		}
+
+		// メモリ使用量.
+		struct MemoryUsage
+		{
+			int		cell_used_count = 0;
+			int		cell_capacity = 0;
+			int		brick_used_count = 0;
+			// 使用中のうちビットが空のBrick数. LogOddsモードで閾値未満のカウンタのみを持ち, 返却を待つBrick.
+			int		brick_unoccupied_count = 0;
+			int		brick_capacity = 0;
+			// プールの確保済みメモリサイズ.
+			int64	allocated_byte_size = 0;
+			// プールのうち使用中の要素のメモリサイズ.
+			int64	used_byte_size = 0;
+		};
+		MemoryUsage GetMemoryUsage() const
+		{
+			MemoryUsage usage = {};
+			usage.cell_used_count = cell_pool_alloc_.GetUsedCount();
+			usage.cell_capacity = cell_pool_alloc_.GetCapacity();
+			usage.brick_used_count = bit_occupancy_brick_pool_alloc_.GetUsedCount();
+			for (const auto root_cell_data : bgrid_.root_cell_data_)
+			{
+				if (k_invalid_u32 != root_cell_data)
+					usage.brick_unoccupied_count += LocalFunc::CountUnoccupiedBrick(this, root_cell_data, 1);
 			}
+			usage.brick_capacity = bit_occupancy_brick_pool_alloc_.GetCapacity();
+			usage.allocated_byte_size = cell_pool_.GetAllocatedSize() + bit_occupancy_brick_pool_.GetAllocatedSize() + log_odds_brick_pool_.GetAllocatedSize() + static_cast<int64>(bgrid_.root_cell_data_.capacity() * sizeof(GridCellAddrType));
+			usage.used_byte_size = static_cast<int64>(usage.cell_used_count) * sizeof(CellData) + static_cast<int64>(usage.brick_used_count) * (sizeof(OccupancyGridLeafData) + ((use_log_odds_) ? sizeof(OccupancyGridLeafLogOdds) : 0)) + static_cast<int64>(bgrid_.root_cell_data_.size() * sizeof(GridCellAddrType));
+			return usage;
 		}
 		
 		// Occlupancyを考慮して移動するパーティクルテスト. パーティクル投入.
@@ -956,6 +1495,10 @@ namespace naga
 			constexpr float k_collision_offset = 0.5f;
 			constexpr float k_restitution = 0.75f;
 
+			// 移動するパーティクルの移動経路をまとめてトレースする.
+			TArray<int> trace_particle_index;
+			TArray<FVector> trace_origin;
+			TArray<FVector> trace_end;
 			for (auto i = 0; i < particle_pool_flag_.Num(); ++i)
 			{
 				if (!particle_pool_flag_[i])
@@ -963,13 +1506,28 @@ namespace naga
 
 				// 重力.
 				particle_pool_[i].vel += k_gravity * delta_sec;
+				if (!particle_pool_[i].vel.IsNearlyZero())
+				{
+					trace_particle_index.Add(i);
+					trace_origin.Add(particle_pool_[i].pos);
+					trace_end.Add(particle_pool_[i].pos + particle_pool_[i].vel * delta_sec);
+				}
+			}
+			TraceBatchResult trace_result;
+			TraceBatch(trace_origin, trace_end, trace_result);
+
+			for (auto i = 0, trace_i = 0; i < particle_pool_flag_.Num(); ++i)
+			{
+				if (!particle_pool_flag_[i])
+					continue;
 
 				auto candidate_pos = particle_pool_[i].pos + particle_pool_[i].vel * delta_sec;
-				if (!particle_pool_[i].vel.IsNearlyZero())
+				if (trace_i < trace_particle_index.Num() && i == trace_particle_index[trace_i])
 				{
-					FVector trace_hit_pos, trace_hit_normal;
-					if (TraceSingle(trace_hit_pos, trace_hit_normal, particle_pool_[i].pos, candidate_pos))
+					if (trace_result.is_hit[trace_i])
 					{
+						const auto& trace_hit_pos = trace_result.hit_pos_ws[trace_i];
+						const auto& trace_hit_normal = trace_result.hit_normal_ws[trace_i];
 						particle_pool_[i].vel = particle_pool_[i].vel - (1.0f + k_restitution) * trace_hit_normal * FVector::DotProduct(trace_hit_normal, particle_pool_[i].vel);
 						//particle_pool_[i].vel = FVector::Zero();
 
@@ -977,6 +1535,7 @@ namespace naga
 						// 反射後の再ヒットを回避するためオフセット.
 						candidate_pos = trace_hit_pos + (trace_hit_normal * k_collision_offset);
 					}
+					++trace_i;
 				}
 				particle_pool_[i].pos = candidate_pos;
 				particle_pool_[i].life_sec += delta_sec;
@@ -992,13 +1551,14 @@ namespace naga
 		struct TraceCellDepthDescendingCheckerForMultiGrid
 		{
 			const HierarchicalOccupancyGrid& grid_impl;
-
+			// 複数Rayのトレース時に共有するキャッシュ. nullptrの場合は毎回Rootから探索.
+			CellDataFetchCache* fetch_cache = nullptr;
 
 			// Cellとのヒット処理. システムからレイの基本情報とトレース対象のCell情報, レイのPayloadを受け取って判定やPayload更新をする.
 			const bool operator()(const GridRayTraceRayUniform& ray_uniform, const GridRayTraceVisitCellUniform& visit_cell_param)
 			{
 				// 現在深度で指定Cellのデータが存在すれば降下する.
-				const auto [cell_data, cell_depth] = grid_impl.GetGridCellData<false>(visit_cell_param.depth, visit_cell_param.cell_id);
+				const auto cell_data = (fetch_cache) ? grid_impl.GetGridCellDataCached(visit_cell_param.depth, visit_cell_param.cell_id, *fetch_cache) : std::get<0>(grid_impl.GetGridCellData<false>(visit_cell_param.depth, visit_cell_param.cell_id));
 				// cellにデータがあれば下層へ移動.
 				return grid_impl.k_invalid_u32 != cell_data;
 			}
@@ -1057,10 +1617,95 @@ namespace naga
 			}
 		};
 
+		// リーフCellのBrick内の4x4x4要素をRayの進行順に巡回する. Rayの終点またはBrickの外に出た時点でfalseを返して終了する.
+		//	visit_func : (const FIntVector& brick_cell, int brick_cell_index, float ray_t) -> bool. trueを返した時点で巡回を終了してtrueを返す.
+		template<typename VisitFuncType>
+		static bool TraverseBrickCell(const GridRayTraceRayUniform& ray_uniform, const GridRayTraceVisitCellUniform& visit_cell_param, const VisitFuncType& visit_func)
+		{
+			constexpr int k_brick_size = 4;
+			constexpr int k_brick_max_range = k_brick_size - 1;
+			// ベクトルの要素逆数ベクトルを返す. 0除算はFLT_MAX.
+			static constexpr auto CalcSafeDirInverse = [](const FVector& ray_dir) -> FVector
+			{
+				return FVector((FMath::IsNearlyZero(ray_dir.X)) ? FLT_MAX : 1.0f / ray_dir.X, (FMath::IsNearlyZero(ray_dir.Y)) ? FLT_MAX : 1.0f / ray_dir.Y, (FMath::IsNearlyZero(ray_dir.Z)) ? FLT_MAX : 1.0f / ray_dir.Z);
+			};
+
+			// ヒット座標(Cell空間)
+			const auto trace_pos_c = ray_uniform.ray_origin + ray_uniform.ray_length * ray_uniform.ray_dir * (visit_cell_param.ray_t);// float誤差で微小にセルの整数に届かない場合があるので注意.
+			// ヒット座標のCell内ローカル座標[0, 1]. float誤差で整数Cellに届いていない場合があるため clamp(0,1)を取っている点に注意.
+			// trace_pos_cはRootGrid空間であるため, 到達Cellの階層における解像度スケールを乗じて cell_id と同じ空間に持っていく.
+			const auto trace_pos_c_frac = math::FVectorClamp(trace_pos_c * visit_cell_param.resolution_per_root_cell - FVector(visit_cell_param.cell_id), FVector::ZeroVector, FVector::OneVector);
+
+			const auto brick_aabb_t_min = (FVector::ZeroVector - trace_pos_c_frac) * ray_uniform.ray_dir_inv;
+			const auto brick_aabb_t_max = (FVector::OneVector - trace_pos_c_frac) * ray_uniform.ray_dir_inv;
+			const auto t0 = FVector::Min(brick_aabb_t_min, brick_aabb_t_max).GetMax();
+			const auto t1 = FVector::Max(brick_aabb_t_min, brick_aabb_t_max).GetMin();
+
+			// Cellから外部に出る地点.
+			const auto cell_out_frac = FVector::Max(FVector::ZeroVector, trace_pos_c_frac + t1 * ray_uniform.ray_dir);
+
+			const auto brick_rd = (cell_out_frac - trace_pos_c_frac) * k_brick_size;
+			const auto brick_rd_inv = CalcSafeDirInverse(brick_rd);
+
+			//Brick内t値の全体t値に対するスケール. 到達Cell自体の解像度スケールとBrickの解像度を考慮する.
+			const auto t_scale = (1.0f / (k_brick_size * visit_cell_param.resolution_per_root_cell)) * (brick_rd.Length() / ray_uniform.ray_length);
+
+			const auto dir_sign = ray_uniform.ray_dir.GetSignVector();
+			const auto delta = FVector::Min(dir_sign * brick_rd_inv, FVector::OneVector) * t_scale;
+
+			const auto begin_cell_pos = math::FVectorClamp(trace_pos_c_frac * k_brick_size, FVector::ZeroVector, FVector(k_brick_size - FLT_EPSILON));
+			const auto begin_cell = math::FIntVectorMin(FIntVector(k_brick_max_range), math::FVectorFloorToInt(begin_cell_pos));
+			const auto end_cell = math::FIntVectorMin(FIntVector(k_brick_max_range), math::FVectorFloorToInt(cell_out_frac * k_brick_size));
+			const auto cell_range = math::FIntVectorAbs(end_cell - begin_cell);
+			const auto t_max_base = ((FVector(begin_cell) + FVector::Max(dir_sign, FVector::ZeroVector) - begin_cell_pos) * brick_rd_inv).GetAbs() * t_scale;
+
+			float last_delta = 0.0f;
+			FIntVector total_step_cell = FIntVector::ZeroValue;
+			FIntVector prev_step = FIntVector::ZeroValue;
+			for (;;)
+			{
+				const auto trace_cell_id = begin_cell + FIntVector(dir_sign) * total_step_cell;
+				const auto cell_index = (trace_cell_id.X) + (trace_cell_id.Y * k_brick_size) + (trace_cell_id.Z * k_brick_size * k_brick_size);
+
+				const auto total_delta = visit_cell_param.ray_t + (last_delta);
+
+				// CellId範囲チェックとは別にt値のチェック. CellID範囲チェックだけでは広いルート階層換算での終了判定なので実際には線分の範囲外になっても継続してしまうため.
+				if (1.0f <= total_delta)
+					return false;
+
+				if (visit_func(trace_cell_id, cell_index, total_delta))
+					return true;
+
+				// Next Step.
+				const auto next_t = t_max_base + FVector(total_step_cell) * delta;
+				// xyzで最小値コンポーネントを探す.
+				prev_step = math::FVectorCompareLessEqual(next_t, FVector::Min(FVector(next_t.Y, next_t.Z, next_t.X), FVector(next_t.Z, next_t.X, next_t.Y)));// Equal無しだとすべて等値だった場合に進行できないため.
+				if constexpr (true)
+				{
+					// 厳密にセルを巡回するために最小コンポーネントが複数あった場合に一つに制限する(XYZの順で優先.). 
+					// この処理をしない場合は (0,0,0)の中心からズレたラインで(1,0,0)などを経由せずに(1,1,1)に移動する.
+					auto tmp = prev_step.X;
+					prev_step.Y = (0 < tmp) ? 0 : prev_step.Y;
+					tmp += prev_step.Y;
+					prev_step.Z = (0 < tmp) ? 0 : prev_step.Z;
+				}
+				// ステップは整数ベースで進める.
+				total_step_cell += prev_step;
+				last_delta = next_t.GetMin();
+
+				// 範囲チェック.
+				if (0 < (total_step_cell - cell_range).GetMax()) break;
+			}
+
+			return false;
+		}
+
 		// MultiGrid Brick Cell 最近接ヒット処理とそのPayloadの定義. MultiGridTraceCellHitProcessとは違い更にBrick内OccupancyCellとのヒットを取る.
 		struct MultiGridTraceCellBrickClosestHitProcess
 		{
 			const HierarchicalOccupancyGrid& grid_impl;
+			// 複数Rayのトレース時に共有するキャッシュ. nullptrの場合は毎回Rootから探索.
+			CellDataFetchCache* fetch_cache = nullptr;
 
 			struct Payload
 			{
@@ -1073,12 +1718,6 @@ namespace naga
 			bool operator()(const GridRayTraceRayUniform& ray_uniform, const GridRayTraceVisitCellUniform& visit_cell_param, Payload& ray_payload)
 			{
 				constexpr int k_brick_size = 4;
-				constexpr int k_brick_max_range = k_brick_size - 1;
-				// ベクトルの要素逆数ベクトルを返す. 0除算はFLT_MAX.
-				static constexpr auto CalcSafeDirInverse = [](const FVector& ray_dir) -> FVector
-				{
-					return FVector((FMath::IsNearlyZero(ray_dir.X)) ? FLT_MAX : 1.0f / ray_dir.X, (FMath::IsNearlyZero(ray_dir.Y)) ? FLT_MAX : 1.0f / ray_dir.Y, (FMath::IsNearlyZero(ray_dir.Z)) ? FLT_MAX : 1.0f / ray_dir.Z);
-				};
 
 				// リーフのみ処理.
 				if (grid_impl.k_multigrid_max_depth != visit_cell_param.depth)
@@ -1088,7 +1727,7 @@ namespace naga
 					return false;
 
 				// Gridの実体から該当DepthのCell情報を読み出し.
-				const auto [cell_data, cell_depth] = grid_impl.GetGridCellData(visit_cell_param.depth, visit_cell_param.cell_id);
+				const auto cell_data = (fetch_cache) ? grid_impl.GetGridCellDataCached(visit_cell_param.depth, visit_cell_param.cell_id, *fetch_cache) : std::get<0>(grid_impl.GetGridCellData(visit_cell_param.depth, visit_cell_param.cell_id));
 				// CellがEmpty(無効)ならヒットなし.
 				if (cell_data == ~0u)
 					return false;
@@ -1100,97 +1739,80 @@ namespace naga
 					return false;
 
 
-				// ヒット座標(Cell空間)
-				const auto trace_pos_c = ray_uniform.ray_origin + ray_uniform.ray_length * ray_uniform.ray_dir * (visit_cell_param.ray_t);// float誤差で微小にセルの整数に届かない場合があるので注意.
-				// ヒット座標のCell内ローカル座標[0, 1]. float誤差で整数Cellに届いていない場合があるため clamp(0,1)を取っている点に注意.
-				// trace_pos_cはRootGrid空間であるため, 到達Cellの階層における解像度スケールを乗じて cell_id と同じ空間に持っていく.
-				const auto trace_pos_c_frac = math::FVectorClamp(trace_pos_c * visit_cell_param.resolution_per_root_cell - FVector(visit_cell_param.cell_id), FVector::ZeroVector, FVector::OneVector);
+				return TraverseBrickCell(ray_uniform, visit_cell_param, [&brick, &ray_uniform, &visit_cell_param, &ray_payload](const FIntVector& trace_cell_id, int cell_index, float total_delta)
+				{
+					if (!(brick.occupancy_4x4x4 & (uint64_t(1) << uint64_t(cell_index))))
+						return false;
 
-				const auto brick_aabb_t_min = (FVector::ZeroVector - trace_pos_c_frac) * ray_uniform.ray_dir_inv;
-				const auto brick_aabb_t_max = (FVector::OneVector - trace_pos_c_frac) * ray_uniform.ray_dir_inv;
-				const auto t0 = FVector::Min(brick_aabb_t_min, brick_aabb_t_max).GetMax();
-				const auto t1 = FVector::Max(brick_aabb_t_min, brick_aabb_t_max).GetMin();
+					// t更新.
+					ray_payload.ray_t = total_delta;
+					// ヒット位置更新. Grid空間座標. 微少値でCell外になる場合があるためEpsilon加算.
+					ray_payload.hit_pos = (ray_payload.ray_t + FLT_EPSILON) * ray_uniform.ray_dir * ray_uniform.ray_length + ray_uniform.ray_origin;
+					// 深度.
+					ray_payload.depth = visit_cell_param.depth;
 
-				// Cellから外部に出る地点.
-				const auto cell_out_frac = FVector::Max(FVector::ZeroVector, trace_pos_c_frac + t1 * ray_uniform.ray_dir);
+					// ヒット面の法線.
+					{
+						// ヒット位置のBrickCell中心からの相対位置で法線計算.
+						const auto brick_elem_center = (((FVector(trace_cell_id) + FVector(0.5)) / k_brick_size) + FVector(visit_cell_param.cell_id)) / visit_cell_param.resolution_per_root_cell;
+						const auto hitpos_from_center = (ray_payload.hit_pos - brick_elem_center);
+						const auto hitpos_from_center_sign = hitpos_from_center.GetSignVector();
+						const auto hitpos_from_center_abs = hitpos_from_center.GetAbs();
+						// 中心からのベクトルで最大要素軸を法線として返す.
+						const auto hitpos_from_center_abs_max_cmp = math::FVectorCompareGreater(hitpos_from_center_abs,
+							FVector::Max(FVector(hitpos_from_center_abs.Y, hitpos_from_center_abs.Z, hitpos_from_center_abs.X), FVector(hitpos_from_center_abs.Z, hitpos_from_center_abs.X, hitpos_from_center_abs.Y)));
+
+						ray_payload.hit_normal = (FVector(hitpos_from_center_abs_max_cmp) * hitpos_from_center_sign).GetSafeNormal();// すべて等値でもSafeNormalで一応ベクトルが返る.
+					}
 
-				const auto brick_rd = (cell_out_frac - trace_pos_c_frac) * k_brick_size;
-				const auto brick_rd_inv = CalcSafeDirInverse(brick_rd);
+					// ヒット. 始点から順にトレースしているためClosestHitは最初のHitで良いはず. ヒットをとりながら積算するような場合はこの挙動を変える.
+					return true;
+				});
+			}
+		};
 
-				//Brick内t値の全体t値に対するスケール. 到達Cell自体の解像度スケールとBrickの解像度を考慮する.
-				const auto t_scale = (1.0f / (k_brick_size * visit_cell_param.resolution_per_root_cell)) * (brick_rd.Length() / ray_uniform.ray_length);
+		// LogOddsモードの除去処理. Rayが通過する割当済みBrickの, Rayが横切る全要素のカウンタをミスとして減算する.
+		//	閾値を下回った要素のビットを落とす. 複数Rayから並列に呼び出されるためカウンタとビットはアトミックに更新する. Cellの割当は変化しない.
+		struct MultiGridTraceBrickMissProcess
+		{
+			HierarchicalOccupancyGrid& grid_impl;
+			// 複数Rayのトレース時に共有するキャッシュ. nullptrの場合は毎回Rootから探索.
+			CellDataFetchCache* fetch_cache = nullptr;
+			// 処理後にビットが空のBrickと, その中心のワールド座標の記録先. 返却候補. nullptrの場合は記録しない.
+			TMap<GridCellAddrType, FVector>* out_unoccupied_brick = nullptr;
 
-				const auto dir_sign = ray_uniform.ray_dir.GetSignVector();
-				const auto delta = FVector::Min(dir_sign * brick_rd_inv, FVector::OneVector) * t_scale;
+			struct Payload
+			{
+			};
+			// Rayの終点まで全Brickを巡回するため常にfalseを返す.
+			bool operator()(const GridRayTraceRayUniform& ray_uniform, const GridRayTraceVisitCellUniform& visit_cell_param, Payload& ray_payload)
+			{
+				// リーフのみ処理.
+				if (grid_impl.k_multigrid_max_depth != visit_cell_param.depth)
+					return false;
 
-				const auto begin_cell_pos = math::FVectorClamp(trace_pos_c_frac * k_brick_size, FVector::ZeroVector, FVector(k_brick_size - FLT_EPSILON));
-				const auto begin_cell = math::FIntVectorMin(FIntVector(k_brick_max_range), math::FVectorFloorToInt(begin_cell_pos));
-				const auto end_cell = math::FIntVectorMin(FIntVector(k_brick_max_range), math::FVectorFloorToInt(cell_out_frac * k_brick_size));
-				const auto cell_range = math::FIntVectorAbs(end_cell - begin_cell);
-				const auto t_max_base = ((FVector(begin_cell) + FVector::Max(dir_sign, FVector::ZeroVector) - begin_cell_pos) * brick_rd_inv).GetAbs() * t_scale;
+				const auto cell_data = (fetch_cache) ? grid_impl.GetGridCellDataCached(visit_cell_param.depth, visit_cell_param.cell_id, *fetch_cache) : std::get<0>(grid_impl.GetGridCellData(visit_cell_param.depth, visit_cell_param.cell_id));
+				if (cell_data == ~0u)
+					return false;
 
-				float last_delta = 0.0f;
-				FIntVector total_step_cell = FIntVector::ZeroValue;
-				FIntVector prev_step = FIntVector::ZeroValue;
-				for (;;)
+				check(cell_data < static_cast<uint32_t>(grid_impl.log_odds_brick_pool_.Num()));
+				auto& brick = grid_impl.bit_occupancy_brick_pool_[cell_data];
+				auto& log_odds_brick = grid_impl.log_odds_brick_pool_[cell_data];
+				const auto& param = grid_impl.log_odds_param_;
+				TraverseBrickCell(ray_uniform, visit_cell_param, [&brick, &log_odds_brick, &param](const FIntVector& trace_cell_id, int cell_index, float total_delta)
 				{
-					const auto trace_cell_id = begin_cell + FIntVector(dir_sign) * total_step_cell;
-					const auto cell_index = (trace_cell_id.X) + (trace_cell_id.Y * k_brick_size) + (trace_cell_id.Z * k_brick_size * k_brick_size);
-
-					const auto total_delta = visit_cell_param.ray_t + (last_delta);
-
-					// CellId範囲チェックとは別にt値のチェック. CellID範囲チェックだけでは広いルート階層換算での終了判定なので実際には線分の範囲外になっても継続してしまうため.
-					if (1.0f <= total_delta)
-						return false;
-
-					if (brick.occupancy_4x4x4 & (uint64_t(1) << uint64_t(cell_index)))
-					{
-						// t更新.
-						ray_payload.ray_t = total_delta;
-						// ヒット位置更新. Grid空間座標. 微少値でCell外になる場合があるためEpsilon加算.
-						ray_payload.hit_pos = (ray_payload.ray_t + FLT_EPSILON) * ray_uniform.ray_dir * ray_uniform.ray_length + ray_uniform.ray_origin;
-						// 深度.
-						ray_payload.depth = visit_cell_param.depth;
-
-						// ヒット面の法線.
-						{
-							// ヒット位置のBrickCell中心からの相対位置で法線計算.
-							const auto brick_elem_center = (((FVector(trace_cell_id) + FVector(0.5)) / k_brick_size) + FVector(visit_cell_param.cell_id)) / visit_cell_param.resolution_per_root_cell;
-							const auto hitpos_from_center = (ray_payload.hit_pos - brick_elem_center);
-							const auto hitpos_from_center_sign = hitpos_from_center.GetSignVector();
-							const auto hitpos_from_center_abs = hitpos_from_center.GetAbs();
-							// 中心からのベクトルで最大要素軸を法線として返す.
-							const auto hitpos_from_center_abs_max_cmp = math::FVectorCompareGreater(hitpos_from_center_abs,
-								FVector::Max(FVector(hitpos_from_center_abs.Y, hitpos_from_center_abs.Z, hitpos_from_center_abs.X), FVector(hitpos_from_center_abs.Z, hitpos_from_center_abs.X, hitpos_from_center_abs.Y)));
-
-							ray_payload.hit_normal = (FVector(hitpos_from_center_abs_max_cmp) * hitpos_from_center_sign).GetSafeNormal();// すべて等値でもSafeNormalで一応ベクトルが返る.
-						}
-
-						// ヒット. 始点から順にトレースしているためClosestHitは最初のHitで良いはず. ヒットをとりながら積算するような場合はこの挙動を変える.
-						return true;
-					}
-					// Next Step.
-					const auto next_t = t_max_base + FVector(total_step_cell) * delta;
-					// xyzで最小値コンポーネントを探す.
-					prev_step = math::FVectorCompareLessEqual(next_t, FVector::Min(FVector(next_t.Y, next_t.Z, next_t.X), FVector(next_t.Z, next_t.X, next_t.Y)));// Equal無しだとすべて等値だった場合に進行できないため.
-					if constexpr (true)
-					{
-						// 厳密にセルを巡回するために最小コンポーネントが複数あった場合に一つに制限する(XYZの順で優先.). 
-						// この処理をしない場合は (0,0,0)の中心からズレたラインで(1,0,0)などを経由せずに(1,1,1)に移動する.
-						auto tmp = prev_step.X;
-						prev_step.Y = (0 < tmp) ? 0 : prev_step.Y;
-						tmp += prev_step.Y;
-						prev_step.Z = (0 < tmp) ? 0 : prev_step.Z;
-					}
-					// ステップは整数ベースで進める.
-					total_step_cell += prev_step;
-					last_delta = next_t.GetMin();
-
-					// 範囲チェック.
-					if (0 < (total_step_cell - cell_range).GetMax()) break;
+					// 閾値をまたいだRayのみがビットを落とす. 除去パスでは減算のみのため閾値をまたぐRayは一つ.
+					const int prev_counter = log_odds_brick.AddAtomic(trace_cell_id.X, trace_cell_id.Y, trace_cell_id.Z, -param.miss);
+					if (param.occupied_threshold <= prev_counter && param.occupied_threshold > prev_counter - param.miss)
+						brick.Set0Atomic(trace_cell_id.X, trace_cell_id.Y, trace_cell_id.Z);
+					return false;
+				});
+				// 除去パスではビットは落ちるのみのため, ここで空であれば並列処理後も空.
+				if (out_unoccupied_brick && 0 == brick.occupancy_4x4x4 && !out_unoccupied_brick->Contains(cell_data))
+				{
+					const auto brick_center = (FVector(visit_cell_param.cell_id) + FVector(0.5)) / visit_cell_param.resolution_per_root_cell;
+					out_unoccupied_brick->Add(cell_data, grid_impl.bgrid_.RootGridSpaceToWorld(brick_center));
 				}
-
-				// ヒットせず.
 				return false;
 			}
 		};
@@ -1222,6 +1844,108 @@ namespace naga
 			return false;
 		}
 
+		// 複数Rayのトレース結果. Ray毎の要素をSoAで保持する.
+		struct TraceBatchResult
+		{
+			TArray<bool>		is_hit;
+			TArray<FVector>		hit_pos_ws;
+			TArray<FVector>		hit_normal_ws;
+			TArray<float>		ray_t;
+		};
+		// 複数Rayのトレース. TraceSingleと同じ判定を全Rayに対して実行する.
+		//	ray_origin_ws	: Ray始点. 要素数1の場合は全Rayで共有する.
+		//	ray_end_ws		: Ray終点.
+		// 始点と終点のセル位置でソートした順にトレースし, RootからのCell探索結果をRay間で共有する. 結果は入力順に格納される.
+		// ソート後の連続するRay群毎に並列にトレースする. Gridの書き換えと並行して呼び出さないこと.
+		void TraceBatch(TConstArrayView<FVector> ray_origin_ws, TConstArrayView<FVector> ray_end_ws, TraceBatchResult& out_result) const
+		{
+			const int ray_count = ray_end_ws.Num();
+			check(1 == ray_origin_ws.Num() || ray_count == ray_origin_ws.Num());
+
+			out_result.is_hit.SetNumUninitialized(ray_count);
+			out_result.hit_pos_ws.SetNumUninitialized(ray_count);
+			out_result.hit_normal_ws.SetNumUninitialized(ray_count);
+			out_result.ray_t.SetNumUninitialized(ray_count);
+			if (0 >= ray_count || 0 >= ray_origin_ws.Num())
+				return;
+
+			// 始点と終点の近いRayが連続するようにソート. RootCellを16分割した解像度のモートンコードをキーとする.
+			constexpr float k_sort_cell_scale = 16.0f;
+			const auto CalcSortCode = [this](const FVector& pos_ws) -> uint64_t
+			{
+				const auto cell = math::FVectorFloorToInt(bgrid_.WorldToRootGridSpace(pos_ws) * k_sort_cell_scale);
+				return math::EncodeMortonCodeX10Y10Z10(cell.X, cell.Y, cell.Z);
+			};
+			TArray<std::tuple<uint64_t, int>> sorted_ray;
+			sorted_ray.SetNumUninitialized(ray_count);
+			for (int i = 0; i < ray_count; ++i)
+			{
+				const auto& origin = ray_origin_ws[(1 == ray_origin_ws.Num()) ? 0 : i];
+				sorted_ray[i] = std::make_tuple((CalcSortCode(origin) << 32) | CalcSortCode(ray_end_ws[i]), i);
+			}
+			sorted_ray.Sort([](const std::tuple<uint64_t, int>& a, const std::tuple<uint64_t, int>& b) { return std::get<0>(a) < std::get<0>(b); });
+
+			// ソート順に連続するRayを1ジョブとして並列トレース. キャッシュはジョブ毎.
+			constexpr int k_trace_job_size = 1024;
+			ParallelFor(FMath::DivideAndRoundUp(ray_count, k_trace_job_size), [this, ray_count, &ray_origin_ws, &ray_end_ws, &sorted_ray, &out_result](int32 job_index)
+			{
+				CellDataFetchCache fetch_cache;
+				MultiGridTraceCellBrickClosestHitProcess cell_hit_process = { *this, &fetch_cache };
+				TraceCellDepthDescendingCheckerForMultiGrid depth_descending = { *this, &fetch_cache };
+
+				const int end_i = FMath::Min(ray_count, (job_index + 1) * k_trace_job_size);
+				for (int i = job_index * k_trace_job_size; i < end_i; ++i)
+				{
+					const int ray_index = std::get<1>(sorted_ray[i]);
+					const auto& origin = ray_origin_ws[(1 == ray_origin_ws.Num()) ? 0 : ray_index];
+
+					decltype(cell_hit_process)::Payload payload = {};
+					bgrid_.TraceHierarchicalGrid<true, k_child_cell_reso, k_multigrid_max_depth>(origin, ray_end_ws[ray_index], payload, cell_hit_process, depth_descending);
+
+					const bool is_hit = FLT_MAX > payload.ray_t;
+					out_result.is_hit[ray_index] = is_hit;
+					out_result.hit_pos_ws[ray_index] = (is_hit) ? bgrid_.RootGridSpaceToWorld(payload.hit_pos) : FVector::ZeroVector;
+					out_result.hit_normal_ws[ray_index] = (is_hit) ? payload.hit_normal : FVector::ZeroVector;
+					out_result.ray_t[ray_index] = payload.ray_t;
+				}
+			});
+		}
+
+		// GetGridCellData<false>のキャッシュ版. 親Cellの探索結果をキャッシュから取得し, 子Cellへは1段のみ辿る.
+		GridCellAddrType GetGridCellDataCached(int depth, const FIntVector& cell, CellDataFetchCache& cache) const
+		{
+			check(k_multigrid_max_depth >= depth);
+			if (0 > cell.GetMin())
+				return k_invalid_u32;
+			if (0 == depth)
+			{
+				if (bgrid_.k_root_grid_reso <= cell.GetMax())
+					return k_invalid_u32;// Root範囲外.
+				return bgrid_.root_cell_data_[bgrid_.CalcRootCellIndex(cell)];
+			}
+
+			auto& entry = cache.FindEntry(depth, cell);
+			if (depth == entry.depth && cell == entry.cell)
+				return entry.addr;
+
+			// 負の領域は除外済みのため除算で親Cellを求められる.
+			const FIntVector parent_cell = cell / k_child_cell_reso;
+			const auto parent_addr = GetGridCellDataCached(depth - 1, parent_cell, cache);
+			GridCellAddrType addr = k_invalid_u32;
+			if (k_invalid_u32 != parent_addr)
+			{
+				const FIntVector local_cell = cell - parent_cell * k_child_cell_reso;
+				const auto local_cell_index = local_cell.X + (local_cell.Y * k_child_cell_reso) + (local_cell.Z * k_child_cell_reso * k_child_cell_reso);
+				addr = cell_pool_[parent_addr].child_addr[local_cell_index];
+			}
+			// 親の探索で同じエントリが上書きされている可能性があるため再取得.
+			auto& store_entry = cache.FindEntry(depth, cell);
+			store_entry.cell = cell;
+			store_entry.depth = depth;
+			store_entry.addr = addr;
+			return addr;
+		}
+
 		// Cellデータの取得. 呼び出すたびにRootから探索.
 		//	depth:0, XYZ -> RootのXYZ位置のデータ, depth:1, XYZ -> Root直下のCellのXYZ位置のデータ.
 		//	GetReachableによって指定Cellに到達しなかった場合の戻り値が変わる.
@@ -1294,13 +2018,21 @@ namespace naga
 		float					bottom_cell_width_ws_ = 1.0f;
 		float					brick_elem_width_ws_ = 1.0f;
 
-		// Cellプール.
-		TBitArray<> cell_pool_flag_ = {};
+		// Cellプール. 要素数は割当容量で, 使用中の要素はアロケータで管理する.
+		ConcurrentPoolIndexAllocator cell_pool_alloc_ = {};
 		TArray<CellData> cell_pool_ = {};
 
-		// リーフのBrickプール.
-		TBitArray<> bit_occupancy_brick_pool_flag_ = {};
+		// リーフのBrickプール. 要素数は割当容量で, 使用中の要素はアロケータで管理する.
+		ConcurrentPoolIndexAllocator bit_occupancy_brick_pool_alloc_ = {};
 		TArray<OccupancyGridLeafData> bit_occupancy_brick_pool_ = {};
+		// LogOddsモード用のBrickプール. bit_occupancy_brick_pool_と同じインデックスで対応する.
+		bool use_log_odds_ = false;
+		OccupancyLogOddsParam log_odds_param_ = {};
+		TArray<OccupancyGridLeafLogOdds> log_odds_brick_pool_ = {};
+
+		// UpdateOccupancy用ワーク. RootCellインデックスとサンプルインデックスのキー, RootCell毎のキー範囲.
+		TArray<uint64_t> update_sample_key_ = {};
+		TArray<int> update_root_cell_begin_ = {};
 
 		TBitArray<> particle_pool_flag_ = {};
 		struct ParticleTestData
@@ -369,6 +369,60 @@ namespace naga
 		static_assert(0b0110000100000000000111ull == BitCompact2_u64(BitSeparate2_u64(0b0110000100000000000111ull)));
 		static_assert(0x2fffffull == BitCompact2_u64(BitSeparate2_u64(0x2fffffull)));
 
+		//	与えられたビット列を1bit飛ばしに変換
+		//	0111 -> 010101
+		static constexpr uint32_t BitSeparate1(uint32_t v)
+		{
+			v = v &					0x0000FFFFu;
+			v = (v | (v << 8)) &	0x00FF00FFu;
+			v = (v | (v << 4)) &	0x0F0F0F0Fu;
+			v = (v | (v << 2)) &	0x33333333u;
+			v = (v | (v << 1)) &	0x55555555u;
+			return v;
+		}
+		//	与えられたビット列を1bitずつ詰めて返す. 奇数ビットは無視される.
+		//	010101 -> 0111
+		static constexpr uint32_t BitCompact1(uint32_t v)
+		{
+			v = v &					0x55555555u;
+			v = (v | (v >> 1)) &	0x33333333u;
+			v = (v | (v >> 2)) &	0x0F0F0F0Fu;
+			v = (v | (v >> 4)) &	0x00FF00FFu;
+			v = (v | (v >> 8)) &	0x0000FFFFu;
+			return v;
+		}
+		static_assert(0b010101u == BitSeparate1(0b0111u));
+		static_assert(0b0111u == BitCompact1(0b010101u));
+		static_assert(0xffffu == BitCompact1(BitSeparate1(0xffffu)));
+
+		//	与えられたビット列を1bit飛ばしに変換(64bit)
+		//	0111 -> 010101
+		static constexpr uint64_t BitSeparate1_u64(uint64_t v)
+		{
+			v = v &						0x00000000FFFFFFFFull;
+			v = (v | (v << 16ull)) &	0x0000FFFF0000FFFFull;
+			v = (v | (v << 8ull)) &		0x00FF00FF00FF00FFull;
+			v = (v | (v << 4ull)) &		0x0F0F0F0F0F0F0F0Full;
+			v = (v | (v << 2ull)) &		0x3333333333333333ull;
+			v = (v | (v << 1ull)) &		0x5555555555555555ull;
+			return v;
+		}
+		//	与えられたビット列を1bitずつ詰めて返す(64bit). 奇数ビットは無視される.
+		//	010101 -> 0111
+		static constexpr uint64_t BitCompact1_u64(uint64_t v)
+		{
+			v = v &						0x5555555555555555ull;
+			v = (v | (v >> 1ull)) &		0x3333333333333333ull;
+			v = (v | (v >> 2ull)) &		0x0F0F0F0F0F0F0F0Full;
+			v = (v | (v >> 4ull)) &		0x00FF00FF00FF00FFull;
+			v = (v | (v >> 8ull)) &		0x0000FFFF0000FFFFull;
+			v = (v | (v >> 16ull)) &	0x00000000FFFFFFFFull;
+			return v;
+		}
+		static_assert(0b010101ull == BitSeparate1_u64(0b0111ull));
+		static_assert(0xffffffffull == BitCompact1_u64(BitSeparate1_u64(0xffffffffull)));
+		static_assert(0x80000001ull == BitCompact1_u64(0x4000000000000001ull));
+
 
 		// in : [0 , 1023]
 		// 3Dセル座標から符号付き32bitモートンコード計算. 入力は各軸10bitまで.
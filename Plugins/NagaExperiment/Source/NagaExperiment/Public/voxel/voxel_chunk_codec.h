@@ -0,0 +1,222 @@
+﻿// @author: @nagakagachi
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <assert.h>
+
+namespace naga
+{
+	// 1bitVoxelチャンクのRow列の圧縮.
+	// 1bitVoxelでは値の種類によるパレット化は意味が無いため, X軸Row(ビット列)を単位として以下のモードから最小のものを選択する.
+	//	Uniform		: 全Rowが同一. 空や完全に埋まったチャンク.
+	//	RowRle		: 同一Rowの連続を {連続数, Row} で表現. 地表から離れた層が多いチャンク.
+	//	RowPalette	: 出現するRowの種類をパレット化し, Row毎に4bitまたは8bitのインデックスで表現.
+	//	Raw			: 非圧縮.
+	// Rowはrow_bit_countビット分のみ格納する(リトルエンディアン前提).
+	struct VoxelRowCodec
+	{
+		enum Mode : uint8
+		{
+			Raw,
+			Uniform,
+			RowRle,
+			RowPalette,
+		};
+
+		// パレットの最大数.
+		static constexpr int PALETTE_MAX = 256;
+		// RowRleの連続数の最大.
+		static constexpr int RUN_LENGTH_MAX = 0xffff;
+
+		// Rowの格納バイト数.
+		static constexpr int RowByteSize(unsigned int row_bit_count)
+		{
+			return static_cast<int>((row_bit_count + 7) / 8);
+		}
+
+		// rowsを圧縮してout_dataへ追加する.
+		template<typename RowType>
+		static void Encode(const RowType* rows, int row_count, unsigned int row_bit_count, TArray<uint8>& out_data)
+		{
+			static_assert(std::is_unsigned<RowType>::value, "RowType must be unsigned.");
+			assert(sizeof(RowType) * 8 >= row_bit_count);
+
+			const int row_byte_size = RowByteSize(row_bit_count);
+
+			// 連続数とパレット数を数える.
+			int run_count = 0;
+			TArray<RowType, TInlineAllocator<PALETTE_MAX>> palette;
+			for (int i = 0; i < row_count; ++i)
+			{
+				if (0 == i || rows[i] != rows[i - 1])
+					++run_count;
+				if (PALETTE_MAX >= palette.Num() && INDEX_NONE == palette.Find(rows[i]))
+					palette.Add(rows[i]);
+			}
+			// パレット化できない場合はPALETTE_MAXを超える.
+			const int palette_count = palette.Num();
+
+			// 各モードのサイズ.
+			const int raw_size = row_count * row_byte_size;
+			const int rle_size = sizeof(uint16) + run_count * (sizeof(uint16) + row_byte_size);
+			const int palette_index_bit = (16 >= palette_count) ? 4 : 8;
+			const int palette_size = (PALETTE_MAX >= palette_count) ? (sizeof(uint16) + palette_count * row_byte_size + (row_count * palette_index_bit + 7) / 8) : MAX_int32;
+
+			if (1 >= palette_count)
+			{
+				out_data.Add(Mode::Uniform);
+				WriteRow(out_data, (0 < row_count) ? rows[0] : RowType(0), row_byte_size);
+			}
+			else if (rle_size <= palette_size && rle_size < raw_size)
+			{
+				out_data.Add(Mode::RowRle);
+				const int count_pos = out_data.AddUninitialized(sizeof(uint16));
+				uint16 written_run_count = 0;
+				for (int i = 0; i < row_count;)
+				{
+					int run_length = 1;
+					for (; i + run_length < row_count && RUN_LENGTH_MAX > run_length && rows[i + run_length] == rows[i]; ++run_length)
+					{
+					}
+					WriteU16(out_data, static_cast<uint16>(run_length));
+					WriteRow(out_data, rows[i], row_byte_size);
+					++written_run_count;
+					i += run_length;
+				}
+				FMemory::Memcpy(out_data.GetData() + count_pos, &written_run_count, sizeof(written_run_count));
+			}
+			else if (palette_size < raw_size)
+			{
+				out_data.Add(Mode::RowPalette);
+				WriteU16(out_data, static_cast<uint16>(palette_count));
+				for (auto&& e : palette)
+					WriteRow(out_data, e, row_byte_size);
+
+				// インデックスを詰めて格納.
+				const int index_pos = out_data.AddZeroed((row_count * palette_index_bit + 7) / 8);
+				uint8* index_data = out_data.GetData() + index_pos;
+				for (int i = 0; i < row_count; ++i)
+				{
+					const uint8 index = static_cast<uint8>(palette.Find(rows[i]));
+					if (4 == palette_index_bit)
+						index_data[i >> 1] |= index << ((i & 0x01) * 4);
+					else
+						index_data[i] = index;
+				}
+			}
+			else
+			{
+				out_data.Add(Mode::Raw);
+				for (int i = 0; i < row_count; ++i)
+					WriteRow(out_data, rows[i], row_byte_size);
+			}
+		}
+
+		// dataを展開してout_rowsへ書き込む. 形式やRow数が一致しない場合はfalse.
+		template<typename RowType>
+		static bool Decode(const uint8* data, int data_size, RowType* out_rows, int row_count, unsigned int row_bit_count)
+		{
+			static_assert(std::is_unsigned<RowType>::value, "RowType must be unsigned.");
+
+			const int row_byte_size = RowByteSize(row_bit_count);
+			if (1 > data_size)
+				return false;
+
+			const uint8* cur = data + 1;
+			const uint8* end = data + data_size;
+			switch (data[0])
+			{
+			case Mode::Uniform:
+			{
+				if (cur + row_byte_size != end)
+					return false;
+				const auto v = ReadRow<RowType>(cur, row_byte_size);
+				for (int i = 0; i < row_count; ++i)
+					out_rows[i] = v;
+				return true;
+			}
+			case Mode::RowRle:
+			{
+				if (cur + sizeof(uint16) > end)
+					return false;
+				const int run_count = ReadU16(cur);
+				if (cur + run_count * (sizeof(uint16) + row_byte_size) != end)
+					return false;
+				int row_index = 0;
+				for (int ri = 0; ri < run_count; ++ri)
+				{
+					const int run_length = ReadU16(cur);
+					const auto v = ReadRow<RowType>(cur, row_byte_size);
+					if (row_index + run_length > row_count)
+						return false;
+					for (int i = 0; i < run_length; ++i)
+						out_rows[row_index + i] = v;
+					row_index += run_length;
+				}
+				return row_index == row_count;
+			}
+			case Mode::RowPalette:
+			{
+				if (cur + sizeof(uint16) > end)
+					return false;
+				const int palette_count = ReadU16(cur);
+				const int palette_index_bit = (16 >= palette_count) ? 4 : 8;
+				if (PALETTE_MAX < palette_count || cur + palette_count * row_byte_size + (row_count * palette_index_bit + 7) / 8 != end)
+					return false;
+				RowType palette[PALETTE_MAX];
+				for (int i = 0; i < palette_count; ++i)
+					palette[i] = ReadRow<RowType>(cur, row_byte_size);
+				for (int i = 0; i < row_count; ++i)
+				{
+					const int index = (4 == palette_index_bit) ? ((cur[i >> 1] >> ((i & 0x01) * 4)) & 0x0f) : cur[i];
+					if (palette_count <= index)
+						return false;
+					out_rows[i] = palette[index];
+				}
+				return true;
+			}
+			case Mode::Raw:
+			{
+				if (cur + row_count * row_byte_size != end)
+					return false;
+				for (int i = 0; i < row_count; ++i)
+					out_rows[i] = ReadRow<RowType>(cur, row_byte_size);
+				return true;
+			}
+			default:
+				return false;
+			}
+		}
+
+	private:
+		template<typename RowType>
+		static void WriteRow(TArray<uint8>& out_data, RowType v, int row_byte_size)
+		{
+			const int pos = out_data.AddUninitialized(row_byte_size);
+			FMemory::Memcpy(out_data.GetData() + pos, &v, row_byte_size);
+		}
+		template<typename RowType>
+		static RowType ReadRow(const uint8*& cur, int row_byte_size)
+		{
+			RowType v = 0;
+			FMemory::Memcpy(&v, cur, row_byte_size);
+			cur += row_byte_size;
+			return v;
+		}
+		static void WriteU16(TArray<uint8>& out_data, uint16 v)
+		{
+			const int pos = out_data.AddUninitialized(sizeof(v));
+			FMemory::Memcpy(out_data.GetData() + pos, &v, sizeof(v));
+		}
+		static uint16 ReadU16(const uint8*& cur)
+		{
+			uint16 v = 0;
+			FMemory::Memcpy(&v, cur, sizeof(v));
+			cur += sizeof(v);
+			return v;
+		}
+	};
+}
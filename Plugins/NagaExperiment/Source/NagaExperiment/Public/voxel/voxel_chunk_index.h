@@ -0,0 +1,243 @@
+﻿// @author: @nagakagachi
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace naga
+{
+	// チャンクIDからチャンクへの索引.
+	// チャンクIDの各軸の下位ビットで引くトーラス状のリングバッファ3D配列と, リング上で衝突したチャンク用の疎なTMapで構成する.
+	// SetCenterで指定した中心から各軸RING_RESOLUTION個の範囲(リング窓)のチャンクは常にリングに格納する.
+	// リング窓内のIDの検索は, 存在しない場合も含めてハッシュ計算無しの配列参照となる. リング窓外のIDはTMapを引く.
+	// 
+	// 同じリングスロットに対応する要素は双方向リストで連結し, 先頭をリングに, それ以外をTMapに登録する.
+	// リスト先頭の除去時は次の要素をリングへ昇格するため, 除去はTMapの走査無しの定数時間となる.
+	// 
+	// 要素本体は走査用の連続配列に格納し, リングとTMapはその添字を保持する.
+	// TMapと同様に要素の追加や削除で既存要素のアドレスは変化する.
+	template<typename ValueType, int RING_RESOLUTION_LOG2 = 5>
+	class VoxelChunkIndexT
+	{
+	public:
+		using ElementType = TPair<FIntVector, ValueType>;
+
+		static constexpr int RING_RESOLUTION = 1 << RING_RESOLUTION_LOG2;
+		static constexpr int RING_MASK = RING_RESOLUTION - 1;
+		static constexpr int RING_SIZE = RING_RESOLUTION * RING_RESOLUTION * RING_RESOLUTION;
+
+		VoxelChunkIndexT()
+		{
+			ring_.Init(INDEX_NONE, RING_SIZE);
+		}
+
+		// リング窓の中心を設定. リング窓内となった要素をリングへ移す. 処理はTMapの要素数に比例.
+		void SetCenter(const FIntVector& center)
+		{
+			const FIntVector new_origin = center - FIntVector(RING_RESOLUTION / 2);
+			if (new_origin == ring_origin_)
+				return;
+			ring_origin_ = new_origin;
+
+			if (0 == sparse_.Num())
+				return;
+			TArray<int32> promote_list;
+			for (auto&& e : sparse_)
+			{
+				if (IsInRingWindow(e.Key))
+					promote_list.Add(e.Value);
+			}
+			for (const int32 element_index : promote_list)
+				MoveToChainHead(element_index);
+		}
+
+		// 検索. 存在しない場合はnullptr.
+		ValueType* Find(const FIntVector& chunk_id)
+		{
+			const int32 element_index = FindElementIndex(chunk_id);
+			return (INDEX_NONE != element_index) ? &elements_[element_index].Value : nullptr;
+		}
+		const ValueType* Find(const FIntVector& chunk_id) const
+		{
+			const int32 element_index = FindElementIndex(chunk_id);
+			return (INDEX_NONE != element_index) ? &elements_[element_index].Value : nullptr;
+		}
+		bool Contains(const FIntVector& chunk_id) const
+		{
+			return INDEX_NONE != FindElementIndex(chunk_id);
+		}
+
+		// 検索し, 存在しない場合はデフォルト値で追加する.
+		ValueType& FindOrAdd(const FIntVector& chunk_id)
+		{
+			const int32 find_index = FindElementIndex(chunk_id);
+			if (INDEX_NONE != find_index)
+				return elements_[find_index].Value;
+
+			const int32 element_index = elements_.Emplace(chunk_id, ValueType());
+			chain_.Add(ChainLink());
+			int32& ring_slot = ring_[CalcRingIndex(chunk_id)];
+			if (INDEX_NONE == ring_slot)
+			{
+				ring_slot = element_index;
+			}
+			else if (IsInRingWindow(chunk_id))
+			{
+				// リング窓内の要素はリスト先頭へ挿入.
+				const int32 head_index = ring_slot;
+				chain_[element_index].next = head_index;
+				chain_[head_index].prev = element_index;
+				ring_slot = element_index;
+				sparse_.Add(elements_[head_index].Key, head_index);
+			}
+			else
+			{
+				// リスト先頭の直後へ挿入.
+				const int32 head_index = ring_slot;
+				const int32 next_index = chain_[head_index].next;
+				chain_[element_index].prev = head_index;
+				chain_[element_index].next = next_index;
+				chain_[head_index].next = element_index;
+				if (INDEX_NONE != next_index)
+					chain_[next_index].prev = element_index;
+				sparse_.Add(chunk_id, element_index);
+			}
+			return elements_[element_index].Value;
+		}
+
+		// 除去. 存在しない場合はfalse.
+		bool Remove(const FIntVector& chunk_id)
+		{
+			const int32 element_index = FindElementIndex(chunk_id);
+			if (INDEX_NONE == element_index)
+				return false;
+
+			// リストから外す. 先頭の場合は次の要素をリングへ昇格する.
+			const ChainLink link = chain_[element_index];
+			if (INDEX_NONE == link.prev)
+			{
+				ring_[CalcRingIndex(chunk_id)] = link.next;
+				if (INDEX_NONE != link.next)
+					sparse_.Remove(elements_[link.next].Key);
+			}
+			else
+			{
+				chain_[link.prev].next = link.next;
+				sparse_.Remove(chunk_id);
+			}
+			if (INDEX_NONE != link.next)
+				chain_[link.next].prev = link.prev;
+
+			// 末尾要素で埋めて詰める.
+			const int32 last_index = elements_.Num() - 1;
+			if (element_index != last_index)
+			{
+				const FIntVector last_chunk_id = elements_[last_index].Key;
+				const ChainLink last_link = chain_[last_index];
+				if (INDEX_NONE == last_link.prev)
+				{
+					ring_[CalcRingIndex(last_chunk_id)] = element_index;
+				}
+				else
+				{
+					chain_[last_link.prev].next = element_index;
+					sparse_[last_chunk_id] = element_index;
+				}
+				if (INDEX_NONE != last_link.next)
+					chain_[last_link.next].prev = element_index;
+			}
+			chain_.RemoveAtSwap(element_index, 1, EAllowShrinking::No);
+			elements_.RemoveAtSwap(element_index, 1, EAllowShrinking::No);
+			return true;
+		}
+
+		void Empty()
+		{
+			elements_.Empty();
+			chain_.Empty();
+			sparse_.Empty();
+			for (auto&& e : ring_)
+				e = INDEX_NONE;
+		}
+		int32 Num() const
+		{
+			return elements_.Num();
+		}
+		// リングで衝突して疎なTMapに格納されている要素数.
+		int32 NumSparse() const
+		{
+			return sparse_.Num();
+		}
+
+		// 全要素の走査. 要素はKeyにチャンクID, Valueに値を持つ.
+		ElementType* begin() { return elements_.GetData(); }
+		ElementType* end() { return elements_.GetData() + elements_.Num(); }
+		const ElementType* begin() const { return elements_.GetData(); }
+		const ElementType* end() const { return elements_.GetData() + elements_.Num(); }
+
+	private:
+		// 同じリングスロットに対応する要素の連結. elements_の添字.
+		struct ChainLink
+		{
+			int32	prev = INDEX_NONE;
+			int32	next = INDEX_NONE;
+		};
+
+		bool IsInRingWindow(const FIntVector& chunk_id) const
+		{
+			const FIntVector local = chunk_id - ring_origin_;
+			return (static_cast<uint32>(local.X) < RING_RESOLUTION) && (static_cast<uint32>(local.Y) < RING_RESOLUTION) && (static_cast<uint32>(local.Z) < RING_RESOLUTION);
+		}
+		// TMapに格納されている要素をリスト先頭へ移し, 元の先頭をTMapへ移す.
+		void MoveToChainHead(int32 element_index)
+		{
+			const ChainLink link = chain_[element_index];
+			chain_[link.prev].next = link.next;
+			if (INDEX_NONE != link.next)
+				chain_[link.next].prev = link.prev;
+
+			int32& ring_slot = ring_[CalcRingIndex(elements_[element_index].Key)];
+			const int32 head_index = ring_slot;
+			chain_[element_index].prev = INDEX_NONE;
+			chain_[element_index].next = head_index;
+			chain_[head_index].prev = element_index;
+			ring_slot = element_index;
+
+			sparse_.Remove(elements_[element_index].Key);
+			sparse_.Add(elements_[head_index].Key, head_index);
+		}
+
+		static int32 CalcRingIndex(const FIntVector& chunk_id)
+		{
+			return (chunk_id.X & RING_MASK) | ((chunk_id.Y & RING_MASK) << RING_RESOLUTION_LOG2) | ((chunk_id.Z & RING_MASK) << (RING_RESOLUTION_LOG2 * 2));
+		}
+		int32 FindElementIndex(const FIntVector& chunk_id) const
+		{
+			const int32 ring_slot = ring_[CalcRingIndex(chunk_id)];
+			if (INDEX_NONE != ring_slot && elements_[ring_slot].Key == chunk_id)
+				return ring_slot;
+			// リング窓内の要素は必ずリスト先頭にある.
+			if (IsInRingWindow(chunk_id))
+				return INDEX_NONE;
+			if (0 < sparse_.Num())
+			{
+				if (const int32* sparse_slot = sparse_.Find(chunk_id))
+					return *sparse_slot;
+			}
+			return INDEX_NONE;
+		}
+
+	private:
+		// 要素本体.
+		TArray<ElementType>		elements_;
+		// elements_と同じ添字で, 同じリングスロットの要素の連結.
+		TArray<ChainLink>		chain_;
+		// リングバッファ3D配列. elements_の添字.
+		TArray<int32>			ring_;
+		// リング上で衝突した要素. elements_の添字.
+		TMap<FIntVector, int32>	sparse_;
+		// リング窓の最小のチャンクID.
+		FIntVector				ring_origin_ = FIntVector(-RING_RESOLUTION / 2);
+	};
+}
@@ -0,0 +1,185 @@
+﻿// @author: @nagakagachi
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/ScopeLock.h"
+
+namespace naga
+{
+	// 固定サイズブロックのプールアロケータ. チャンクのVoxel本体のように同一サイズの確保と解放を繰り返すデータ用.
+	// スラブ単位でまとめて確保し, 解放されたブロックはフリーリストで再利用する. 確保したスラブはプールの破棄まで解放しない.
+	// Asyncのワーカーから並列に確保と解放がされるためロックで保護する.
+	class VoxelFixedBlockPool
+	{
+	public:
+		static constexpr uint32 BLOCK_ALIGNMENT = 16;
+
+		VoxelFixedBlockPool(uint32 block_byte_size, uint32 slab_block_count)
+			: block_byte_size_(Align(FMath::Max(block_byte_size, 1u), BLOCK_ALIGNMENT))
+			, slab_block_count_(FMath::Max(slab_block_count, 1u))
+		{
+		}
+		~VoxelFixedBlockPool()
+		{
+			for (auto* slab : slabs_)
+			{
+				FMemory::Free(slab);
+			}
+		}
+		VoxelFixedBlockPool(const VoxelFixedBlockPool&) = delete;
+		VoxelFixedBlockPool& operator=(const VoxelFixedBlockPool&) = delete;
+
+		// ブロック確保. フリーリストが空の場合はスラブを追加する.
+		void* Allocate()
+		{
+			FScopeLock lock(&lock_);
+			if (0 >= free_blocks_.Num())
+				AddSlab();
+			return free_blocks_.Pop(EAllowShrinking::No);
+		}
+		// ブロック解放. フリーリストへ戻す.
+		void Free(void* block)
+		{
+			if (!block)
+				return;
+			FScopeLock lock(&lock_);
+			free_blocks_.Push(block);
+		}
+		// 指定数のブロックを確保済みの状態にする.
+		void Reserve(int block_count)
+		{
+			FScopeLock lock(&lock_);
+			while (NumBlocksNoLock() < block_count)
+				AddSlab();
+		}
+
+		uint32 GetBlockByteSize() const
+		{
+			return block_byte_size_;
+		}
+		// 確保済みのブロック総数.
+		int NumBlocks() const
+		{
+			FScopeLock lock(&lock_);
+			return NumBlocksNoLock();
+		}
+		// 未使用のブロック数.
+		int NumFreeBlocks() const
+		{
+			FScopeLock lock(&lock_);
+			return free_blocks_.Num();
+		}
+		// スラブの総サイズ.
+		size_t GetAllocatedSize() const
+		{
+			FScopeLock lock(&lock_);
+			return static_cast<size_t>(NumBlocksNoLock()) * block_byte_size_;
+		}
+
+		// 使用状況. 並列に確保と解放がされている場合も一貫した値となるよう一度のロックで取得する.
+		struct Usage
+		{
+			int		num_blocks = 0;
+			int		num_free_blocks = 0;
+			size_t	allocated_byte_size = 0;
+		};
+		Usage GetUsage() const
+		{
+			FScopeLock lock(&lock_);
+			Usage usage;
+			usage.num_blocks = NumBlocksNoLock();
+			usage.num_free_blocks = free_blocks_.Num();
+			usage.allocated_byte_size = static_cast<size_t>(usage.num_blocks) * block_byte_size_;
+			return usage;
+		}
+
+	private:
+		int NumBlocksNoLock() const
+		{
+			return slabs_.Num() * static_cast<int>(slab_block_count_);
+		}
+		void AddSlab()
+		{
+			uint8* slab = static_cast<uint8*>(FMemory::Malloc(static_cast<SIZE_T>(block_byte_size_) * slab_block_count_, BLOCK_ALIGNMENT));
+			slabs_.Add(slab);
+			// 先頭側のブロックから使われるように逆順で積む.
+			free_blocks_.Reserve(free_blocks_.Num() + slab_block_count_);
+			for (int i = static_cast<int>(slab_block_count_) - 1; i >= 0; --i)
+			{
+				free_blocks_.Push(slab + static_cast<SIZE_T>(block_byte_size_) * i);
+			}
+		}
+
+		const uint32		block_byte_size_;
+		const uint32		slab_block_count_;
+		mutable FCriticalSection	lock_;
+		TArray<uint8*>		slabs_;
+		TArray<void*>		free_blocks_;
+	};
+
+	// チャンクオブジェクトのプール.
+	// スラブ単位でまとめて生成したチャンクを, StreamOutで返却されたものから再利用する. メインスレッド(Sync)からのみ使用する.
+	// 返却時にチャンクのReleaseでVoxel本体をブロックプールへ戻すため, プール内のチャンクはオブジェクト分のメモリのみ保持する.
+	template<typename ChunkType>
+	class VoxelChunkObjectPoolT
+	{
+	public:
+		explicit VoxelChunkObjectPoolT(int slab_chunk_count = 64)
+			: slab_chunk_count_(FMath::Max(slab_chunk_count, 1))
+		{
+		}
+		VoxelChunkObjectPoolT(const VoxelChunkObjectPoolT&) = delete;
+		VoxelChunkObjectPoolT& operator=(const VoxelChunkObjectPoolT&) = delete;
+
+		// 未使用のチャンクを取得.
+		ChunkType* Acquire()
+		{
+			if (0 >= free_chunks_.Num())
+				AddSlab();
+			return free_chunks_.Pop(EAllowShrinking::No);
+		}
+		// チャンクを返却. Voxel本体と状態は破棄される.
+		void Release(ChunkType* chunk)
+		{
+			if (!chunk)
+				return;
+			chunk->Release();
+			free_chunks_.Push(chunk);
+		}
+		// 指定数のチャンクを生成済みの状態にする.
+		void Reserve(int chunk_count)
+		{
+			while (NumChunks() < chunk_count)
+				AddSlab();
+		}
+
+		// 生成済みのチャンク総数.
+		int NumChunks() const
+		{
+			return slabs_.Num() * slab_chunk_count_;
+		}
+		// 未使用のチャンク数.
+		int NumFreeChunks() const
+		{
+			return free_chunks_.Num();
+		}
+
+	private:
+		void AddSlab()
+		{
+			auto& slab = slabs_.Add_GetRef(MakeUnique<ChunkType[]>(slab_chunk_count_));
+			free_chunks_.Reserve(free_chunks_.Num() + slab_chunk_count_);
+			for (int i = slab_chunk_count_ - 1; i >= 0; --i)
+			{
+				free_chunks_.Push(&slab[i]);
+			}
+		}
+
+		const int						slab_chunk_count_;
+		TArray<TUniquePtr<ChunkType[]>>	slabs_;
+		TArray<ChunkType*>				free_chunks_;
+	};
+}
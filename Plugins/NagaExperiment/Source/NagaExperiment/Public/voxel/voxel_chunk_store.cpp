@@ -0,0 +1,390 @@
+﻿// @author: @nagakagachi
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "voxel_chunk_store.h"
+
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+namespace naga
+{
+	VoxelChunkStore::VoxelChunkStore()
+	{
+	}
+	VoxelChunkStore::~VoxelChunkStore()
+	{
+		Finalize();
+	}
+
+	bool VoxelChunkStore::Initialize(const FString& directory)
+	{
+		Finalize();
+
+		FScopeLock lock(&region_map_cs_);
+
+		IPlatformFile& platform_file = FPlatformFileManager::Get().GetPlatformFile();
+		if (!platform_file.CreateDirectoryTree(*directory))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[VoxelChunkStore] Failed to create directory. %s"), *directory);
+			return false;
+		}
+
+		directory_ = directory;
+		is_initialized_ = true;
+		return true;
+	}
+	void VoxelChunkStore::Finalize()
+	{
+		FScopeLock lock(&region_map_cs_);
+
+		for (auto&& e : region_map_)
+		{
+			if (e.Value->file_handle)
+				e.Value->file_handle->Flush();
+		}
+		region_map_.Empty();
+		is_initialized_ = false;
+	}
+
+	bool VoxelChunkStore::IsInitialized() const
+	{
+		return is_initialized_;
+	}
+
+	bool VoxelChunkStore::Save(const FIntVector& chunk_id, const TArray<uint8>& data)
+	{
+		if (!is_initialized_ || 0 >= data.Num())
+			return false;
+
+		const auto region_id = CalcRegionId(chunk_id);
+		auto* region = FindOrAddRegion(region_id);
+		FWriteScopeLock region_lock(region->lock);
+		OpenRegion(region_id, *region, true);
+		if (!region->file_handle)
+			return false;
+
+		auto* file_handle = region->file_handle.Get();
+		const auto local_index = CalcRegionLocalIndex(chunk_id);
+		auto&& entry = region->index_table[local_index];
+
+		auto&& slot_size = region->slot_size_table[local_index];
+
+		// 既存のスロットに収まる場合は上書き, そうでなければ新たなスロットへ書き込む.
+		RegionIndexEntry new_entry = entry;
+		uint32 new_slot_size = slot_size;
+		const bool is_overwrite = (0 < entry.size && static_cast<uint32>(data.Num()) <= slot_size);
+		if (!is_overwrite)
+		{
+			new_slot_size = CalcSlotSize(data.Num());
+			new_entry.offset = AllocateSlot(*region, new_slot_size);
+		}
+		new_entry.size = static_cast<uint32>(data.Num());
+
+		if (!file_handle->Seek(new_entry.offset) || !file_handle->Write(data.GetData(), data.Num()))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[VoxelChunkStore] Failed to write chunk data. (%d, %d, %d)"), chunk_id.X, chunk_id.Y, chunk_id.Z);
+			if (!is_overwrite)
+				FreeSlot(*region, new_entry.offset, new_slot_size);
+			return false;
+		}
+
+		// インデックスを更新.
+		file_handle->Seek(REGION_INDEX_TABLE_OFFSET + sizeof(RegionIndexEntry) * local_index);
+		if (!file_handle->Write(reinterpret_cast<const uint8*>(&new_entry), sizeof(new_entry)))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[VoxelChunkStore] Failed to write index. (%d, %d, %d)"), chunk_id.X, chunk_id.Y, chunk_id.Z);
+			if (!is_overwrite)
+				FreeSlot(*region, new_entry.offset, new_slot_size);
+			return false;
+		}
+		// 読み込み用ハンドルから参照できるようにフラッシュ.
+		file_handle->Flush();
+
+		// インデックスの書き換え後に旧スロットを解放.
+		if (!is_overwrite && 0 < entry.size)
+			FreeSlot(*region, entry.offset, slot_size);
+		entry = new_entry;
+		slot_size = new_slot_size;
+		return true;
+	}
+
+	bool VoxelChunkStore::Load(const FIntVector& chunk_id, TArray<uint8>& out_data)
+	{
+		out_data.Reset();
+		if (!is_initialized_)
+			return false;
+
+		const auto region_id = CalcRegionId(chunk_id);
+		auto* region = FindOrAddRegion(region_id);
+		// 初回アクセス時のみ排他ロックでファイルを開く.
+		bool is_opened = false;
+		{
+			FReadScopeLock region_lock(region->lock);
+			is_opened = region->is_opened;
+		}
+		if (!is_opened)
+		{
+			FWriteScopeLock region_lock(region->lock);
+			OpenRegion(region_id, *region, false);
+		}
+
+		// 読み込みは共有ロックで, 同じリージョンの読み込み同士は並列に実行する.
+		FReadScopeLock region_lock(region->lock);
+		if (!region->file_handle)
+			return false;
+
+		const auto entry = region->index_table[CalcRegionLocalIndex(chunk_id)];
+		if (0 == entry.size)
+			return false;
+
+		auto read_handle = AcquireReadHandle(region_id, *region);
+		if (!read_handle)
+			return false;
+
+		out_data.SetNumUninitialized(entry.size);
+		const bool is_success = read_handle->Seek(entry.offset) && read_handle->Read(out_data.GetData(), entry.size);
+		ReleaseReadHandle(*region, MoveTemp(read_handle));
+		if (!is_success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[VoxelChunkStore] Failed to read chunk data. (%d, %d, %d)"), chunk_id.X, chunk_id.Y, chunk_id.Z);
+			out_data.Reset();
+			return false;
+		}
+		return true;
+	}
+
+	void VoxelChunkStore::Flush()
+	{
+		FScopeLock lock(&region_map_cs_);
+
+		for (auto&& e : region_map_)
+		{
+			FWriteScopeLock region_lock(e.Value->lock);
+			if (e.Value->file_handle)
+				e.Value->file_handle->Flush();
+		}
+	}
+
+	void VoxelChunkStore::Clear()
+	{
+		FScopeLock lock(&region_map_cs_);
+
+		// ファイルを閉じてから削除.
+		region_map_.Empty();
+		if (directory_.IsEmpty())
+			return;
+
+		IPlatformFile& platform_file = FPlatformFileManager::Get().GetPlatformFile();
+		platform_file.DeleteDirectoryRecursively(*directory_);
+		if (is_initialized_)
+			platform_file.CreateDirectoryTree(*directory_);
+	}
+
+	VoxelChunkStore::Region* VoxelChunkStore::FindOrAddRegion(const FIntVector& region_id)
+	{
+		FScopeLock lock(&region_map_cs_);
+		auto&& region_ptr = region_map_.FindOrAdd(region_id);
+		if (!region_ptr)
+			region_ptr = MakeUnique<Region>();
+		return region_ptr.Get();
+	}
+
+	void VoxelChunkStore::OpenRegion(const FIntVector& region_id, Region& region, bool is_create)
+	{
+		if (!region.is_opened)
+		{
+			// 初回アクセス. ファイルがあればインデックステーブルを読み込む.
+			region.is_opened = true;
+			region.index_table.SetNumZeroed(REGION_CHUNK_COUNT);
+
+			IPlatformFile& platform_file = FPlatformFileManager::Get().GetPlatformFile();
+			const auto file_path = MakeRegionFilePath(region_id);
+			if (platform_file.FileExists(*file_path))
+			{
+				region.file_handle.Reset(platform_file.OpenWrite(*file_path, true, true));
+
+				RegionFileHeader header = {};
+				const bool is_valid_file = region.file_handle
+					&& region.file_handle->Seek(0)
+					&& region.file_handle->Read(reinterpret_cast<uint8*>(&header), sizeof(header))
+					&& (REGION_FILE_MAGIC == header.magic) && (REGION_FILE_VERSION == header.version) && (REGION_RESOLUTION == header.region_resolution)
+					&& region.file_handle->Read(reinterpret_cast<uint8*>(region.index_table.GetData()), sizeof(RegionIndexEntry) * REGION_CHUNK_COUNT);
+				if (!is_valid_file)
+				{
+					// 互換性の無いファイルは作り直す.
+					UE_LOG(LogTemp, Warning, TEXT("[VoxelChunkStore] Invalid region file. recreate. %s"), *file_path);
+					region.file_handle.Reset();
+					region.index_table.SetNumZeroed(REGION_CHUNK_COUNT);
+					CreateRegionFile(region_id, region);
+				}
+			}
+			BuildFreeSpanList(region);
+		}
+
+		if (is_create && !region.file_handle)
+		{
+			CreateRegionFile(region_id, region);
+		}
+	}
+
+	bool VoxelChunkStore::CreateRegionFile(const FIntVector& region_id, Region& region)
+	{
+		IPlatformFile& platform_file = FPlatformFileManager::Get().GetPlatformFile();
+		const auto file_path = MakeRegionFilePath(region_id);
+
+		region.file_handle.Reset(platform_file.OpenWrite(*file_path, false, true));
+		if (!region.file_handle)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[VoxelChunkStore] Failed to create region file. %s"), *file_path);
+			return false;
+		}
+
+		// ヘッダと空のインデックステーブルを書き込む.
+		const RegionFileHeader header = {};
+		region.index_table.SetNumZeroed(REGION_CHUNK_COUNT);
+		BuildFreeSpanList(region);
+		const bool is_success = region.file_handle->Write(reinterpret_cast<const uint8*>(&header), sizeof(header))
+			&& region.file_handle->Write(reinterpret_cast<const uint8*>(region.index_table.GetData()), sizeof(RegionIndexEntry) * REGION_CHUNK_COUNT);
+		if (!is_success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[VoxelChunkStore] Failed to write region header. %s"), *file_path);
+			region.file_handle.Reset();
+			return false;
+		}
+		return true;
+	}
+
+	uint32 VoxelChunkStore::CalcSlotSize(uint32 data_size)
+	{
+		return Align(data_size + data_size / 8, REGION_SLOT_ALIGNMENT);
+	}
+	void VoxelChunkStore::BuildFreeSpanList(Region& region)
+	{
+		region.slot_size_table.SetNumZeroed(REGION_CHUNK_COUNT);
+		region.free_span_list.Reset();
+		region.data_end_offset = static_cast<uint32>(REGION_DATA_OFFSET);
+
+		// 保存済みのチャンクをオフセット順に並べ, 次のチャンクまでをスロットとする. 先頭の隙間は空きとする.
+		TArray<int32> local_index_list;
+		for (int32 i = 0; i < REGION_CHUNK_COUNT; ++i)
+		{
+			if (0 < region.index_table[i].size)
+				local_index_list.Add(i);
+		}
+		local_index_list.Sort([&region](int32 a, int32 b)
+		{
+			return region.index_table[a].offset < region.index_table[b].offset;
+		});
+
+		for (int32 i = 0; i < local_index_list.Num(); ++i)
+		{
+			const auto& entry = region.index_table[local_index_list[i]];
+			if (0 == i && region.data_end_offset < entry.offset)
+				region.free_span_list.Add({ region.data_end_offset, entry.offset - region.data_end_offset });
+
+			const uint32 next_offset = (i + 1 < local_index_list.Num()) ? region.index_table[local_index_list[i + 1]].offset : entry.offset + entry.size;
+			region.slot_size_table[local_index_list[i]] = next_offset - entry.offset;
+			region.data_end_offset = next_offset;
+		}
+	}
+	uint32 VoxelChunkStore::AllocateSlot(Region& region, uint32 slot_size)
+	{
+		for (int32 i = 0; i < region.free_span_list.Num(); ++i)
+		{
+			auto&& span = region.free_span_list[i];
+			if (slot_size > span.size)
+				continue;
+
+			const uint32 offset = span.offset;
+			// 残りがアラインメントに満たない場合は分割せずスロットに含める.
+			if (REGION_SLOT_ALIGNMENT > span.size - slot_size)
+			{
+				region.free_span_list.RemoveAt(i, EAllowShrinking::No);
+			}
+			else
+			{
+				span.offset += slot_size;
+				span.size -= slot_size;
+			}
+			return offset;
+		}
+
+		const uint32 offset = region.data_end_offset;
+		region.data_end_offset += slot_size;
+		return offset;
+	}
+	void VoxelChunkStore::FreeSlot(Region& region, uint32 offset, uint32 slot_size)
+	{
+		// 終端のスロットはデータ領域を縮小する. 直前の空きも終端に接していれば取り込む.
+		if (offset + slot_size == region.data_end_offset)
+		{
+			region.data_end_offset = offset;
+			if (0 < region.free_span_list.Num())
+			{
+				const auto& last_span = region.free_span_list.Last();
+				if (last_span.offset + last_span.size == region.data_end_offset)
+				{
+					region.data_end_offset = last_span.offset;
+					region.free_span_list.Pop(EAllowShrinking::No);
+				}
+			}
+			return;
+		}
+
+		// オフセット順に挿入して前後の空きと結合.
+		int32 insert_index = 0;
+		while (insert_index < region.free_span_list.Num() && region.free_span_list[insert_index].offset < offset)
+			++insert_index;
+		region.free_span_list.Insert({ offset, slot_size }, insert_index);
+
+		if (insert_index + 1 < region.free_span_list.Num())
+		{
+			auto&& span = region.free_span_list[insert_index];
+			const auto& next_span = region.free_span_list[insert_index + 1];
+			if (span.offset + span.size == next_span.offset)
+			{
+				span.size += next_span.size;
+				region.free_span_list.RemoveAt(insert_index + 1, EAllowShrinking::No);
+			}
+		}
+		if (0 < insert_index)
+		{
+			auto&& prev_span = region.free_span_list[insert_index - 1];
+			const auto& span = region.free_span_list[insert_index];
+			if (prev_span.offset + prev_span.size == span.offset)
+			{
+				prev_span.size += span.size;
+				region.free_span_list.RemoveAt(insert_index, EAllowShrinking::No);
+			}
+		}
+	}
+
+	TUniquePtr<IFileHandle> VoxelChunkStore::AcquireReadHandle(const FIntVector& region_id, Region& region)
+	{
+		{
+			FScopeLock lock(&region.read_handle_cs);
+			if (0 < region.read_handle_pool.Num())
+				return region.read_handle_pool.Pop(EAllowShrinking::No);
+		}
+		// 書き込み用ハンドルが開いているファイルを共有で開く.
+		IPlatformFile& platform_file = FPlatformFileManager::Get().GetPlatformFile();
+		TUniquePtr<IFileHandle> read_handle(platform_file.OpenRead(*MakeRegionFilePath(region_id), true));
+		if (!read_handle)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[VoxelChunkStore] Failed to open region file for read. (%d, %d, %d)"), region_id.X, region_id.Y, region_id.Z);
+		}
+		return read_handle;
+	}
+	void VoxelChunkStore::ReleaseReadHandle(Region& region, TUniquePtr<IFileHandle>&& read_handle)
+	{
+		FScopeLock lock(&region.read_handle_cs);
+		region.read_handle_pool.Add(MoveTemp(read_handle));
+	}
+
+	FString VoxelChunkStore::MakeRegionFilePath(const FIntVector& region_id) const
+	{
+		return FPaths::Combine(directory_, FString::Printf(TEXT("r.%d.%d.%d.vcr"), region_id.X, region_id.Y, region_id.Z));
+	}
+}
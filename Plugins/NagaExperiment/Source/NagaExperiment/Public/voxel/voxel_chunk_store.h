@@ -0,0 +1,147 @@
+﻿// @author: @nagakagachi
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/ScopeRWLock.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+
+namespace naga
+{
+	// チャンクの永続化ストア.
+	// REGION_RESOLUTION^3 のチャンクをまとめたリージョンファイル単位で保存する.
+	// 
+	// リージョンファイルの構成.
+	//	Header
+	//	IndexTable	: リージョン内の各チャンクの {ファイル内オフセット, サイズ}. サイズ0は未保存.
+	//	ChunkData	: チャンクデータ本体. REGION_SLOT_ALIGNMENT 単位の余裕を持たせたスロットへ格納する.
+	//				  更新時はスロットに収まれば上書き, そうでなければ新たなスロットへ書き込んでインデックスを書き換え, 旧スロットを解放する.
+	//				  解放したスロットはメモリ上の空きリストで管理して再利用するため, 更新を繰り返してもファイルは肥大化しない.
+	// 
+	// インデックステーブルはリージョン毎にメモリへキャッシュし, チャンクデータのみファイルから読み込む.
+	// チャンクデータの内容には関与しない.
+	// 
+	// スレッドセーフ. ロックはリージョン毎で, 読み込みは共有ロックのもとリージョン毎にプールした読み込み用ハンドルで並列に実行する.
+	// 書き込みは排他ロックで, 同じリージョンの読み込みとのみ排他となる.
+	// Initialize, Finalize, Clear は他の呼び出しと並行して呼び出さないこと.
+	class VoxelChunkStore
+	{
+	public:
+		// リージョンの1辺のチャンク数.
+		static constexpr int REGION_RESOLUTION_LOG2 = 4;
+		static constexpr int REGION_RESOLUTION = 1 << REGION_RESOLUTION_LOG2;
+		static constexpr int REGION_CHUNK_COUNT = REGION_RESOLUTION * REGION_RESOLUTION * REGION_RESOLUTION;
+
+		static constexpr uint32 REGION_FILE_MAGIC = 0x5243564e;// "NVCR"
+		static constexpr uint32 REGION_FILE_VERSION = 1;
+		// データスロットのアラインメント.
+		static constexpr uint32 REGION_SLOT_ALIGNMENT = 256;
+
+	public:
+		VoxelChunkStore();
+		~VoxelChunkStore();
+
+		// directory : リージョンファイルを格納するディレクトリ.
+		bool Initialize(const FString& directory);
+		// 開いているリージョンファイルを閉じる.
+		void Finalize();
+
+		bool IsInitialized() const;
+
+		// チャンクデータを保存.
+		bool Save(const FIntVector& chunk_id, const TArray<uint8>& data);
+		// チャンクデータを読み込み. 保存されていない場合はfalse.
+		bool Load(const FIntVector& chunk_id, TArray<uint8>& out_data);
+
+		// 書き込みをフラッシュ.
+		void Flush();
+		// 保存済みのデータをすべて破棄.
+		void Clear();
+
+	public:
+		static FIntVector CalcRegionId(const FIntVector& chunk_id)
+		{
+			// 負の座標も含めてFloorとなるように算術シフト.
+			return FIntVector(chunk_id.X >> REGION_RESOLUTION_LOG2, chunk_id.Y >> REGION_RESOLUTION_LOG2, chunk_id.Z >> REGION_RESOLUTION_LOG2);
+		}
+		static int CalcRegionLocalIndex(const FIntVector& chunk_id)
+		{
+			constexpr int mask = REGION_RESOLUTION - 1;
+			return (chunk_id.X & mask) + ((chunk_id.Y & mask) << REGION_RESOLUTION_LOG2) + ((chunk_id.Z & mask) << (REGION_RESOLUTION_LOG2 * 2));
+		}
+
+	private:
+		struct RegionFileHeader
+		{
+			uint32	magic = REGION_FILE_MAGIC;
+			uint32	version = REGION_FILE_VERSION;
+			uint32	region_resolution = REGION_RESOLUTION;
+			uint32	reserved = 0;
+		};
+		struct RegionIndexEntry
+		{
+			uint32	offset = 0;
+			uint32	size = 0;
+		};
+		// データ領域の空き.
+		struct RegionFreeSpan
+		{
+			uint32	offset = 0;
+			uint32	size = 0;
+		};
+		struct Region
+		{
+			// ファイルとインデックステーブルの保護. 読み込みは共有ロック, 書き込みとファイルのオープンは排他ロック.
+			FRWLock							lock;
+			// 初回アクセスでファイルを開いたか.
+			bool							is_opened = false;
+			// 書き込み用. ファイルが存在しない場合はnullptr.
+			TUniquePtr<IFileHandle>			file_handle;
+			TArray<RegionIndexEntry>		index_table;
+			// 各チャンクのスロットサイズ. ファイルには保存せずオープン時にインデックステーブルから復元する.
+			TArray<uint32>					slot_size_table;
+			// オフセット順の空きリスト. 隣接する空きは結合する.
+			TArray<RegionFreeSpan>			free_span_list;
+			// 使用中のデータ領域の終端.
+			uint32							data_end_offset = 0;
+
+			// 読み込み用ハンドルのプール. シーク位置を共有しないよう読み込み毎に1つを占有する.
+			FCriticalSection				read_handle_cs;
+			TArray<TUniquePtr<IFileHandle>>	read_handle_pool;
+		};
+
+		static constexpr int64 REGION_INDEX_TABLE_OFFSET = sizeof(RegionFileHeader);
+		static constexpr int64 REGION_DATA_OFFSET = REGION_INDEX_TABLE_OFFSET + sizeof(RegionIndexEntry) * REGION_CHUNK_COUNT;
+
+		// リージョンを取得. 未登録の場合は未オープンのリージョンを追加する.
+		Region* FindOrAddRegion(const FIntVector& region_id);
+		// 未オープンの場合はファイルを開いてインデックステーブルを読み込む. リージョンの排他ロック下で呼び出す.
+		// is_create : ファイルが存在しない場合に作成するか.
+		void OpenRegion(const FIntVector& region_id, Region& region, bool is_create);
+		// 空のリージョンファイルを作成. リージョンの排他ロック下で呼び出す.
+		bool CreateRegionFile(const FIntVector& region_id, Region& region);
+		FString MakeRegionFilePath(const FIntVector& region_id) const;
+
+		// データサイズに対するスロットサイズ. 多少のサイズ増加では移動しないよう余裕を持たせる.
+		static uint32 CalcSlotSize(uint32 data_size);
+		// インデックステーブルからスロットサイズと空きリストを復元.
+		static void BuildFreeSpanList(Region& region);
+		// スロットを確保してオフセットを返す. 空きリストからFirstFitで確保し, 無ければデータ領域の終端へ追加.
+		static uint32 AllocateSlot(Region& region, uint32 slot_size);
+		// スロットを空きリストへ返却.
+		static void FreeSlot(Region& region, uint32 offset, uint32 slot_size);
+
+		// 読み込み用ハンドルをプールから取得. 空の場合は新たに開く.
+		TUniquePtr<IFileHandle> AcquireReadHandle(const FIntVector& region_id, Region& region);
+		void ReleaseReadHandle(Region& region, TUniquePtr<IFileHandle>&& read_handle);
+
+	private:
+		// region_map_の保護. リージョン内の操作はリージョン毎のロックで保護する.
+		FCriticalSection					region_map_cs_;
+		FString								directory_;
+		bool								is_initialized_ = false;
+		TMap<FIntVector, TUniquePtr<Region>>	region_map_;
+	};
+}
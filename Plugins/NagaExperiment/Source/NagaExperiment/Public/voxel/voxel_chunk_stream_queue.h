@@ -0,0 +1,149 @@
+﻿// @author: @nagakagachi
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace naga
+{
+	// チャンクのストリーミング要求の優先度付きキュー.
+	// 優先度の値が小さい要求から取り出す二分ヒープ.
+	// 
+	// 重視位置の移動時は世代を進めるのみで全要素の再計算はしない(遅延再評価).
+	//	AdvanceEpoch	: 世代を進める. 既存要素の優先度が最大どれだけ小さくなり得るかを累積オフセットとして加算する.
+	//					  ヒープのキーは 優先度 + 追加時の累積オフセット とするため, 古い世代の要素のキーは現在の正しいキーの下限となる.
+	//	Pop				: 先頭が古い世代の場合は優先度を再計算して入れ直し, 現世代の先頭が得られるまで繰り返す.
+	//					  キーが下限であるため, 現世代の先頭は全要素中で最優先となる.
+	//	Refresh			: 古い世代の要素を一定数ずつ再計算し, Popでの再計算をならす.
+	class VoxelChunkStreamQueue
+	{
+	public:
+		struct Entry
+		{
+			// ヒープのキー. 優先度 + 追加時の累積オフセット.
+			float		key = 0.0f;
+			uint32		epoch = 0;
+			FIntVector	chunk_id = FIntVector::ZeroValue;
+		};
+
+		// 要求を追加.
+		void Push(const FIntVector& chunk_id, float priority)
+		{
+			heap_.HeapPush(Entry{ priority + priority_offset_, epoch_, chunk_id }, EntryPredicate());
+		}
+		// Popで取り出した要求を戻す. キーと世代は保持する.
+		void Push(const Entry& entry)
+		{
+			heap_.HeapPush(entry, EntryPredicate());
+		}
+
+		// 最優先の要求を取り出す. 空の場合はfalse.
+		// calc_priority : float(const FIntVector& chunk_id). 古い世代の要素の優先度再計算.
+		template<typename PriorityFuncType>
+		bool Pop(Entry& out_entry, const PriorityFuncType& calc_priority)
+		{
+			while (0 < heap_.Num())
+			{
+				heap_.HeapPop(out_entry, EntryPredicate(), EAllowShrinking::No);
+				if (epoch_ == out_entry.epoch)
+					return true;
+
+				// 古い世代は再計算して入れ直す. 再計算後は現世代となるため要素数回以内に終了する.
+				out_entry.key = calc_priority(out_entry.chunk_id) + priority_offset_;
+				out_entry.epoch = epoch_;
+				heap_.HeapPush(out_entry, EntryPredicate());
+			}
+			return false;
+		}
+
+		// 古い世代の要素を最大max_count個まで再計算する.
+		template<typename PriorityFuncType>
+		void Refresh(int max_count, const PriorityFuncType& calc_priority)
+		{
+			for (int i = 0; i < max_count && 0 < heap_.Num(); ++i)
+			{
+				refresh_cursor_ = (heap_.Num() <= refresh_cursor_) ? 0 : refresh_cursor_;
+				if (epoch_ != heap_[refresh_cursor_].epoch)
+				{
+					Entry entry = heap_[refresh_cursor_];
+					heap_.HeapRemoveAt(refresh_cursor_, EntryPredicate(), EAllowShrinking::No);
+					entry.key = calc_priority(entry.chunk_id) + priority_offset_;
+					entry.epoch = epoch_;
+					heap_.HeapPush(entry, EntryPredicate());
+				}
+				++refresh_cursor_;
+			}
+		}
+
+		// 世代を進めて既存の要素の優先度を無効化する. 重視位置や向きが変化した際に呼び出す.
+		// max_priority_decrease : 前回の世代から既存要素の優先度が小さくなり得る最大量.
+		void AdvanceEpoch(float max_priority_decrease)
+		{
+			++epoch_;
+			// 空であれば累積オフセットをリセットして精度を保つ.
+			priority_offset_ = (0 < heap_.Num()) ? (priority_offset_ + FMath::Max(0.0f, max_priority_decrease)) : 0.0f;
+		}
+
+		// 条件を満たす要求を除去してヒープを再構築する. 戻り値は除去数.
+		// predicate : bool(const FIntVector& chunk_id). trueで除去.
+		template<typename PredicateType>
+		int RemoveIf(const PredicateType& predicate)
+		{
+			const int removed_count = heap_.RemoveAll([&predicate](const Entry& e) { return predicate(e.chunk_id); });
+			if (0 < removed_count)
+			{
+				heap_.Heapify(EntryPredicate());
+				refresh_cursor_ = 0;
+			}
+			return removed_count;
+		}
+
+		// 検証用. 先頭からmax_count個の取り出し順が, 全要素の優先度を再計算してソートした順と一致するか.
+		// 同じ優先度の要素の順は問わないため優先度の値で比較する. キュー自体は変更しない.
+		template<typename PriorityFuncType>
+		bool ValidatePopOrder(int max_count, const PriorityFuncType& calc_priority) const
+		{
+			TArray<float> sorted_priority;
+			sorted_priority.Reserve(heap_.Num());
+			for (const auto& e : heap_)
+				sorted_priority.Add(calc_priority(e.chunk_id));
+			sorted_priority.Sort();
+
+			VoxelChunkStreamQueue copy = *this;
+			Entry entry;
+			for (int i = 0; i < max_count && copy.Pop(entry, calc_priority); ++i)
+			{
+				const float popped_priority = calc_priority(entry.chunk_id);
+				if (!FMath::IsNearlyEqual(sorted_priority[i], popped_priority, 1.0e-3f))
+					return false;
+			}
+			return true;
+		}
+
+		int Num() const
+		{
+			return heap_.Num();
+		}
+		void Empty()
+		{
+			heap_.Empty();
+			refresh_cursor_ = 0;
+			priority_offset_ = 0.0f;
+		}
+
+	private:
+		struct EntryPredicate
+		{
+			bool operator()(const Entry& a, const Entry& b) const
+			{
+				return a.key < b.key;
+			}
+		};
+
+		TArray<Entry>	heap_;
+		uint32			epoch_ = 0;
+		float			priority_offset_ = 0.0f;
+		int				refresh_cursor_ = 0;
+	};
+}
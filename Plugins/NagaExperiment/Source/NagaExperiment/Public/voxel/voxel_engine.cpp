@@ -18,8 +18,14 @@
 #include "Camera/PlayerCameraManager.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "Misc/Paths.h"
 
 #include "Runtime/Core/Public/Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Queue.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ConvexVolume.h"
 
 #if WITH_EDITOR
 // For Editor
@@ -29,6 +35,222 @@
 
 class AVoxelEngine;
 
+// stat VoxelEngine で表示.
+DECLARE_STATS_GROUP(TEXT("VoxelEngine"), STATGROUP_VoxelEngine, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Tick"), STAT_VoxelEngine_Tick, STATGROUP_VoxelEngine);
+DECLARE_CYCLE_STAT(TEXT("SyncUpdate"), STAT_VoxelEngine_SyncUpdate, STATGROUP_VoxelEngine);
+DECLARE_CYCLE_STAT(TEXT("AsyncUpdate"), STAT_VoxelEngine_AsyncUpdate, STATGROUP_VoxelEngine);
+DECLARE_CYCLE_STAT(TEXT("UploadMesh"), STAT_VoxelEngine_UploadMesh, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("StreamIn Count"), STAT_VoxelEngine_StreamInCount, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("StoreLoad Count"), STAT_VoxelEngine_StoreLoadCount, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("StreamOut Count"), STAT_VoxelEngine_StreamOutCount, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Edit Count"), STAT_VoxelEngine_EditChunkCount, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mesh Count"), STAT_VoxelEngine_MeshCount, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("MeshUpload Count"), STAT_VoxelEngine_MeshUploadCount, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Collision Count"), STAT_VoxelEngine_CollisionCount, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("CollisionUpload Count"), STAT_VoxelEngine_CollisionUploadCount, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Noise [ms]"), STAT_VoxelEngine_NoiseMs, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("StoreLoad [ms]"), STAT_VoxelEngine_StoreLoadMs, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Lod [ms]"), STAT_VoxelEngine_LodMs, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Meshing [ms]"), STAT_VoxelEngine_MeshingMs, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Collision [ms]"), STAT_VoxelEngine_CollisionMs, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Async [ms]"), STAT_VoxelEngine_AsyncMs, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("OverlapSync [ms]"), STAT_VoxelEngine_OverlapSyncMs, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("MeshUpload [ms]"), STAT_VoxelEngine_MeshUploadMs, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("StreamIn Queue"), STAT_VoxelEngine_StreamInQueueNum, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("StreamOut Queue"), STAT_VoxelEngine_StreamOutQueueNum, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("MeshRequest Queue"), STAT_VoxelEngine_MeshRequestNum, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("CollisionRequest Queue"), STAT_VoxelEngine_CollisionRequestNum, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visible Chunk"), STAT_VoxelEngine_VisibleChunkNum, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("MeshDeferred Chunk"), STAT_VoxelEngine_MeshDeferredNum, STATGROUP_VoxelEngine);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RayCast Count"), STAT_VoxelEngine_RayCastCount, STATGROUP_VoxelEngine);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("RayCast [ms]"), STAT_VoxelEngine_RayCastMs, STATGROUP_VoxelEngine);
+
+// csvprofile start/stop で出力.
+CSV_DEFINE_CATEGORY(VoxelEngine, true);
+
+namespace
+{
+	// SurfaceNetsのSurfacePoint位置を[0,1]の割合で返す.
+	// voxel_sdf_values : 8点のsdf値を xyzの順で優先した配列. (x0y0z0,x1y0z0,x0y1z0,x1y1z0...).
+	FVector CalcSurfaceNetsSurfacePoint(const float(&voxel_sdf_values)[8])
+	{
+		FVector pos_rate = FVector::ZeroVector;
+
+		float rate_div_work = 0.0f;
+		for (auto i = 0u; i < 4; i += 1)
+		{
+			const auto i0 = i * 2;
+			const auto i1 = i0 + 1;
+			if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
+			{
+				float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
+				pos_rate += FVector(rate, (i0 >> 1) & 0b01, (i0 >> 2) & 0b01);
+
+				rate_div_work += 1.0f;
+			}
+		}
+
+		for (auto i = 0u; i < 4; i += 1)
+		{
+			const auto i0 = (i & 0b01) + ((i >> 1) & 0b01) * 4;
+			const auto i1 = i0 + 2;
+			if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
+			{
+				float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
+				pos_rate += FVector(i0 & 0b01, rate, (i0 >> 2) & 0b01);
+
+				rate_div_work += 1.0f;
+			}
+		}
+
+		for (auto i = 0u; i < 4; i += 1)
+		{
+			const auto i0 = i;
+			const auto i1 = i0 + 4;
+			if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
+			{
+				float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
+				pos_rate += FVector(i0 & 0b01, (i0 >> 1) & 0b01, rate);
+
+				rate_div_work += 1.0f;
+			}
+		}
+
+		if (0.0f < rate_div_work)
+			pos_rate /= rate_div_work;
+
+		return pos_rate;
+	}
+
+	// 1bitVoxelの場合はSurfaceCellの8頂点の占有パターン(256通り)でSurfacePointが決まるため事前にテーブル化しておく.
+	// パターンのビット順はsdf配列と同様 (x0y0z0,x1y0z0,x0y1z0,x1y1z0...).
+	struct SurfaceNetsBitPatternTable
+	{
+		SurfaceNetsBitPatternTable()
+		{
+			for (uint32 pattern = 0; pattern < std::size(surface_point_); ++pattern)
+			{
+				float voxel_sdf[8];
+				for (uint32 vi = 0; vi < 8; ++vi)
+				{
+					voxel_sdf[vi] = ((pattern >> vi) & 0x01) ? -1.0f : 1.0f;
+				}
+				surface_point_[pattern] = CalcSurfaceNetsSurfacePoint(voxel_sdf);
+
+				// 8頂点のsdfの差分による勾配を法線とする. 空側を向く.
+				FVector gradient = FVector::ZeroVector;
+				for (uint32 vi = 0; vi < 8; ++vi)
+				{
+					gradient += FVector((vi & 0x01) ? 1.0f : -1.0f, ((vi >> 1) & 0x01) ? 1.0f : -1.0f, ((vi >> 2) & 0x01) ? 1.0f : -1.0f) * voxel_sdf[vi];
+				}
+				// 対称なパターンでは勾配が0になるため, メッシュ生成側で面の向きから求める.
+				normal_[pattern] = gradient.GetSafeNormal();
+			}
+		}
+
+		FVector surface_point_[256];
+		FVector normal_[256];
+	};
+	const SurfaceNetsBitPatternTable k_surface_nets_bit_pattern_table = {};
+
+	// naga::VoxelChunkFace 順の面方向.
+	const FIntVector k_chunk_face_dir[naga::VoxelChunkFace::Count] =
+	{
+		FIntVector(-1, 0, 0), FIntVector(1, 0, 0),
+		FIntVector(0, -1, 0), FIntVector(0, 1, 0),
+		FIntVector(0, 0, -1), FIntVector(0, 0, 1),
+	};
+
+	// 境界位置に応じたデバッグカラー.
+	FColor CalcSurfaceNetsDebugColor(unsigned int i, unsigned int j, unsigned int k, unsigned int chunk_reso)
+	{
+		if ((chunk_reso - 1) == i)
+			return FLinearColor(1.0f, 0.0f, 0.0f, 1.0f).ToFColor(true);
+		else if ((chunk_reso - 1) == j)
+			return FLinearColor(0.0f, 1.0f, 0.0f, 1.0f).ToFColor(true);
+		else if ((chunk_reso - 1) == k)
+			return FLinearColor(0.0f, 0.0f, 1.0f, 1.0f).ToFColor(true);
+		else if (0 == i)
+			return FLinearColor(0.25f, 0.0f, 0.0f, 1.0f).ToFColor(true);
+		else if (0 == j)
+			return FLinearColor(0.0f, 0.25f, 0.0f, 1.0f).ToFColor(true);
+		else if (0 == k)
+			return FLinearColor(0.0f, 0.0f, 0.25f, 1.0f).ToFColor(true);
+		return FLinearColor(0.5f, 0.5f, 0.5f, 1.0f).ToFColor(true);
+	}
+
+	// 視点位置と向き, 水平画角, アスペクト比から視錐台を構築する. 遠方は制限しない.
+	// 各平面の法線は外側を向く.
+	FConvexVolume BuildViewFrustum(const FVector& location, const FRotator& rotation, float fov_degree, float aspect_ratio)
+	{
+		const FRotationMatrix view_matrix(rotation);
+		const FVector forward = view_matrix.GetScaledAxis(EAxis::X);
+		const FVector right = view_matrix.GetScaledAxis(EAxis::Y);
+		const FVector up = view_matrix.GetScaledAxis(EAxis::Z);
+		const float tan_half_h = FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(fov_degree, 1.0f, 170.0f) * 0.5f));
+		const float tan_half_v = tan_half_h / FMath::Max(aspect_ratio, UE_KINDA_SMALL_NUMBER);
+
+		FConvexVolume frustum;
+		frustum.Planes.Add(FPlane(location, -forward));
+		frustum.Planes.Add(FPlane(location, (right - forward * tan_half_h).GetSafeNormal()));
+		frustum.Planes.Add(FPlane(location, (-right - forward * tan_half_h).GetSafeNormal()));
+		frustum.Planes.Add(FPlane(location, (up - forward * tan_half_v).GetSafeNormal()));
+		frustum.Planes.Add(FPlane(location, (-up - forward * tan_half_v).GetSafeNormal()));
+		frustum.Init();
+		return frustum;
+	}
+
+	// ジョブ配列をワーカーで並列に消化する.
+	// 各ワーカーはアトミックなカーソルから次のジョブを取得するため, 遅いジョブがあっても他のワーカーはバッチ境界で待たずに次へ進む.
+	// 各ワーカーは直前のジョブと同じ時間がかかっても時間予算内に終わりそうな場合のみ次のジョブを取得する.
+	// 戻り値は取得したジョブ数. 取得したジョブは先頭から連続しており, 残りは次回へ繰り越す.
+	template<typename FuncType>
+	int RunJobsWithTimeBudget(int job_count, int worker_count, const std::chrono::system_clock::time_point& budget_start_time, long long budget_micro_sec, const FuncType& func)
+	{
+		if (0 >= job_count)
+			return 0;
+
+		std::atomic<int> job_cursor = 0;
+		ParallelFor(FMath::Clamp(worker_count, 1, job_count), [&](int32 worker_index)
+		{
+			long long last_job_micro_sec = 0;
+			for (;;)
+			{
+				const auto job_start_time = std::chrono::system_clock::now();
+				const auto elapsed_micro_sec = std::chrono::duration_cast<std::chrono::microseconds>(job_start_time - budget_start_time).count();
+				if (budget_micro_sec < elapsed_micro_sec + last_job_micro_sec)
+					break;
+
+				const int job_index = job_cursor.fetch_add(1, std::memory_order_relaxed);
+				if (job_count <= job_index)
+					break;
+
+				func(job_index);
+
+				last_job_micro_sec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - job_start_time).count();
+			}
+		}, false);
+
+		return FMath::Min(job_cursor.load(), job_count);
+	}
+
+	// 開始時刻からの経過マイクロ秒.
+	long long CalcElapsedMicroSec(const std::chrono::system_clock::time_point& start_time)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_time).count();
+	}
+
+	// ソート済み配列のパーセンタイル(最近傍順位).
+	double CalcSortedPercentile(const TArray<double>& sorted_values, double percentile)
+	{
+		if (0 >= sorted_values.Num())
+			return 0.0;
+		const int index = FMath::Clamp(FMath::CeilToInt(percentile * 0.01 * sorted_values.Num()) - 1, 0, sorted_values.Num() - 1);
+		return sorted_values[index];
+	}
+}
+
 
 	VoxelEngineAsyncTask::VoxelEngineAsyncTask()
 	{
@@ -112,16 +334,58 @@ class AVoxelEngine;
 	// Voxelメモリの解放とComponentの解放
 	void AVoxelEngine::FinalizeVoxel()
 	{
+		// 未保存のチャンクを保存してストアを閉じる.
+		if (chunk_store_.IsInitialized())
+		{
+			TArray<uint8> voxel_data;
+			for (auto&& it : voxel_chunk_map_)
+			{
+				// StreamOut待ちのUnloadingも対象.
+				if (it.Value && (naga::VoxelChunkState::Active == it.Value->GetState() || naga::VoxelChunkState::Unloading == it.Value->GetState()) && it.Value->GetStoreDirtyFlag())
+				{
+					it.Value->Decompress();
+					it.Value->WriteVoxelData(voxel_data);
+					chunk_store_.Save(it.Key, voxel_data);
+				}
+			}
+			chunk_store_.Finalize();
+		}
+
 		{
 			for (auto&& it : voxel_chunk_map_)
 			{
 				if (it.Value)
 				{
-					delete it.Value;
+					chunk_pool_.Release(it.Value);
 					it.Value = nullptr;
 				}
 			}
 			voxel_chunk_map_.Empty();
+
+			// 破棄したチャンクのメッシュ生成リクエストと結果も破棄.
+			mesh_request_chunk_array_.Empty();
+			mesh_request_chunk_set_.Empty();
+			compress_candidate_chunk_array_.Empty();
+			compress_candidate_range_ = -1;
+			mesh_complete_array_[0].Empty();
+			mesh_complete_array_[1].Empty();
+			collision_chunk_set_.Empty();
+			collision_request_chunk_array_.Empty();
+			collision_complete_array_[0].Empty();
+			collision_complete_array_[1].Empty();
+			visible_chunk_set_.Empty();
+			mesh_deferred_chunk_set_.Empty();
+
+			// 破棄したチャンクのストリーミング要求も破棄.
+			stream_in_queue_.Empty();
+			stream_out_queue_.Empty();
+			stream_in_chunk_complete_array_.Empty();
+			stream_out_chunk_complete_array_.Empty();
+
+			// 未適用の編集要求も破棄.
+			edit_request_array_.Empty();
+			edit_apply_array_.Empty();
+			edit_chunk_complete_array_.Empty();
 		}
 
 		{
@@ -153,6 +417,13 @@ class AVoxelEngine;
 				it.Value->ConditionalBeginDestroy();
 			}
 			chunk_proc_mesh_component_map_.Empty();
+			for (auto&& it : chunk_collision_component_map_)
+			{
+				if (!it.Value->IsValidLowLevel())
+					continue;
+				it.Value->ConditionalBeginDestroy();
+			}
+			chunk_collision_component_map_.Empty();
 		}
 	}
 
@@ -172,6 +443,29 @@ class AVoxelEngine;
 		async_task_.WaitAsyncUpdate();
 		FinalizeVoxel();
 
+		// チャンクとVoxel本体のメモリを事前確保. Stream Outされずに保持され得る最大数を目安にする.
+		{
+			const int out_range = FMath::Max(0, stream_out_chunk_range);
+			const int vertical_range = FMath::Clamp(stream_in_chunk_range_vertical + out_range - stream_in_chunk_range_horizontal, 0, out_range);
+			const int horizontal_width = out_range * 2 + 1;
+			const int max_chunk_count = horizontal_width * horizontal_width * (vertical_range * 2 + 1);
+			chunk_pool_.Reserve(max_chunk_count);
+			// 圧縮範囲外のチャンクはVoxel本体を持たないため, 非圧縮範囲分のみ確保.
+			const int uncompressed_width = FMath::Min(compress_chunk_range, out_range) * 2 + 1;
+			ChunkType::GetRowsPool().Reserve(uncompressed_width * uncompressed_width * FMath::Min(vertical_range * 2 + 1, uncompressed_width));
+		}
+
+		// チャンクストア.
+		if (use_chunk_store_)
+		{
+			chunk_store_.Initialize(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("VoxelChunkStore"), chunk_store_name_));
+		}
+
+		if (stream_benchmark_auto_start_)
+		{
+			StartStreamBenchmark();
+		}
+
 		/*
 		// テスト
 		auto p_mesh_cmp = GetChunkMeshComponentFromPool();
@@ -221,6 +515,7 @@ class AVoxelEngine;
 	void AVoxelEngine::Tick(float DeltaTime)
 	{
 		Super::Tick(DeltaTime);
+		SCOPE_CYCLE_COUNTER(STAT_VoxelEngine_Tick);
 
 		const auto		tick_start_time = std::chrono::system_clock::now();
 
@@ -231,12 +526,43 @@ class AVoxelEngine;
 		main2AsyncParam_[0].important_position_prev_ = main2AsyncParam_[0].important_position_;
 
 		// 重視位置の更新(本来は外部からリクエスト方式)
+		// 可視判定の視点はカメラが取得できた場合のみ有効.
+		visibility_view_.is_valid = false;
+		if (stream_benchmark_.is_running)
+		{
+			// ベンチマーク中はパスに沿って移動.
+			UpdateStreamBenchmark(DeltaTime);
+		}
+		else
 		{
 			if (auto* player_actor = Cast<AActor>(UGameplayStatics::GetPlayerPawn(this, 0)))
 			{
 				// プレイヤーが取得できたらプレイヤー中心.
 				main2AsyncParam_[0].important_position_ = player_actor->GetActorLocation();
 
+				// 視線方向はカメラが取得できればカメラ, そうでなければプレイヤーの向き.
+				if (auto* camera_manager = UGameplayStatics::GetPlayerCameraManager(this, 0))
+				{
+					main2AsyncParam_[0].important_forward_ = camera_manager->GetCameraRotation().Vector();
+
+					visibility_view_.is_valid = true;
+					visibility_view_.location = camera_manager->GetCameraLocation();
+					visibility_view_.rotation = camera_manager->GetCameraRotation();
+					visibility_view_.fov_degree = camera_manager->GetFOVAngle();
+					visibility_view_.aspect_ratio = 1.0f;
+					if (GEngine && GEngine->GameViewport)
+					{
+						FVector2D viewport_size;
+						GEngine->GameViewport->GetViewportSize(viewport_size);
+						if (0.0 < viewport_size.Y)
+							visibility_view_.aspect_ratio = viewport_size.X / viewport_size.Y;
+					}
+				}
+				else
+				{
+					main2AsyncParam_[0].important_forward_ = player_actor->GetActorForwardVector();
+				}
+
 			}
 			else
 			{
@@ -250,6 +576,13 @@ class AVoxelEngine;
 						auto CameraRotation = level_viewport_clients->GetViewRotation();
 
 						main2AsyncParam_[0].important_position_ = CameraLocation;
+						main2AsyncParam_[0].important_forward_ = CameraRotation.Vector();
+
+						visibility_view_.is_valid = true;
+						visibility_view_.location = CameraLocation;
+						visibility_view_.rotation = CameraRotation;
+						visibility_view_.fov_degree = level_viewport_clients->ViewFOV;
+						visibility_view_.aspect_ratio = level_viewport_clients->AspectRatio;
 
 						break;
 					}
@@ -263,9 +596,10 @@ class AVoxelEngine;
 
 
 		// 空にする.
-		stream_out_chunk_array_[0].Empty(stream_out_chunk_array_[0].Max());
-		stream_in_chunk_array_[0].Empty(stream_in_chunk_array_[0].Max());
+		stream_out_chunk_array_.Empty(stream_out_chunk_array_.Max());
+		stream_in_chunk_array_.Empty(stream_in_chunk_array_.Max());
 		render_dirty_chunk_id_array_.Empty(render_dirty_chunk_id_array_.Max());
+		lod_change_chunk_array_.Empty(lod_change_chunk_array_.Max());
 		{
 			for (auto&& e : voxel_chunk_map_)
 			{
@@ -282,31 +616,17 @@ class AVoxelEngine;
 				if (need_stream_out)
 				{
 					// stream out するチャンクに追加.
-					stream_out_chunk_array_[0].Add(e.Key);
+					stream_out_chunk_array_.Add(e.Key);
 				}
 				else
 				{
-#if 0
 					// LOD切り替えチェック
-					const auto chunk_distance_len = FVector::Distance(FVector::ZeroVector, FVector(chunk_distance));
-					const auto world_distance_len = chunk_distance_len * ChunkType::CHUNK_RESOLUTION() * voxel_size_;
-
-					auto lod_level = static_cast<unsigned int>(world_distance_len / (ChunkType::CHUNK_RESOLUTION() * voxel_size_ * 6));// 適当に距離に線形にLOD
-					// 最小LODでクランプ
-					lod_level = FMath::Min(e.Value->LOD_MAX_INDEX(), FMath::Max( static_cast<unsigned int>(min_lod_level_), lod_level));
-
+					// チャンクのLODはAsyncのメッシュ生成で参照されるため, ここでは変更せずSyncで反映する.
+					const auto lod_level = CalcChunkLodLevel(e.Key, important_chunk_position);
 					if (e.Value->GetCurrentLodLevel() != lod_level)
 					{
-						e.Value->SetCurrentLodLevel(lod_level);
-
-						// 描画パラメータ更新リストに追加.
-						// 最大LODをチェックして有効なセルが一つもない場合は描画不要のためスキップする
-						if (e.Value->Get(0, 0, 0, e.Value->LOD_MAX_INDEX()))
-						{
-							render_dirty_chunk_id_array_.Add(e.Key);
-						}
+						lod_change_chunk_array_.Add(TPair<FIntVector, unsigned int>(e.Key, lod_level));
 					}
-#endif
 				}
 			}
 
@@ -323,7 +643,7 @@ class AVoxelEngine;
 						if (!find_current_chunk)
 						{
 							// デコードが必要なチャンクリストアップ
-							stream_in_chunk_array_[0].Add(target_chunk);
+							stream_in_chunk_array_.Add(target_chunk);
 						}
 					}
 				}
@@ -335,32 +655,69 @@ class AVoxelEngine;
 			// 非同期タスクの完了待ち
 			async_task_.WaitAsyncUpdate();
 
+			// Asyncの処理統計をフレームの統計へ移す. Mainの項目はこれ以降に設定する.
+			for (int i = 0; i < naga::VoxelEngineStat::Count; ++i)
+			{
+				frame_stats_[i] = async_stats_[i].load(std::memory_order_relaxed);
+			}
 
 			const auto		sync_start_time = std::chrono::system_clock::now();
 			// 同期処理
 			SyncUpdate();
+			// 可視判定. メッシュ生成要求を参照するためAsyncの起動前に実行する.
+			UpdateChunkVisibility();
 			sync_elapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sync_start_time).count();
 
+			frame_stats_[naga::VoxelEngineStat::SyncMicroSec] = sync_elapsed_time;
+			frame_stats_[naga::VoxelEngineStat::StreamInQueueNum] = stream_in_queue_.Num();
+			frame_stats_[naga::VoxelEngineStat::StreamOutQueueNum] = stream_out_queue_.Num();
+			frame_stats_[naga::VoxelEngineStat::MeshRequestNum] = mesh_request_chunk_array_.Num();
+			frame_stats_[naga::VoxelEngineStat::CollisionRequestNum] = collision_request_chunk_array_.Num();
+			frame_stats_[naga::VoxelEngineStat::VisibleChunkNum] = is_visibility_culling_ ? visible_chunk_set_.Num() : voxel_chunk_map_.Num();
+			frame_stats_[naga::VoxelEngineStat::MeshDeferredNum] = mesh_deferred_chunk_set_.Num();
+
+			// RayCast要求. Asyncの停止中にまとめて実行する.
+			{
+				const auto ray_cast_start_time = std::chrono::system_clock::now();
+				ExecuteRayCastVoxel(ray_cast_request_array_, ray_cast_result_array_);
+				frame_stats_[naga::VoxelEngineStat::RayCastCount] = ray_cast_request_array_.Num();
+				frame_stats_[naga::VoxelEngineStat::RayCastMicroSec] = CalcElapsedMicroSec(ray_cast_start_time);
+				ray_cast_request_array_.Reset();
+			}
+
+			// デバッグ表示用のチャンク統計. Asyncはチャンクの圧縮や展開でメモリを再確保するため起動前に集計する.
+			{
+				debug_chunk_stats_ = {};
+				debug_chunk_stats_.sparse_chunk_count = voxel_chunk_map_.NumSparse();
+				for (auto&& it = voxel_chunk_map_.begin(); it != voxel_chunk_map_.end(); ++it)
+				{
+					debug_chunk_stats_.chunk_memory_byte_size += it->Value->GetAllocatedSize();
+					++debug_chunk_stats_.chunk_count;
+					if (it->Value->IsCompressed())
+						++debug_chunk_stats_.compressed_chunk_count;
+				}
+				// Voxel本体のブロックプールはAsyncのワーカーが確保と解放をするため同様に起動前に取得する.
+				debug_chunk_stats_.rows_pool_usage = ChunkType::GetRowsPool().GetUsage();
+			}
+
 			// 非同期タスクを起動
 			async_task_.StartAsyncUpdate(true);
 		}
 
 		// Update Render
+		// メッシュ生成はAsync側で実行済みのため, ここでは生成結果の反映のみ.
 		UpdateRenderChunk(render_dirty_chunk_id_array_);
 
 
 		const auto		tick_elapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - tick_start_time).count();
 
+		frame_stats_[naga::VoxelEngineStat::TickMicroSec] = tick_elapsed_time;
+		PublishFrameStats();
+
 		// デバッグ表示
 		{
-			// チャンクのメモリ使用量チェック
-			int chunk_count = 0;
-			size_t chunk_memory_byte_size = 0;
-			for (auto&& it = voxel_chunk_map_.begin(); it != voxel_chunk_map_.end(); ++it)
-			{
-				chunk_memory_byte_size += it->Value->GetAllocatedSize();
-				++chunk_count;
-			}
+			// チャンクのメモリ使用量はAsync起動前に集計したもの.
+			const auto& chunk_stats = debug_chunk_stats_;
 
 			int chunk_mesh_component_count = 0;
 			for (auto&& it = chunk_mesh_component_map_.begin(); it != chunk_mesh_component_map_.end(); ++it)
@@ -369,6 +726,9 @@ class AVoxelEngine;
 			}
 			int chunk_mesh_component_pool_count = chunk_mesh_component_pool_.Num();
 
+			// チャンクプールの使用状況.
+			const auto& rows_pool_usage = chunk_stats.rows_pool_usage;
+			const float rows_pool_mb = static_cast<float>(rows_pool_usage.allocated_byte_size) / (1024.0f * 1024.0f);
 
 			int chunk_proc_mesh_component_count = 0;
 			for (auto&& it = chunk_proc_mesh_component_map_.begin(); it != chunk_proc_mesh_component_map_.end(); ++it)
@@ -378,60 +738,275 @@ class AVoxelEngine;
 
 			auto display_string =
 				FString::Printf(
-					TEXT("VoxelEngine\n    runtime_chunk:%f[MB]\n	chunk_count:%d\n	mesh_count:%d\n	mesh_pool:%d\n\n	proc_mesh_count:%d\n"),
+					TEXT("VoxelEngine\n    runtime_chunk:%f[MB]\n	chunk_count:%d\n	sparse_chunk_count:%d\n	compressed_chunk_count:%d\n	mesh_count:%d\n	mesh_pool:%d\n\n	proc_mesh_count:%d\n	mesh_request:%d\n	chunk_pool:%d/%d\n	rows_pool:%d/%d (%f[MB])\n"),
 
 
-					(static_cast<float>(chunk_memory_byte_size)/(1024.0f*1024.0f)),
-					chunk_count,
+					(static_cast<float>(chunk_stats.chunk_memory_byte_size)/(1024.0f*1024.0f)),
+					chunk_stats.chunk_count,
+					chunk_stats.sparse_chunk_count,
+					chunk_stats.compressed_chunk_count,
 					chunk_mesh_component_count,
 					chunk_mesh_component_pool_count,
-					chunk_proc_mesh_component_count
+					chunk_proc_mesh_component_count,
+					mesh_request_chunk_array_.Num(),
+					chunk_pool_.NumFreeChunks(), chunk_pool_.NumChunks(),
+					rows_pool_usage.num_free_blocks, rows_pool_usage.num_blocks, rows_pool_mb
 				);
 
 			auto display_string2 =
 				FString::Printf(
-					TEXT("\n    tick_time:%d[micro sec]\n	sync_time:%d[micro sec]\n\n	async_time:%d[micro sec]\n"),
+					TEXT("\n    tick_time:%d[micro sec]\n	sync_time:%d[micro sec]\n	overlap_sync_time:%d[micro sec]\n	mesh_upload_time:%d[micro sec]\n\n	async_time:%d[micro sec]\n	noise_time:%d[micro sec]\n	lod_time:%d[micro sec]\n	meshing_time:%d[micro sec]\n	stream_in_queue:%d\n"),
 
 
 					tick_elapsed_time,
 					sync_elapsed_time,
-					async_micro_sec_
+					frame_stats_[naga::VoxelEngineStat::OverlapSyncMicroSec],
+					frame_stats_[naga::VoxelEngineStat::MeshUploadMicroSec],
+					frame_stats_[naga::VoxelEngineStat::AsyncMicroSec],
+					frame_stats_[naga::VoxelEngineStat::NoiseMicroSec],
+					frame_stats_[naga::VoxelEngineStat::LodMicroSec],
+					frame_stats_[naga::VoxelEngineStat::MeshingMicroSec],
+					frame_stats_[naga::VoxelEngineStat::StreamInQueueNum]
 				);
 
 			UKismetSystemLibrary::DrawDebugString(GetWorld(), GetActorLocation(), display_string + display_string2, nullptr, FLinearColor::White, 0);
 		}
 	}
 
+	// 近傍チャンクの面、エッジ、角から自身のオーバーラップ部へコピーする.
+	// ni,nj,nk : 自身からみた近傍チャンクの方向.
+	void AVoxelEngine::CopyChunkOverlapFromNeighbor(ChunkType* target, const ChunkType* neightbor_chunk, int ni, int nj, int nk)
+	{
+		if (false) {/*dummy*/}
+		else if (ni == -1 && nj == 0 && nk == 0) target->CopyOverlapFromSrcEdgeX<false>(neightbor_chunk);
+		else if (ni == 1 && nj == 0 && nk == 0) target->CopyOverlapFromSrcEdgeX<true>(neightbor_chunk);
+		else if (ni == 0 && nj == -1 && nk == 0) target->CopyOverlapFromSrcEdgeY<false>(neightbor_chunk);
+		else if (ni == 0 && nj == 1 && nk == 0) target->CopyOverlapFromSrcEdgeY<true>(neightbor_chunk);
+		else if (ni == 0 && nj == 0 && nk == -1) target->CopyOverlapFromSrcEdgeZ<false>(neightbor_chunk);
+		else if (ni == 0 && nj == 0 && nk == 1) target->CopyOverlapFromSrcEdgeZ<true>(neightbor_chunk);
+		else if (ni == -1 && nj == -1 && nk == 0) target->CopyOverlapFromSrcEdgeXY<false, false>(neightbor_chunk);
+		else if (ni == 1 && nj == -1 && nk == 0) target->CopyOverlapFromSrcEdgeXY<true, false>(neightbor_chunk);
+		else if (ni == -1 && nj == 1 && nk == 0) target->CopyOverlapFromSrcEdgeXY<false, true>(neightbor_chunk);
+		else if (ni == 1 && nj == 1 && nk == 0) target->CopyOverlapFromSrcEdgeXY<true, true>(neightbor_chunk);
+		else if (ni == -1 && nj == 0 && nk == -1) target->CopyOverlapFromSrcEdgeXZ<false, false>(neightbor_chunk);
+		else if (ni == 1 && nj == 0 && nk == -1) target->CopyOverlapFromSrcEdgeXZ<true, false>(neightbor_chunk);
+		else if (ni == -1 && nj == 0 && nk == 1) target->CopyOverlapFromSrcEdgeXZ<false, true>(neightbor_chunk);
+		else if (ni == 1 && nj == 0 && nk == 1) target->CopyOverlapFromSrcEdgeXZ<true, true>(neightbor_chunk);
+		else if (ni == 0 && nj == -1 && nk == -1) target->CopyOverlapFromSrcEdgeYZ<false, false>(neightbor_chunk);
+		else if (ni == 0 && nj == 1 && nk == -1) target->CopyOverlapFromSrcEdgeYZ<true, false>(neightbor_chunk);
+		else if (ni == 0 && nj == -1 && nk == 1) target->CopyOverlapFromSrcEdgeYZ<false, true>(neightbor_chunk);
+		else if (ni == 0 && nj == 1 && nk == 1) target->CopyOverlapFromSrcEdgeYZ<true, true>(neightbor_chunk);
+		else if (ni == -1 && nj == -1 && nk == -1) target->CopyOverlapFromSrcEdgeXYZ<false, false, false>(neightbor_chunk);
+		else if (ni == 1 && nj == -1 && nk == -1) target->CopyOverlapFromSrcEdgeXYZ<true, false, false>(neightbor_chunk);
+		else if (ni == -1 && nj == 1 && nk == -1) target->CopyOverlapFromSrcEdgeXYZ<false, true, false>(neightbor_chunk);
+		else if (ni == 1 && nj == 1 && nk == -1) target->CopyOverlapFromSrcEdgeXYZ<true, true, false>(neightbor_chunk);
+		else if (ni == -1 && nj == -1 && nk == 1) target->CopyOverlapFromSrcEdgeXYZ<false, false, true>(neightbor_chunk);
+		else if (ni == 1 && nj == -1 && nk == 1) target->CopyOverlapFromSrcEdgeXYZ<true, false, true>(neightbor_chunk);
+		else if (ni == -1 && nj == 1 && nk == 1) target->CopyOverlapFromSrcEdgeXYZ<false, true, true>(neightbor_chunk);
+		else if (ni == 1 && nj == 1 && nk == 1) target->CopyOverlapFromSrcEdgeXYZ<true, true, true>(neightbor_chunk);
+	}
+
+	// メッシュ生成要求の追加. 未処理の要求はセットで管理し, 重複は追加しない.
+	void AVoxelEngine::AddMeshRequest(const FIntVector& chunk_id)
+	{
+		bool is_already_requested = false;
+		mesh_request_chunk_set_.Add(chunk_id, &is_already_requested);
+		if (!is_already_requested)
+			mesh_request_chunk_array_.Add(chunk_id);
+	}
+
+	// オーバーラップ部の同期は対象チャンク毎に並列化する.
+	// SparseVoxelTreeMpmSystemのApron同期(単方向13近傍で自身と相手の両方のApronを書く)はVoxel毎に独立した要素なので並列に書き込めるが,
+	// ビットチャンクではX方向のオーバーラップ部が内部と同じRowワードにあり, 相手側へ書くと相手自身の書き込みと同一ワードで競合する.
+	// また同期は変更フラグの立った方向のみ片側で行い, 圧縮状態の近傍は展開が必要なため, ペア単位ではなく対象チャンク単位で処理する.
+	// 各対象チャンクは自身のRowのみ書き換え, 近傍チャンクは先に境界をスナップショットへ取り出し(並列), その後スナップショットから各対象チャンクへコピーする(並列).
+	void AVoxelEngine::SyncChunkOverlapParallel(const TArray<ChunkType*>& target_chunk_array)
+	{
+		if (0 >= target_chunk_array.Num())
+			return;
+
+		overlap_source_chunk_array_.Reset();
+		overlap_copy_array_.Reset();
+		overlap_copy_begin_.Reset();
+
+		// 対象チャンク毎のコピー要求と, 参照されるソースチャンクを収集. ソースチャンクの重複はチャンク側に記録した同期回で判定する.
+		++overlap_sync_epoch_;
+		if (0 == overlap_sync_epoch_)
+			++overlap_sync_epoch_;
+		for (auto target : target_chunk_array)
+		{
+			overlap_copy_begin_.Add(overlap_copy_array_.Num());
+
+			const auto id = target->GetId();
+			for (int nk = -1; nk <= 1; ++nk)
+			{
+				for (int nj = -1; nj <= 1; ++nj)
+				{
+					for (int ni = -1; ni <= 1; ++ni)
+					{
+						// 0,0,0は常にfalseになるようにビット操作しているのでチェック不要
+						if (!target->GetNeighborChunkChangeFlag(ni, nj, nk))
+							continue;
+
+						auto&& neighbor_chunk_ptr = voxel_chunk_map_.Find(id + FIntVector(ni, nj, nk));
+						if (!neighbor_chunk_ptr || !*neighbor_chunk_ptr || naga::VoxelChunkState::Active != (*neighbor_chunk_ptr)->GetState())
+							continue;
+
+						const auto neighbor_chunk = *neighbor_chunk_ptr;
+						const int source_index = neighbor_chunk->RegisterOverlapSource(overlap_sync_epoch_, overlap_source_chunk_array_.Num());
+						if (source_index == overlap_source_chunk_array_.Num())
+							overlap_source_chunk_array_.Add(neighbor_chunk);
+
+						naga::VoxelOverlapCopyRequest request;
+						request.source_index = source_index;
+						request.ni = static_cast<int8>(ni);
+						request.nj = static_cast<int8>(nj);
+						request.nk = static_cast<int8>(nk);
+						overlap_copy_array_.Add(request);
+					}
+				}
+			}
+		}
+		overlap_copy_begin_.Add(overlap_copy_array_.Num());
+
+		// ソースチャンクの境界スナップショット. 圧縮状態の場合は展開する. 遠方であれば次回以降のAsyncで再圧縮される.
+		constexpr int boundary_word_count = ChunkType::BOUNDARY_WORD_COUNT();
+		overlap_boundary_buffer_.SetNumUninitialized(overlap_source_chunk_array_.Num() * boundary_word_count, EAllowShrinking::No);
+		ParallelFor(overlap_source_chunk_array_.Num(),
+			[this, boundary_word_count](int32 source_index)
+			{
+				auto chunk = overlap_source_chunk_array_[source_index];
+				chunk->Decompress();
+				chunk->StoreBoundary(overlap_boundary_buffer_.GetData() + source_index * boundary_word_count);
+			});
+
+		// スナップショットから各対象チャンクのオーバーラップ部へコピー.
+		ParallelFor(target_chunk_array.Num(),
+			[this, &target_chunk_array, boundary_word_count](int32 target_index)
+			{
+				const int copy_begin = overlap_copy_begin_[target_index];
+				const int copy_end = overlap_copy_begin_[target_index + 1];
+				if (copy_begin == copy_end)
+					return;
+
+				auto target = target_chunk_array[target_index];
+				target->Decompress();
+				for (int i = copy_begin; i < copy_end; ++i)
+				{
+					const auto& request = overlap_copy_array_[i];
+					target->CopyOverlapFromNeighborBoundary(overlap_boundary_buffer_.GetData() + request.source_index * boundary_word_count, request.ni, request.nj, request.nk);
+				}
+			});
+	}
+
 	// 非同期処理.
 	void AVoxelEngine::SyncUpdate()
 	{
+		SCOPE_CYCLE_COUNTER(STAT_VoxelEngine_SyncUpdate);
 		// voxel_chunk_map_への要素追加や削除は同期中に実行する.
 
 		// Asyncへのパラメータをコピーする
 		main2AsyncParam_[1] = main2AsyncParam_[0];
 
+		// Asyncで生成したメッシュを描画側へ渡す. 描画側は[0]を読み取り, Asyncは[1]へ書き込む.
+		Swap(mesh_complete_array_[0], mesh_complete_array_[1]);
+		mesh_complete_array_[1].Reset();
+		Swap(collision_complete_array_[0], collision_complete_array_[1]);
+		collision_complete_array_[1].Reset();
+
+		// 編集要求をAsync側へ. 前回のAsyncですべて適用済み.
+		edit_apply_array_.Append(edit_request_array_);
+		edit_request_array_.Reset();
+
 
 		// Stream In 情報をAsync側へ
-		for (auto&& e : stream_in_chunk_array_[0])
+		for (auto&& e : stream_in_chunk_array_)
 		{
-			stream_in_chunk_array_[1].Add(e);
+			stream_in_queue_.Push(e, CalcChunkStreamInPriority(e, stream_priority_position_, stream_priority_forward_));
 
 			// Mapに追加.
-			auto&& new_chunk = voxel_chunk_map_.Add(e);
+			auto&& new_chunk = voxel_chunk_map_.FindOrAdd(e);
 			if (!new_chunk)
 			{
-				// 要素確保.
-				new_chunk = new ChunkType();
+				// 要素確保. プールから再利用する.
+				new_chunk = chunk_pool_.Acquire();
 				// IDを設定
 				new_chunk->SetId(e);
 				// 状態を設定.
 				new_chunk->SetState(naga::VoxelChunkState::Empty);
+
+				// ベンチマーク中は要求時刻を記録.
+				if (stream_benchmark_.is_running)
+					stream_benchmark_.request_sec_map.Add(e, FPlatformTime::Seconds());
+			}
+		}
+		// 重視チャンクが移動した場合はStreamOut範囲外となった未処理のStreamIn要求を破棄する.
+		// Asyncでの取り出し時のキャンセルのみでは, 移動がロードより速い場合にEmptyのチャンクがMapとキューに蓄積するため.
+		{
+			const FIntVector stream_chunk_position = naga::math::FVectorFloorToInt(main2AsyncParam_[1].important_position_ / (voxel_size_ * ChunkType::CHUNK_RESOLUTION()));
+			if (stream_in_purge_chunk_position_ != stream_chunk_position)
+			{
+				stream_in_purge_chunk_position_ = stream_chunk_position;
+				// 索引のリング窓を重視チャンクへ追従させる.
+				voxel_chunk_map_.SetCenter(stream_chunk_position);
+				stream_in_queue_.RemoveIf([this, stream_chunk_position](const FIntVector& chunk_id)
+					{
+						const auto chunk_distance = stream_chunk_position - chunk_id;
+						if (stream_out_chunk_range >= FMath::Max3(abs(chunk_distance.X), abs(chunk_distance.Y), abs(chunk_distance.Z)))
+							return false;
+
+						auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
+						if (chunk_ptr && *chunk_ptr)
+						{
+							// 未処理の要求のチャンクはEmptyのはず. それ以外は要求のみ破棄.
+							if (naga::VoxelChunkState::Empty != (*chunk_ptr)->GetState())
+								return true;
+							chunk_pool_.Release(*chunk_ptr);
+						}
+						voxel_chunk_map_.Remove(chunk_id);
+						stream_benchmark_.request_sec_map.Remove(chunk_id);
+						return true;
+					});
+			}
+		}
+
+		// 圧縮範囲外へ出たチャンクを圧縮候補に登録する.
+		// 重視チャンクの移動時や範囲の変更時に, 前回の圧縮範囲のうち新しい圧縮範囲外となった部分のみ調べる.
+		{
+			const FIntVector compress_center = naga::math::FVectorFloorToInt(main2AsyncParam_[1].important_position_ / (voxel_size_ * ChunkType::CHUNK_RESOLUTION()));
+			if (compress_candidate_center_ != compress_center || compress_candidate_range_ != compress_chunk_range)
+			{
+				const int prev_range = compress_candidate_range_;
+				for (int k = -prev_range; k <= prev_range; ++k)
+				{
+					for (int j = -prev_range; j <= prev_range; ++j)
+					{
+						for (int i = -prev_range; i <= prev_range; ++i)
+						{
+							const auto chunk_id = compress_candidate_center_ + FIntVector(i, j, k);
+							const auto chunk_distance = compress_center - chunk_id;
+							if (compress_chunk_range >= FMath::Max3(abs(chunk_distance.X), abs(chunk_distance.Y), abs(chunk_distance.Z)))
+								continue;
+							if (voxel_chunk_map_.Contains(chunk_id))
+								compress_candidate_chunk_array_.Add(chunk_id);
+						}
+					}
+				}
+				compress_candidate_center_ = compress_center;
+				compress_candidate_range_ = compress_chunk_range;
 			}
 		}
+
 		// Stream Out 情報をAsync側へ
-		for (auto&& e : stream_out_chunk_array_[0])
+		// キュー内のチャンクはUnloadingとしてTickでの重複リストアップやメッシュ生成の対象外とする.
+		for (auto&& e : stream_out_chunk_array_)
 		{
-			stream_out_chunk_array_[1].Add(e);
+			auto&& chunk_ptr = voxel_chunk_map_.Find(e);
+			if (!chunk_ptr || !*chunk_ptr || naga::VoxelChunkState::Active != (*chunk_ptr)->GetState())
+				continue;
+
+			(*chunk_ptr)->SetState(naga::VoxelChunkState::Unloading);
+			stream_out_queue_.Push(e, CalcChunkStreamOutPriority(e, stream_priority_position_));
 		}
 
 
@@ -443,10 +1018,10 @@ class AVoxelEngine;
 			{
 				auto&& chunk = *chunk_ptr;
 				assert(VoxelChunkState::Deletable == chunk->GetState());
-				// 要素破棄
+				// 要素破棄. プールへ返却.
 				if (chunk)
 				{
-					delete chunk;
+					chunk_pool_.Release(chunk);
 					chunk = nullptr;
 				}
 				// Mapから除外
@@ -476,76 +1051,21 @@ class AVoxelEngine;
 					}
 					chunk_proc_mesh_component_map_.Remove(e);
 				}
-			}
-		}
-
-		// 近傍チャンクからオーバーラップ部をコピーする処理. こちらに統合したい.
-		auto func_copy_overlap_from_neighbor = [this](ChunkType* target)
-		{
-			const auto id = target->GetId();
-
-			// 近傍チャンクとのOverlapDirty
-			for (int nk = -1; nk <= 1; ++nk)
-			{
-				for (int nj = -1; nj <= 1; ++nj)
+				// コリジョン
 				{
-					for (int ni = -1; ni <= 1; ++ni)
+					auto&& chunk_collision = chunk_collision_component_map_.Find(e);
+					if (chunk_collision)
 					{
-						// 0,0,0は常にfalseになるようにビット操作しているのでチェック不要
-						if (target->GetNeighborChunkChangeFlag(ni, nj, nk))
-						{
-							const auto neightbor_chunk_id = id + FIntVector(ni, nj, nk);
-
-							if (auto&& neightbor_chunk_ptr = voxel_chunk_map_.Find(neightbor_chunk_id))
-							{
-								const auto neightbor_chunk = *neightbor_chunk_ptr;
-								if (naga::VoxelChunkState::Active == neightbor_chunk->GetState())
-								{
-									if (true)
-									{
-										// 隣接チャンクの面、エッジ、角からのコピー.
-
-										if (false) {/*dummy*/}
-										else if (ni == -1 && nj == 0 && nk == 0) target->CopyOverlapFromSrcEdgeX<false>(neightbor_chunk);
-										else if (ni == 1 && nj == 0 && nk == 0) target->CopyOverlapFromSrcEdgeX<true>(neightbor_chunk);
-										else if (ni == 0 && nj == -1 && nk == 0) target->CopyOverlapFromSrcEdgeY<false>(neightbor_chunk);
-										else if (ni == 0 && nj == 1 && nk == 0) target->CopyOverlapFromSrcEdgeY<true>(neightbor_chunk);
-										else if (ni == 0 && nj == 0 && nk == -1) target->CopyOverlapFromSrcEdgeZ<false>(neightbor_chunk);
-										else if (ni == 0 && nj == 0 && nk == 1) target->CopyOverlapFromSrcEdgeZ<true>(neightbor_chunk);
-
-										else if (ni == -1 && nj == -1 && nk == 0) target->CopyOverlapFromSrcEdgeXY<false, false>(neightbor_chunk);
-										else if (ni == 1 && nj == -1 && nk == 0) target->CopyOverlapFromSrcEdgeXY<true, false>(neightbor_chunk);
-										else if (ni == -1 && nj == 1 && nk == 0) target->CopyOverlapFromSrcEdgeXY<false, true>(neightbor_chunk);
-										else if (ni == 1 && nj == 1 && nk == 0) target->CopyOverlapFromSrcEdgeXY<true, true>(neightbor_chunk);
-
-										else if (ni == -1 && nj == 0 && nk == -1) target->CopyOverlapFromSrcEdgeXZ<false, false>(neightbor_chunk);
-										else if (ni == 1 && nj == 0 && nk == -1) target->CopyOverlapFromSrcEdgeXZ<true, false>(neightbor_chunk);
-										else if (ni == -1 && nj == 0 && nk == 1) target->CopyOverlapFromSrcEdgeXZ<false, true>(neightbor_chunk);
-										else if (ni == 1 && nj == 0 && nk == 1) target->CopyOverlapFromSrcEdgeXZ<true, true>(neightbor_chunk);
-
-										else if (ni == 0 && nj == -1 && nk == -1) target->CopyOverlapFromSrcEdgeYZ<false, false>(neightbor_chunk);
-										else if (ni == 0 && nj == 1 && nk == -1) target->CopyOverlapFromSrcEdgeYZ<true, false>(neightbor_chunk);
-										else if (ni == 0 && nj == -1 && nk == 1) target->CopyOverlapFromSrcEdgeYZ<false, true>(neightbor_chunk);
-										else if (ni == 0 && nj == 1 && nk == 1) target->CopyOverlapFromSrcEdgeYZ<true, true>(neightbor_chunk);
-
-										else if (ni == -1 && nj == -1 && nk == -1) target->CopyOverlapFromSrcEdgeXYZ<false, false, false>(neightbor_chunk);
-										else if (ni == 1 && nj == -1 && nk == -1) target->CopyOverlapFromSrcEdgeXYZ<true, false, false>(neightbor_chunk);
-										else if (ni == -1 && nj == 1 && nk == -1) target->CopyOverlapFromSrcEdgeXYZ<false, true, false>(neightbor_chunk);
-										else if (ni == 1 && nj == 1 && nk == -1) target->CopyOverlapFromSrcEdgeXYZ<true, true, false>(neightbor_chunk);
-										else if (ni == -1 && nj == -1 && nk == 1) target->CopyOverlapFromSrcEdgeXYZ<false, false, true>(neightbor_chunk);
-										else if (ni == 1 && nj == -1 && nk == 1) target->CopyOverlapFromSrcEdgeXYZ<true, false, true>(neightbor_chunk);
-										else if (ni == -1 && nj == 1 && nk == 1) target->CopyOverlapFromSrcEdgeXYZ<false, true, true>(neightbor_chunk);
-										else if (ni == 1 && nj == 1 && nk == 1) target->CopyOverlapFromSrcEdgeXYZ<true, true, true>(neightbor_chunk);
-									}
-								}
-
-							}
-						}
+						(*chunk_collision)->DestroyComponent();
 					}
+					chunk_collision_component_map_.Remove(e);
+					collision_chunk_set_.Remove(e);
 				}
 			}
-		};
+		}
 
+		// カレント重視チャンク
+		const FIntVector important_chunk_position = naga::math::FVectorFloorToInt(main2AsyncParam_[0].important_position_ / (voxel_size_ * ChunkType::CHUNK_RESOLUTION()));
 
 		// Asyncによる stream in完了要素を処理
 		TMap<FIntVector, ChunkType*> diry_chunk_map;
@@ -564,6 +1084,22 @@ class AVoxelEngine;
 
 			diry_chunk_map.Add(e, chunk);
 			chunk->SetAnyVoxelChangeFlag(false);
+
+			// 初期LODを設定.
+			chunk->SetCurrentLodLevel(CalcChunkLodLevel(e, important_chunk_position));
+		}
+		// Asyncによる編集完了要素を処理. エッジ部の変更フラグはAsyncでセット済み.
+		for (auto&& e : edit_chunk_complete_array_)
+		{
+			auto&& chunk_ptr = voxel_chunk_map_.Find(e);
+			if (!chunk_ptr || !*chunk_ptr)
+				continue;
+			auto&& chunk = *chunk_ptr;
+			if (naga::VoxelChunkState::Active != chunk->GetState())
+				continue;
+
+			diry_chunk_map.Add(e, chunk);
+			chunk->SetAnyVoxelChangeFlag(false);
 		}
 		// 変更があったチャンクのエッジとオーバーラップしている近傍チャンクのフラグをセットする
 		// TODO. 理想は変更のあったチャンクのみループ
@@ -612,46 +1148,135 @@ class AVoxelEngine;
 			chunk->ClearEdgeVoxelChangeFlag();
 		}
 
-		// TODO. 非効率だが検証のため全チャンクをループ
-		// TODO. NeighborChunkChangeFlagが非ゼロのチャンクのみループ
-		for (auto e : voxel_chunk_map_)
+		// 近傍更新フラグが立っているチャンクのオーバーラップ部をまとめて並列に同期する.
+		const auto overlap_sync_start_time = std::chrono::system_clock::now();
 		{
-			const auto id = e.Key;
-			auto chunk = e.Value;
+			TArray<ChunkType*> overlap_target_array;
+			for (auto e : voxel_chunk_map_)
+			{
+				auto chunk = e.Value;
 
-			// ステートチェック
-			if (naga::VoxelChunkState::Active != chunk->GetState())
-				continue;
+				// ステートチェック
+				if (naga::VoxelChunkState::Active != chunk->GetState())
+					continue;
 
-			if (!chunk->GetAnyNeighborChunkChangeFlag())
-				continue;
+				if (!chunk->GetAnyNeighborChunkChangeFlag())
+					continue;
 
-			const auto nz = chunk->GetNeighborChunkChangeFlag(0, 0, -1);
-			const auto pz = chunk->GetNeighborChunkChangeFlag(0, 0, 1);
+				overlap_target_array.Add(chunk);
+				// 変更チャンクとして登録
+				diry_chunk_map.Add(e.Key, chunk);
+			}
 
-			func_copy_overlap_from_neighbor(chunk);
+			SyncChunkOverlapParallel(overlap_target_array);
 
 			// オーバーラップ部コピーが完了したのでフラグクリア.
-			chunk->ClearNeighborChunkChangeFlag();
-
-			// 変更チャンクとして登録
-			diry_chunk_map.Add(id, chunk);
+			for (auto chunk : overlap_target_array)
+			{
+				chunk->ClearNeighborChunkChangeFlag();
+			}
 		}
+		frame_stats_[naga::VoxelEngineStat::OverlapSyncMicroSec] = CalcElapsedMicroSec(overlap_sync_start_time);
 
 		// あらためて描画更新するリストに登録.
 		for (auto e : diry_chunk_map)
 		{
 			// 完了したので描画更新リストに追加.
 			render_dirty_chunk_id_array_.Add(e.Key);
+
+			// Asyncのメッシュ生成リクエストに追加. 前回の未処理分は繰り越されているため重複は追加しない.
+			AddMeshRequest(e.Key);
+		}
+		// 編集されたチャンクは優先してメッシュ生成する. リクエストは末尾から処理される.
+		for (auto&& e : edit_chunk_complete_array_)
+		{
+			if (0 < mesh_request_chunk_array_.Remove(e))
+				mesh_request_chunk_array_.Add(e);
+		}
+
+		// LOD変更の反映.
+		for (auto&& e : lod_change_chunk_array_)
+		{
+			auto&& chunk_ptr = voxel_chunk_map_.Find(e.Key);
+			if (!chunk_ptr || !*chunk_ptr)
+				continue;
+			if (naga::VoxelChunkState::Active != (*chunk_ptr)->GetState())
+				continue;
+
+			(*chunk_ptr)->SetCurrentLodLevel(e.Value);
+
+			// 自身と, スカートの有無が変わる面で隣接するチャンクのメッシュを再生成.
+			AddMeshRequest(e.Key);
+			for (const auto& face_dir : k_chunk_face_dir)
+			{
+				const auto neighbor_chunk_id = e.Key + face_dir;
+				if (auto&& neighbor_chunk_ptr = voxel_chunk_map_.Find(neighbor_chunk_id))
+				{
+					if (naga::VoxelChunkState::Active == (*neighbor_chunk_ptr)->GetState())
+						AddMeshRequest(neighbor_chunk_id);
+				}
+			}
+		}
+
+		// 物理範囲内のコリジョン生成要求.
+		// 範囲に入ったチャンクとVoxelが変化したチャンクを要求する. 描画のメッシュ生成とは独立に, Asyncで数を制限して生成する.
+		{
+			const auto func_chunk_distance = [important_chunk_position](const FIntVector& chunk_id)
+			{
+				const auto d = chunk_id - important_chunk_position;
+				return FMath::Max3(FMath::Abs(d.X), FMath::Abs(d.Y), FMath::Abs(d.Z));
+			};
+
+			// 範囲から1チャンク以上離れたものは除去. 境界付近での生成と破棄の繰り返しを避ける.
+			for (auto it = collision_chunk_set_.CreateIterator(); it; ++it)
+			{
+				if (physics_chunk_range_ + 1 < func_chunk_distance(*it))
+					it.RemoveCurrent();
+			}
+			collision_request_chunk_array_.RemoveAll([this](const FIntVector& e) { return !collision_chunk_set_.Contains(e); });
+
+			for (auto&& e : diry_chunk_map)
+			{
+				if (collision_chunk_set_.Contains(e.Key))
+					collision_request_chunk_array_.AddUnique(e.Key);
+			}
+			for (int k = -physics_chunk_range_; k <= physics_chunk_range_; ++k)
+			{
+				for (int j = -physics_chunk_range_; j <= physics_chunk_range_; ++j)
+				{
+					for (int i = -physics_chunk_range_; i <= physics_chunk_range_; ++i)
+					{
+						const auto chunk_id = important_chunk_position + FIntVector(i, j, k);
+						if (collision_chunk_set_.Contains(chunk_id))
+							continue;
+						auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
+						if (!chunk_ptr || !*chunk_ptr || naga::VoxelChunkState::Active != (*chunk_ptr)->GetState())
+							continue;
+
+						collision_chunk_set_.Add(chunk_id);
+						collision_request_chunk_array_.AddUnique(chunk_id);
+					}
+				}
+			}
+			// Asyncは末尾から処理するため, 重視チャンクに近いものを末尾へ.
+			collision_request_chunk_array_.Sort([&func_chunk_distance](const FIntVector& a, const FIntVector& b) { return func_chunk_distance(a) > func_chunk_distance(b); });
 		}
 
 		// 次のAsyncのためにクリア
 		stream_out_chunk_complete_array_.Empty(stream_out_chunk_complete_array_.Max());
 		stream_in_chunk_complete_array_.Empty(stream_in_chunk_complete_array_.Max());
+		edit_chunk_complete_array_.Empty(edit_chunk_complete_array_.Max());
 	}
 	// 非同期処理.
 	void AVoxelEngine::AsyncUpdate()
 	{
+		SCOPE_CYCLE_COUNTER(STAT_VoxelEngine_AsyncUpdate);
+
+		for (auto&& e : async_stats_)
+		{
+			e.store(0, std::memory_order_relaxed);
+		}
+
 		const float default_chunk_gen_noise_scale = default_chunk_noise_scale_;
 
 		// 非同期処理の継続チェック用マイクロ秒.
@@ -661,34 +1286,91 @@ class AVoxelEngine;
 
 		const auto& main2AsyncParam = main2AsyncParam_[1];
 
-		auto&& stream_out_data = stream_out_chunk_array_[1];
-		auto&& stream_in_data = stream_in_chunk_array_[1];
+		const FIntVector important_chunk_position = naga::math::FVectorFloorToInt(main2AsyncParam.important_position_ / (voxel_size_ * ChunkType::CHUNK_RESOLUTION()));
+		auto func_out_of_stream_range = [this, important_chunk_position](const FIntVector& chunk_id)
+		{
+			const auto chunk_distance = important_chunk_position - chunk_id;
+			return (stream_out_chunk_range < abs(chunk_distance.X)) || (stream_out_chunk_range < abs(chunk_distance.Y)) || (stream_out_chunk_range < abs(chunk_distance.Z));
+		};
+
+		// ストリーミング優先度の再評価.
+		// 重視位置や視線方向が一定以上変化した場合はキューの世代を進め, 要素の優先度は取り出し時や一定数ずつ再計算する.
+		// 優先度は常に世代の基準位置と視線方向で計算するため, 同一世代内の順序は厳密. 閾値未満の変化は次の世代まで反映されない.
+		const auto CalcStreamInPriority = [this](const FIntVector& chunk_id) { return CalcChunkStreamInPriority(chunk_id, stream_priority_position_, stream_priority_forward_); };
+		const auto CalcStreamOutPriority = [this](const FIntVector& chunk_id) { return CalcChunkStreamOutPriority(chunk_id, stream_priority_position_); };
+		{
+			const float chunk_size = voxel_size_ * ChunkType::CHUNK_RESOLUTION();
+			const float moved_chunk_distance = FVector::Distance(stream_priority_position_, main2AsyncParam.important_position_) / chunk_size;
+			// この角度以上視線方向が変化したら再評価.
+			const float forward_threshold_cos = 0.9f;
+			const bool is_forward_changed = forward_threshold_cos > FVector::DotProduct(stream_priority_forward_, main2AsyncParam.important_forward_);
+			if (0.5f < moved_chunk_distance || is_forward_changed)
+			{
+				// 移動距離分は距離が縮まり得る. ペナルティは重視位置からチャンクへの方向にも依存するため, 位置のみの変化でも最大分減り得る.
+				stream_in_queue_.AdvanceEpoch(moved_chunk_distance + CalcChunkStreamInViewPenaltyMax());
+				stream_out_queue_.AdvanceEpoch(moved_chunk_distance);
+
+				stream_priority_position_ = main2AsyncParam.important_position_;
+				stream_priority_forward_ = main2AsyncParam.important_forward_;
+			}
+
+			constexpr int REFRESH_COUNT_PER_UPDATE = 64;
+			stream_in_queue_.Refresh(REFRESH_COUNT_PER_UPDATE, CalcStreamInPriority);
+			stream_out_queue_.Refresh(REFRESH_COUNT_PER_UPDATE, CalcStreamOutPriority);
+
+			// 遅延再評価の取り出し順が全要素の再計算とソートによる順序と一致するか検証する.
+			if (debug_validate_stream_queue_)
+			{
+				constexpr int VALIDATE_POP_COUNT = 64;
+				if (!stream_in_queue_.ValidatePopOrder(VALIDATE_POP_COUNT, CalcStreamInPriority))
+					UE_LOG(LogTemp, Warning, TEXT("[VoxelEngine] stream in queue pop order mismatch."));
+				if (!stream_out_queue_.ValidatePopOrder(VALIDATE_POP_COUNT, CalcStreamOutPriority))
+					UE_LOG(LogTemp, Warning, TEXT("[VoxelEngine] stream out queue pop order mismatch."));
+			}
+		}
 
 		// Stream Out
 		{
-			// すべてを処理せず次回フレームへ繰り越す対応
-			bool is_continue = true;
-			for (;is_continue && 0 < stream_out_data.Num();)
+			TArray<uint8> store_voxel_data;
+
+			// 時間予算内で遠いものから処理し, 残りは次回フレームへ繰り越す.
+			naga::VoxelChunkStreamQueue::Entry entry;
+			for (;;)
 			{
-				// Pop. TODO. Queueにしたいところ.
-				auto chunk_id = stream_out_data.Pop();
+				if (async_continue_limit_micro_sec < std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - async_start_time).count())
+					break;
+				if (!stream_out_queue_.Pop(entry, CalcStreamOutPriority))
+					break;
 
+				const auto chunk_id = entry.chunk_id;
 				auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
 
-				// StreamIn対象は登録済み且つメモリ確保もされているはず.
+				// StreamOut対象は登録済み且つメモリ確保もされているはず.
 				assert(nullptr != chunk_ptr && nullptr != *chunk_ptr);
 				if (!chunk_ptr || !*chunk_ptr)
 					continue;// 念の為
 
 				auto&& chunk = *chunk_ptr;
-				assert(nullptr != *chunk);
-
-				// ステート変更
-				chunk->SetState(naga::VoxelChunkState::Unloading);
-
+				assert(naga::VoxelChunkState::Unloading == chunk->GetState());
 
-				// TODO. chunkをディスクに保存
+				// 要求後に重視位置が戻ってきた場合はキャンセルしてActiveへ戻す.
+				// キュー内にある間の近傍の変更を取り込むため, StreamIn直後と同様にオーバーラップ同期とメッシュ再生成をさせる.
+				if (!func_out_of_stream_range(chunk_id))
+				{
+					chunk->ClearEdgeVoxelChangeFlag(~0u);
+					chunk->ClearNeighborChunkChangeFlag(~0u);
+					chunk->SetState(naga::VoxelChunkState::Active);
+					continue;
+				}
 
+				// 未保存の変更があればディスクに保存
+				if (chunk_store_.IsInitialized() && chunk->GetStoreDirtyFlag())
+				{
+					chunk->Decompress();
+					chunk->WriteVoxelData(store_voxel_data);
+					chunk_store_.Save(chunk_id, store_voxel_data);
+					chunk->SetStoreDirtyFlag(false);
+				}
 
 				// ステート変更
 				chunk->SetState(naga::VoxelChunkState::Deletable);
@@ -697,100 +1379,347 @@ class AVoxelEngine;
 
 				// 完了リストに追加
 				stream_out_chunk_complete_array_.Add(chunk_id);
+				AddAsyncStat(naga::VoxelEngineStat::StreamOutCount, 1);
 			}
 		}
 
-		// Stream In
-		{
-			// フレームレートを落とさないように途中で処理を中断する.
-			bool is_continue = true;
+		// Async内で並列実行するワーカー数.
+		const int worker_count = (0 < async_worker_count_) ? async_worker_count_ : (FTaskGraphInterface::Get().GetNumWorkerThreads() + 1);
 
-			// ParallelForで一度に並列実行する最大数. どうもこの実装ではむしろスパイクが大きくなってしまう
-			//	並列数をあげると一部が直列になってしまうのか指定時間内に終わらせる実装との相性が悪くなるので並列数は少なめ(2とか)にしておく
-			constexpr unsigned int MAX_PARALLEL = 2;
-			ChunkType* parallel_work_target[MAX_PARALLEL] = {};
-			for (; is_continue && 0 < stream_in_data.Num();)
+		// Voxel Edit
+		// 要求の順序を保つため時間予算に関わらずすべて適用する. 影響するチャンク単位で並列に処理し, チャンク内では要求順に適用する.
+		// Voxelが変化したチャンクのみLODを再生成し, 変化がエッジ部に及んだ方向のみ近傍へ通知する.
+		if (0 < edit_apply_array_.Num())
+		{
+			const float chunk_size = voxel_size_ * ChunkType::CHUNK_RESOLUTION();
+			TArray<FIntVector> edit_chunk_array;
+			for (auto&& e : edit_apply_array_)
 			{
-				const auto start_time = std::chrono::system_clock::now();
-
+				const auto chunk_min = naga::math::FVectorFloorToInt((e.center - e.extent) / chunk_size);
+				const auto chunk_max = naga::math::FVectorFloorToInt((e.center + e.extent) / chunk_size);
+				for (int k = chunk_min.Z; k <= chunk_max.Z; ++k)
+				{
+					for (int j = chunk_min.Y; j <= chunk_max.Y; ++j)
+					{
+						for (int i = chunk_min.X; i <= chunk_max.X; ++i)
+						{
+							edit_chunk_array.AddUnique(FIntVector(i, j, k));
+						}
+					}
+				}
+			}
 
-				// 並列処理用データ準備
-				unsigned int parallel_count = 0;
-				for (unsigned int pi = 0; pi < MAX_PARALLEL && 0 < stream_in_data.Num(); ++pi)
+			TQueue<FIntVector, EQueueMode::Mpsc> edit_complete_queue;
+			ParallelFor(edit_chunk_array.Num(),
+				[this, &edit_chunk_array, &edit_complete_queue](int32 job_index)
 				{
-					// Pop. TODO. Queueにしたいところ.
-					auto chunk_id = stream_in_data.Pop();
+					const auto chunk_id = edit_chunk_array[job_index];
 
-					// 対象を取得
+					// 未ロードやStreamOut中のチャンクは対象外.
 					auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
-
-					// StreamIn対象は登録済み且つメモリ確保もされているはず.
-					assert(nullptr != chunk_ptr && nullptr != *chunk_ptr);
 					if (!chunk_ptr || !*chunk_ptr)
-						continue;// 念の為
-
-					// ステートチェック.
-					assert((*chunk_ptr)->GetState() == naga::VoxelChunkState::Empty);
-
-					parallel_work_target[parallel_count] = *chunk_ptr;
-					++parallel_count;
-				}
-
-				// 並列実行.
-				ParallelFor(parallel_count, [this, &parallel_work_target, default_chunk_gen_noise_scale](int32 index)
-				{
-					auto chunk = parallel_work_target[index];
+						return;
+					auto chunk = *chunk_ptr;
+					if (naga::VoxelChunkState::Active != chunk->GetState())
+						return;
 
-					// 状態遷移
-					chunk->SetState(naga::VoxelChunkState::Allocating);
-					// 内部メモリ確保
-					chunk->Allocate();
+					// 圧縮状態の場合は展開.
+					chunk->Decompress();
 
-					// ステート変更
-					chunk->SetState(naga::VoxelChunkState::Loading);
-					chunk->Fill(false);// 念の為フィル
-					// デコード対象チャンクのデータがあるかどうかで分岐
-					if (false)
+					TArray<ChunkType::RowType> prev_rows;
 					{
-						// TODO データがあればデコードする
+						const auto rows = chunk->GetRows();
+						prev_rows.Append(rows.GetData(), rows.Num());
 					}
-					else
+					bool is_changed = false;
+					FIntVector dirty_min(MAX_int32);
+					FIntVector dirty_max(MIN_int32);
+					for (auto&& request : edit_apply_array_)
 					{
-						// データが無ければ適当なノイズから新規生成.
-						GenerateChunkFromNoise(*chunk, default_chunk_gen_noise_scale, 2);
+						is_changed |= ApplyVoxelEdit(*chunk, request, dirty_min, dirty_max);
 					}
-				
-					// すべてのエッジ部のDirtyをセット.
-					// StreamInではなく動的更新の場合は変更のあったエッジのみDirtyを建てるように.
-					chunk->ClearEdgeVoxelChangeFlag(~0u);
-					// 新規生成により近傍のオーバーラップ部を取り込む必要があるため近傍変更フラグもDirty.
-					chunk->ClearNeighborChunkChangeFlag(~0u);
+					if (!is_changed)
+						return;
+
+					// 変更範囲を含むLODのみ再生成.
+					const auto lod_start_time = std::chrono::system_clock::now();
+					chunk->UpdateLodRegion(dirty_min, dirty_max);
+					AddAsyncStat(naga::VoxelEngineStat::LodMicroSec, CalcElapsedMicroSec(lod_start_time));
+					chunk->UpdateFillState();
+					AddAsyncStat(naga::VoxelEngineStat::EditChunkCount, 1);
+
+					// 変化が及んだエッジのみDirty.
+					chunk->SetEdgeVoxelChangeFlagFromDiff(prev_rows);
 					chunk->SetAnyVoxelChangeFlag(true);
+					chunk->SetStoreDirtyFlag(true);
 
+					edit_complete_queue.Enqueue(chunk_id);
+				});
 
-					// 生成が完了したらフラグ設定
-					chunk->SetState(naga::VoxelChunkState::Active);
+			FIntVector chunk_id;
+			while (edit_complete_queue.Dequeue(chunk_id))
+				edit_chunk_complete_array_.Add(chunk_id);
+
+			edit_apply_array_.Reset();
+		}
 
-				}, false);
+		// Meshing
+		{
+			// 時間予算内で処理し, 残りは次回フレームへ繰り越す.
+			auto&& mesh_result_data = mesh_complete_array_[1];
+
+			// リクエストは末尾から処理する.
+			const int job_count = mesh_request_chunk_array_.Num();
+			const int result_base_index = mesh_result_data.Num();
+			mesh_result_data.AddDefaulted(job_count);
+			TArray<bool> job_valid;
+			job_valid.SetNumZeroed(job_count);
+
+			const int taken_job_count = RunJobsWithTimeBudget(job_count, worker_count, async_start_time, async_continue_limit_micro_sec,
+				[this, job_count, result_base_index, &mesh_result_data, &job_valid](int job_index)
+				{
+					const auto chunk_id = mesh_request_chunk_array_[job_count - 1 - job_index];
+
+					// リクエスト後にStreamOutされたチャンクはキャンセル.
+					auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
+					if (!chunk_ptr || !*chunk_ptr)
+						return;
+					auto chunk = *chunk_ptr;
+					if (naga::VoxelChunkState::Active != chunk->GetState())
+						return;
+
+					// 圧縮状態の場合は展開.
+					chunk->Decompress();
+
+					const auto meshing_start_time = std::chrono::system_clock::now();
+					auto&& result = mesh_result_data[result_base_index + job_index];
+					result.chunk_id = chunk_id;
+					BuildChunkMesh(*chunk, result.mesh);
+					job_valid[job_index] = true;
+					AddAsyncStat(naga::VoxelEngineStat::MeshingMicroSec, CalcElapsedMicroSec(meshing_start_time));
+					AddAsyncStat(naga::VoxelEngineStat::MeshCount, 1);
+				});
+
+			// 取得済みリクエストを除去し, キャンセル分と未処理分の結果を詰める.
+			for (int i = 0; i < taken_job_count; ++i)
+				mesh_request_chunk_set_.Remove(mesh_request_chunk_array_[job_count - 1 - i]);
+			mesh_request_chunk_array_.SetNum(job_count - taken_job_count, EAllowShrinking::No);
+			int valid_count = 0;
+			for (int i = 0; i < taken_job_count; ++i)
+			{
+				if (!job_valid[i])
+					continue;
+				// 圧縮範囲外でメッシュ生成を終えたチャンクは圧縮候補.
+				const auto chunk_distance = important_chunk_position - mesh_result_data[result_base_index + i].chunk_id;
+				if (compress_chunk_range < FMath::Max3(abs(chunk_distance.X), abs(chunk_distance.Y), abs(chunk_distance.Z)))
+					compress_candidate_chunk_array_.Add(mesh_result_data[result_base_index + i].chunk_id);
+				if (valid_count != i)
+					Swap(mesh_result_data[result_base_index + valid_count], mesh_result_data[result_base_index + i]);
+				++valid_count;
+			}
+			mesh_result_data.SetNum(result_base_index + valid_count, EAllowShrinking::No);
+		}
 
+		// Collision
+		{
+			// 描画用のメッシュ生成の後に, 1回あたりの最大数と時間予算内で処理し, 残りは次回へ繰り越す.
+			auto&& collision_result_data = collision_complete_array_[1];
+
+			// リクエストは末尾から処理する.
+			const int request_count = collision_request_chunk_array_.Num();
+			const int job_count = FMath::Min(request_count, FMath::Max(0, collision_build_count_per_frame_));
+			const int result_base_index = collision_result_data.Num();
+			collision_result_data.AddDefaulted(job_count);
+			TArray<bool> job_valid;
+			job_valid.SetNumZeroed(job_count);
+
+			const int taken_job_count = RunJobsWithTimeBudget(job_count, worker_count, async_start_time, async_continue_limit_micro_sec,
+				[this, request_count, result_base_index, &collision_result_data, &job_valid](int job_index)
+				{
+					const auto chunk_id = collision_request_chunk_array_[request_count - 1 - job_index];
 
-				// 完了リストに追加
-				for (unsigned int pi = 0; pi < parallel_count; ++pi)
-					stream_in_chunk_complete_array_.Add(parallel_work_target[pi]->GetId());
+					auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
+					if (!chunk_ptr || !*chunk_ptr)
+						return;
+					auto chunk = *chunk_ptr;
+					if (naga::VoxelChunkState::Active != chunk->GetState())
+						return;
+
+					chunk->Decompress();
+
+					const auto collision_start_time = std::chrono::system_clock::now();
+					auto&& result = collision_result_data[result_base_index + job_index];
+					result.chunk_id = chunk_id;
+					BuildChunkCollisionMesh(*chunk, result.mesh);
+					job_valid[job_index] = true;
+					AddAsyncStat(naga::VoxelEngineStat::CollisionMicroSec, CalcElapsedMicroSec(collision_start_time));
+					AddAsyncStat(naga::VoxelEngineStat::CollisionCount, 1);
+				});
+
+			collision_request_chunk_array_.SetNum(request_count - taken_job_count, EAllowShrinking::No);
+			int valid_count = 0;
+			for (int i = 0; i < taken_job_count; ++i)
+			{
+				if (!job_valid[i])
+					continue;
+				if (valid_count != i)
+					Swap(collision_result_data[result_base_index + valid_count], collision_result_data[result_base_index + i]);
+				++valid_count;
+			}
+			collision_result_data.SetNum(result_base_index + valid_count, EAllowShrinking::No);
+		}
+
+		// Stream In
+		{
+			// フレームレートを落とさないように時間予算内で処理し, 残りは次回フレームへ繰り越す.
+			// 優先度順に一定数ずつキューから取り出してワーカーで処理する. 取得されなかった要求はキューへ戻す.
+			// StreamOut範囲外へ出た要求はキャンセルしてメイン側で破棄する.
+			const int job_window_size = worker_count * 4;
+			TArray<naga::VoxelChunkStreamQueue::Entry> job_entry_array;
+
+			TQueue<FIntVector, EQueueMode::Mpsc> complete_queue;
+			TQueue<FIntVector, EQueueMode::Mpsc> cancel_queue;
+
+			for (;;)
+			{
+				job_entry_array.Reset();
+				naga::VoxelChunkStreamQueue::Entry entry;
+				while (job_window_size > job_entry_array.Num() && stream_in_queue_.Pop(entry, CalcStreamInPriority))
+					job_entry_array.Add(entry);
+				if (0 >= job_entry_array.Num())
+					break;
+
+				const int job_count = job_entry_array.Num();
+				const int taken_job_count = RunJobsWithTimeBudget(job_count, worker_count, async_start_time, async_continue_limit_micro_sec,
+					[this, &job_entry_array, &complete_queue, &cancel_queue, &func_out_of_stream_range, default_chunk_gen_noise_scale](int job_index)
+					{
+						const auto chunk_id = job_entry_array[job_index].chunk_id;
+
+						// 対象を取得
+						auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
+
+						// StreamIn対象は登録済み且つメモリ確保もされているはず.
+						assert(nullptr != chunk_ptr && nullptr != *chunk_ptr);
+						if (!chunk_ptr || !*chunk_ptr)
+							return;// 念の為
+
+						auto chunk = *chunk_ptr;
+
+						// ステートチェック.
+						assert(chunk->GetState() == naga::VoxelChunkState::Empty);
+
+						// 要求後にStreamOut範囲外となったチャンクはキャンセル.
+						if (func_out_of_stream_range(chunk_id))
+						{
+							chunk->SetState(naga::VoxelChunkState::Deletable);
+							cancel_queue.Enqueue(chunk_id);
+							return;
+						}
+
+						// 状態遷移
+						chunk->SetState(naga::VoxelChunkState::Allocating);
+						// 内部メモリ確保
+						chunk->Allocate();
+
+						// ステート変更
+						chunk->SetState(naga::VoxelChunkState::Loading);
+						chunk->Fill(false);// 念の為フィル
+						// ストアに保存されているデータがあるかどうかで分岐
+						TArray<uint8> store_data;
+						const auto load_start_time = std::chrono::system_clock::now();
+						if (chunk_store_.Load(chunk_id, store_data) && chunk->ReadVoxelData(store_data))
+						{
+							// ストアのデータと一致しているので保存不要.
+							chunk->SetStoreDirtyFlag(false);
+							AddAsyncStat(naga::VoxelEngineStat::StoreLoadMicroSec, CalcElapsedMicroSec(load_start_time));
+							AddAsyncStat(naga::VoxelEngineStat::StoreLoadCount, 1);
+						}
+						else
+						{
+							// データが無ければ適当なノイズから新規生成.
+							const auto noise_start_time = std::chrono::system_clock::now();
+							GenerateChunkFromNoise(*chunk, default_chunk_gen_noise_scale, 2);
+							AddAsyncStat(naga::VoxelEngineStat::NoiseMicroSec, CalcElapsedMicroSec(noise_start_time));
+
+							const auto lod_start_time = std::chrono::system_clock::now();
+							chunk->UpdateLod();
+							AddAsyncStat(naga::VoxelEngineStat::LodMicroSec, CalcElapsedMicroSec(lod_start_time));
+
+							// 次回からストアから読み込むため保存対象.
+							chunk->SetStoreDirtyFlag(true);
+						}
+						AddAsyncStat(naga::VoxelEngineStat::StreamInCount, 1);
+						chunk->UpdateFillState();
+
+						// すべてのエッジ部のDirtyをセット.
+						// StreamInではなく動的更新の場合は変更のあったエッジのみDirtyを建てるように.
+						chunk->ClearEdgeVoxelChangeFlag(~0u);
+						// 新規生成により近傍のオーバーラップ部を取り込む必要があるため近傍変更フラグもDirty.
+						chunk->ClearNeighborChunkChangeFlag(~0u);
+						chunk->SetAnyVoxelChangeFlag(true);
+
+						// 生成が完了したらフラグ設定
+						chunk->SetState(naga::VoxelChunkState::Active);
+
+						complete_queue.Enqueue(chunk_id);
+					});
+
+				// 取得されなかった要求をキューへ戻す.
+				for (int i = taken_job_count; i < job_count; ++i)
+					stream_in_queue_.Push(job_entry_array[i]);
+				if (taken_job_count < job_count)
+					break;
+			}
+
+			// 完了リストに追加. キャンセル分はStreamOut完了として破棄する.
+			FIntVector chunk_id;
+			while (complete_queue.Dequeue(chunk_id))
+				stream_in_chunk_complete_array_.Add(chunk_id);
+			while (cancel_queue.Dequeue(chunk_id))
+				stream_out_chunk_complete_array_.Add(chunk_id);
+		}
+
+		// 遠方チャンクの圧縮
+		// メッシュ生成済みで近傍とのオーバーラップ同期も完了しているチャンクのみ圧縮状態で常駐させる.
+		// 候補は圧縮範囲外へ出た時とメッシュ生成の完了時に登録される. StreamInが時間予算を使い切っていてもcompress_chunk_min_per_frame個までは圧縮する.
+		if (compress_chunk_range < stream_out_chunk_range)
+		{
+			int compress_count = 0;
+			while (0 < compress_candidate_chunk_array_.Num())
+			{
+				if (compress_chunk_min_per_frame <= compress_count
+					&& async_continue_limit_micro_sec < std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - async_start_time).count())
+					break;
+
+				const auto chunk_id = compress_candidate_chunk_array_.Pop(EAllowShrinking::No);
+				auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
+				if (!chunk_ptr || !*chunk_ptr)
+					continue;
+				auto chunk = *chunk_ptr;
+				if (naga::VoxelChunkState::Active != chunk->GetState() || chunk->IsCompressed())
+					continue;
 
+				const auto chunk_distance = important_chunk_position - chunk_id;
+				if ((compress_chunk_range >= abs(chunk_distance.X)) && (compress_chunk_range >= abs(chunk_distance.Y)) && (compress_chunk_range >= abs(chunk_distance.Z)))
+					continue;
 
+				// 同期待ちやメッシュ生成待ちのチャンクは除外. それらはメッシュ生成の完了時に再度候補となる.
+				if (chunk->GetAnyEdgeVoxelChangeFlag() || chunk->GetAnyNeighborChunkChangeFlag() || mesh_request_chunk_set_.Contains(chunk_id))
+					continue;
 
-				const auto loop_end_time = std::chrono::system_clock::now();
-				const auto loop_micro_sec = std::chrono::duration_cast<std::chrono::microseconds>(loop_end_time - start_time).count();
-				const auto elapsed_total_micro_sec = std::chrono::duration_cast<std::chrono::microseconds>(loop_end_time - async_start_time).count();
-				is_continue = (async_continue_limit_micro_sec >= (elapsed_total_micro_sec + loop_micro_sec));// 同じ時間がかかる次のループを含めて時間内に終わりそうなら継続.
+				chunk->Compress();
+				++compress_count;
 			}
 		}
+		else
+		{
+			compress_candidate_chunk_array_.Reset();
+		}
 
-		async_micro_sec_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - async_start_time).count();
+		AddAsyncStat(naga::VoxelEngineStat::AsyncMicroSec, CalcElapsedMicroSec(async_start_time));
 
 	}
-	// チャンクをノイズから生成
+	// チャンクをノイズから生成. LOD0のみ生成し, LODは呼び出し側でUpdateLodする.
 	void AVoxelEngine::GenerateChunkFromNoise(ChunkType& out_chunk, float default_chunk_gen_noise_scale, int noise_octave_count) const
 	{
 		// データが無ければ適当なノイズから新規生成.
@@ -798,16 +1727,24 @@ class AVoxelEngine;
 
 		// 生成時はLOD0から生成. LODMaxから作ることもできる？
 		// LOD0の生成.
+		const float voxel_size = GetVoxelSize(0);
+		float noise_row[ChunkType::CHUNK_RESOLUTION_BASE];
 		for (auto lk = 0u; lk < ChunkType::CHUNK_RESOLUTION(); ++lk)
 		{
 			for (auto lj = 0u; lj < ChunkType::CHUNK_RESOLUTION(); ++lj)
 			{
-				auto* row = out_chunk.GetXRow(lj, lk, 0);
+				// X軸Rowをビット列として構築.
+				ChunkType::RowType row = 0;
+
+				// Row先頭のセル中心ワールド座標.
+				const auto row_start_pos_world = CalcChunkVoxelCenterPosition(out_chunk.GetId(), FIntVector(0, lj, lk), 0);
+				// Row単位でまとめてノイズ計算.
+				naga::TestVoxelNoise::FbmRowX(row_start_pos_world * default_chunk_gen_noise_scale, voxel_size * default_chunk_gen_noise_scale, ChunkType::CHUNK_RESOLUTION(), noise_octave_count, noise_row);
 
 				for (auto li = 0u; li < ChunkType::CHUNK_RESOLUTION(); ++li)
 				{
 					// チャンク内セル中心ワールド座標
-					const auto cell_center_pos_world = CalcChunkVoxelCenterPosition(out_chunk.GetId(), FIntVector(li, lj, lk), 0);
+					const auto cell_center_pos_world = row_start_pos_world + FVector(voxel_size * li, 0.0f, 0.0f);
 
 					// ワールド位置から適当なノイズで初期生成.
 					auto noise = 0.0f;
@@ -820,7 +1757,7 @@ class AVoxelEngine;
 						//noise = 1.0f;
 					}
 #else
-					noise = naga::TestVoxelNoise::Fbm<false>(cell_center_pos_world * default_chunk_gen_noise_scale, noise_octave_count).X;
+					noise = noise_row[li];
 
 					const float height_base = 1000.0f;
 					const float height_rate = FMath::Max(0.0f, ((cell_center_pos_world.Z) / height_base));
@@ -840,77 +1777,142 @@ class AVoxelEngine;
 #endif
 					auto cell_value = 0.0f < noise;
 					//out_chunk.Set(0 != cell_value, li, lj, lk, 0);
-					row[li] = (cell_value)? 0xff : 0;
+					row |= (cell_value) ? (ChunkType::RowType(1) << li) : 0;
 				}
+				out_chunk.SetXRow(row, lj, lk, 0);
 			}
 		}
+	}
 
-		// Generate LOD.
-		for (auto lod = 1u; lod < ChunkType::LOD_COUNT(); ++lod)
-		{
-			const auto parent_lod = lod - 1;
-		
-			const auto reso = ChunkType::CHUNK_RESOLUTION(lod);
+	// 編集要求をチャンクのLOD0へ適用する.
+	// 形状内に中心が含まれるVoxelの範囲をRow毎に求め, Row単位のビット演算で設定する.
+	bool AVoxelEngine::ApplyVoxelEdit(ChunkType& chunk, const naga::VoxelEditRequest& request, FIntVector& inout_dirty_min, FIntVector& inout_dirty_max) const
+	{
+		const int reso = ChunkType::CHUNK_RESOLUTION();
+		const float voxel_size = GetVoxelSize(0);
+
+		// チャンクのLOD0 Voxel座標系での形状. Voxel中心が整数座標となるようにずらす.
+		const FVector local_center = (request.center - CalcChunkVoxelMinPosition(chunk.GetId(), FIntVector::ZeroValue, 0)) / voxel_size - FVector(0.5f);
+		const FVector local_extent = request.extent / voxel_size;
 
-			for (auto lk = 0u; lk < reso; ++lk)
+		const int k_begin = FMath::Max(0, FMath::CeilToInt(local_center.Z - local_extent.Z));
+		const int k_end = FMath::Min(reso - 1, FMath::FloorToInt(local_center.Z + local_extent.Z));
+		const int j_begin = FMath::Max(0, FMath::CeilToInt(local_center.Y - local_extent.Y));
+		const int j_end = FMath::Min(reso - 1, FMath::FloorToInt(local_center.Y + local_extent.Y));
+
+		bool is_changed = false;
+		for (int k = k_begin; k <= k_end; ++k)
+		{
+			for (int j = j_begin; j <= j_end; ++j)
 			{
-				for (auto lj = 0u; lj < reso; ++lj)
+				// Row上での形状のX方向の半径.
+				double half_x = local_extent.X;
+				if (naga::VoxelEditRequest::Shape::Sphere == request.shape)
 				{
-					auto* child_row = out_chunk.GetXRow(lj, lk, lod);
+					const double dy = j - local_center.Y;
+					const double dz = k - local_center.Z;
+					const double sq_half_x = local_extent.X * local_extent.X - dy * dy - dz * dz;
+					if (0.0 > sq_half_x)
+						continue;
+					half_x = FMath::Sqrt(sq_half_x);
+				}
 
-					for (auto li = 0u; li < reso; ++li)
-					{
-						const auto parent_lk_base = lk * 2;
-						const auto parent_lj_base = lj * 2;
-						const auto parent_li_base = li * 2;
-
-						auto* parent_row0 = out_chunk.GetXRow(parent_lj_base, parent_lk_base, parent_lod);
-						auto* parent_row1 = out_chunk.GetXRow(parent_lj_base+1, parent_lk_base, parent_lod);
-						auto* parent_row2 = out_chunk.GetXRow(parent_lj_base, parent_lk_base+1, parent_lod);
-						auto* parent_row3 = out_chunk.GetXRow(parent_lj_base+1, parent_lk_base+1, parent_lod);
-
-
-						const auto pv0 = parent_row0[parent_li_base];
-						const auto pv1 = parent_row0[parent_li_base + 1];
-						const auto pv2 = parent_row1[parent_li_base];
-						const auto pv3 = parent_row1[parent_li_base + 1];
-
-						const auto pv4 = parent_row2[parent_li_base];
-						const auto pv5 = parent_row2[parent_li_base + 1];
-						const auto pv6 = parent_row3[parent_li_base];
-						const auto pv7 = parent_row3[parent_li_base + 1];
-
-						// 現状のLODは上位の最大値を入れておく
-						const auto pvmax0 = FMath::Max(pv0, pv1);
-						const auto pvmax1 = FMath::Max(pv2, pv3);
-						const auto pvmax2 = FMath::Max(pv4, pv5);
-						const auto pvmax3 = FMath::Max(pv6, pv7);
-					
-						child_row[li] = FMath::Max(FMath::Max(pvmax0, pvmax1), FMath::Max(pvmax2, pvmax3));
-					}
+				const int i_begin = FMath::Max(0, FMath::CeilToInt(local_center.X - half_x));
+				const int i_end = FMath::Min(reso - 1, FMath::FloorToInt(local_center.X + half_x));
+				if (i_begin > i_end)
+					continue;
+
+				const auto mask = ((ChunkType::RowType(1) << (i_end - i_begin + 1)) - 1) << i_begin;
+				const auto prev_row = chunk.GetXRow(j, k, 0);
+				const auto new_row = (request.fill) ? (prev_row | mask) : (prev_row & ~mask);
+				if (prev_row != new_row)
+				{
+					chunk.SetXRow(new_row, j, k, 0);
+					is_changed = true;
+
+					inout_dirty_min = FIntVector(FMath::Min(inout_dirty_min.X, i_begin), FMath::Min(inout_dirty_min.Y, j), FMath::Min(inout_dirty_min.Z, k));
+					inout_dirty_max = FIntVector(FMath::Max(inout_dirty_max.X, i_end), FMath::Max(inout_dirty_max.Y, j), FMath::Max(inout_dirty_max.Z, k));
 				}
 			}
 		}
-
+		return is_changed;
 	}
 
 	void AVoxelEngine::UpdateRenderChunk(const TArray<FIntVector>& render_dirty_chunk_id_array)
 	{
 #if 1
-		UpdateRenderChunkSurfaceNets_NaiveVoxel(render_dirty_chunk_id_array);
+		UploadCompletedChunkMesh();
+		UploadCompletedChunkCollision();
 #else
 		UpdateRenderChunkDebugCube(render_dirty_chunk_id_array);
 #endif
-		//UpdateRenderChunkSurfaceNets_BitCompressionVoxel(render_dirty_chunk_id_array);
 	}
-	void AVoxelEngine::UpdateRenderChunkSurfaceNets_NaiveVoxel(const TArray<FIntVector>& render_dirty_chunk_id_array)
+	// チャンクのメッシュ生成. Asyncから呼び出されるためチャンク以外の状態は変更しない.
+	// チャンクのカレントLODで生成し, LODの異なる近傍チャンクと接する面にはスカートを生成する. スカートはブロック形状でも生成する.
+	void AVoxelEngine::BuildChunkMesh(const ChunkType& chunk, naga::VoxelChunkMeshData& out_mesh) const
 	{
-		constexpr auto chunk_cell_pos_max = ChunkType::CHUNK_RESOLUTION() - 1;
+		const auto lod_level = chunk.GetCurrentLodLevel();
 
-		// 描画更新要求チャンクの隣接チャンクを含めたリストを構築する.
-		for (auto&& e : render_dirty_chunk_id_array)
+		// LODの異なる近傍チャンクと接する面.
+		uint32 skirt_face_mask = 0;
+		unsigned int skirt_lod_level = lod_level;
+		for (int face = 0; face < naga::VoxelChunkFace::Count; ++face)
 		{
-			auto&& find_chunk_ptr = voxel_chunk_map_.Find(e);
+			auto&& neighbor_chunk_ptr = voxel_chunk_map_.Find(chunk.GetId() + k_chunk_face_dir[face]);
+			if (!neighbor_chunk_ptr || !*neighbor_chunk_ptr)
+				continue;
+			if (naga::VoxelChunkState::Active != (*neighbor_chunk_ptr)->GetState())
+				continue;
+
+			const auto neighbor_lod_level = (*neighbor_chunk_ptr)->GetCurrentLodLevel();
+			if (lod_level != neighbor_lod_level)
+			{
+				skirt_face_mask |= naga::VoxelChunkFace::Bit(static_cast<naga::VoxelChunkFace::Type>(face));
+				skirt_lod_level = FMath::Max(skirt_lod_level, neighbor_lod_level);
+			}
+		}
+		// スカートは粗い側のVoxelサイズ分垂らす.
+		const float skirt_length = GetVoxelSize(skirt_lod_level);
+
+		if (use_greedy_mesh_)
+		{
+			BuildChunkMeshGreedy_BitCompressionVoxel(chunk, lod_level, out_mesh);
+		}
+		else
+		{
+#if 1
+			BuildChunkMeshSurfaceNets_BitCompressionVoxel(chunk, lod_level, out_mesh);
+#else
+			BuildChunkMeshSurfaceNets_NaiveVoxel(chunk, lod_level, out_mesh);
+#endif
+		}
+		if (0 != skirt_face_mask)
+		{
+			BuildChunkMeshSkirt(chunk, lod_level, skirt_face_mask, skirt_length, use_greedy_mesh_, out_mesh);
+		}
+	}
+	// コリジョン用メッシュ生成. Asyncから呼び出されるためチャンク以外の状態は変更しない.
+	// 描画のLODとは独立にcollision_lod_level_で生成する. 物理範囲内のみが対象のため, スカートは生成しない.
+	void AVoxelEngine::BuildChunkCollisionMesh(const ChunkType& chunk, naga::VoxelChunkMeshData& out_mesh) const
+	{
+		const auto lod_level = FMath::Min(static_cast<unsigned int>(FMath::Max(0, collision_lod_level_)), ChunkType::LOD_COUNT() - 1);
+
+		if (use_greedy_mesh_)
+			BuildChunkMeshGreedy_BitCompressionVoxel(chunk, lod_level, out_mesh);
+		else
+			BuildChunkMeshSurfaceNets_BitCompressionVoxel(chunk, lod_level, out_mesh);
+	}
+	// Asyncで生成済みのメッシュを反映する.
+	void AVoxelEngine::UploadCompletedChunkMesh()
+	{
+		SCOPE_CYCLE_COUNTER(STAT_VoxelEngine_UploadMesh);
+		const auto upload_start_time = std::chrono::system_clock::now();
+		int upload_count = 0;
+
+		for (auto&& e : mesh_complete_array_[0])
+		{
+			// 生成後にStreamOutされたチャンクはスキップ.
+			auto&& find_chunk_ptr = voxel_chunk_map_.Find(e.chunk_id);
 			if (!find_chunk_ptr)
 				continue;
 
@@ -920,476 +1922,1613 @@ class AVoxelEngine;
 			if (naga::VoxelChunkState::Active != find_chunk->GetState())
 				continue;
 
-			UProceduralMeshComponent* mesh_comp = nullptr;
-			if (auto&& chunk_mesh = chunk_proc_mesh_component_map_.Find(e))
+			UploadChunkMesh(e.chunk_id, e.mesh);
+			++upload_count;
+
+			// ベンチマーク中はStreamIn要求からの遅延を記録.
+			if (stream_benchmark_.is_running)
 			{
-				mesh_comp = *chunk_mesh;
+				double request_sec = 0.0;
+				if (stream_benchmark_.request_sec_map.RemoveAndCopyValue(e.chunk_id, request_sec))
+					stream_benchmark_.ready_latency_ms.Add((FPlatformTime::Seconds() - request_sec) * 1000.0);
 			}
+		}
 
-			if (!mesh_comp)
+		frame_stats_[naga::VoxelEngineStat::MeshUploadCount] = upload_count;
+		frame_stats_[naga::VoxelEngineStat::MeshUploadMicroSec] = CalcElapsedMicroSec(upload_start_time);
+	}
+
+	// チャンクの可視判定. Asyncの停止中に呼び出す.
+	// 視点チャンクから面で隣接するチャンクを視点から離れる方向へのみ辿り, 視錐台と交差するものを可視とする.
+	// 中身の詰まったチャンクは表面のみ可視としてその先へは辿らないため, 地中や閉じた空洞のチャンクは不可視となる.
+	// 空のチャンクはメッシュが無いため辿るのみ. 未ロードのチャンクは遮蔽しないものとして扱う.
+	void AVoxelEngine::UpdateChunkVisibility()
+	{
+		is_visibility_culling_ = use_visibility_culling_ && visibility_view_.is_valid;
+		visible_chunk_set_.Reset();
+
+		if (is_visibility_culling_)
+		{
+			const float chunk_size = voxel_size_ * ChunkType::CHUNK_RESOLUTION();
+			const FVector chunk_half_extent(chunk_size * 0.5f);
+			const FIntVector view_chunk = naga::math::FVectorFloorToInt(visibility_view_.location / chunk_size);
+			const FConvexVolume frustum = BuildViewFrustum(visibility_view_.location, visibility_view_.rotation, visibility_view_.fov_degree, visibility_view_.aspect_ratio);
+			// ロードされ得る範囲のみ辿る.
+			const int range = FMath::Max3(stream_out_chunk_range, stream_in_chunk_range_horizontal, stream_in_chunk_range_vertical);
+
+			TArray<FIntVector> open_array;
+			visible_chunk_set_.Add(view_chunk);
+			open_array.Add(view_chunk);
+			for (int open_index = 0; open_index < open_array.Num(); ++open_index)
 			{
-				// なければ生成
+				const auto chunk_id = open_array[open_index];
+				if (view_chunk != chunk_id)
+				{
+					auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
+					if (chunk_ptr && *chunk_ptr && naga::VoxelChunkState::Active == (*chunk_ptr)->GetState() && naga::VoxelChunkFillState::Solid == (*chunk_ptr)->GetFillState())
+						continue;
+				}
 
-				mesh_comp = NewObject<UProceduralMeshComponent>(this);
-				mesh_comp->RegisterComponent();
-				mesh_comp->SetFlags(RF_Transactional);
-				mesh_comp->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+				for (const auto& face_dir : k_chunk_face_dir)
+				{
+					// 視点チャンクから離れる方向のみ.
+					const auto next_offset = chunk_id + face_dir - view_chunk;
+					if (0 >= next_offset.X * face_dir.X + next_offset.Y * face_dir.Y + next_offset.Z * face_dir.Z)
+						continue;
+					if (range < FMath::Max3(FMath::Abs(next_offset.X), FMath::Abs(next_offset.Y), FMath::Abs(next_offset.Z)))
+						continue;
+
+					const auto next_chunk_id = chunk_id + face_dir;
+					if (visible_chunk_set_.Contains(next_chunk_id))
+						continue;
+					if (!frustum.IntersectBox(FVector(next_chunk_id) * chunk_size + chunk_half_extent, chunk_half_extent))
+						continue;
+
+					visible_chunk_set_.Add(next_chunk_id);
+					open_array.Add(next_chunk_id);
+				}
+			}
+		}
 
-				// シャドウ無効
-				mesh_comp->SetCastShadow(false);
-				mesh_comp->bCastDynamicShadow = false;
+		// コンポーネントの表示切替.
+		for (auto&& it : chunk_proc_mesh_component_map_)
+		{
+			if (it.Value)
+				it.Value->SetVisibility(IsChunkVisible(it.Key));
+		}
 
-				mesh_comp->SetMaterial(0, material_);
+		// 可視になった保留チャンクをメッシュ生成要求へ戻す. 末尾から処理されるため優先される.
+		for (auto it = mesh_deferred_chunk_set_.CreateIterator(); it; ++it)
+		{
+			if (!voxel_chunk_map_.Contains(*it))
+			{
+				// StreamOut済み.
+				it.RemoveCurrent();
+			}
+			else if (IsChunkVisible(*it))
+			{
+				AddMeshRequest(*it);
+				it.RemoveCurrent();
+			}
+		}
+		// 不可視チャンクのメッシュ生成は保留. 保留中は圧縮の対象とする.
+		mesh_request_chunk_array_.RemoveAll([this](const FIntVector& e)
+			{
+				if (IsChunkVisible(e))
+					return false;
+				mesh_deferred_chunk_set_.Add(e);
+				mesh_request_chunk_set_.Remove(e);
+				compress_candidate_chunk_array_.Add(e);
+				return true;
+			});
+	}
 
-				if (chunk_proc_mesh_component_map_.Contains(e))
-					chunk_proc_mesh_component_map_[e] = mesh_comp;
-				else
-					chunk_proc_mesh_component_map_.Add(e, mesh_comp);
-			}
-
-			// クリア
-			if (0 < mesh_comp->GetNumSections())
-				mesh_comp->ClearMeshSection(0);
-
-			if (true)
-			{
-				bool bCreateCollision = true;
-				TArray<FVector> vtx;
-				TArray<int32> tri;
-				TArray<FVector> nor;
-				TArray<FVector2D> uv0;
-				TArray<FColor> col;
-				TArray<FProcMeshTangent> tan;
-#
-				// SurfaceNets.
-				// 元のVoxelを頂点とするようなSurfaceVoxelを考え、構成するエッジに境界があるかテストする.
-				// 表示LODレベル
-				//const auto lod_level = find_chunk->GetCurrentLodLevel();
-				const auto lod_level = 0;// 簡単のためLOD0固定
-			
-				const float lod_voxel_size = 1.0f * static_cast<float>(1 << lod_level);
-				const auto chunk_reso = ChunkType::CHUNK_RESOLUTION(lod_level);
-				const auto voxel_extent = GetVoxelSize(lod_level);
-
-
-				for (auto k = 0u; k < chunk_reso; ++k)
-				{
-					for (auto j = 0u; j < chunk_reso; ++j)
-					{
-						// SurfaceNetsの頂点計算のために必要な追加の近傍
-						const auto row_y0z0 = find_chunk->GetXRowWithOverlap(j, k, lod_level);
-						const auto row_y0z1 = find_chunk->GetXRowWithOverlap(j, k + 1, lod_level);
-						const auto row_y0z2 = find_chunk->GetXRowWithOverlap(j, k + 2, lod_level);
+	// Asyncで生成済みのコリジョン用メッシュを反映する.
+	void AVoxelEngine::UploadCompletedChunkCollision()
+	{
+		// 物理範囲外へ出たチャンクのコリジョンを破棄.
+		for (auto it = chunk_collision_component_map_.CreateIterator(); it; ++it)
+		{
+			if (collision_chunk_set_.Contains(it.Key()))
+				continue;
+			if (it.Value())
+				it.Value()->DestroyComponent();
+			it.RemoveCurrent();
+		}
 
-						const auto row_y1z0 = find_chunk->GetXRowWithOverlap(j + 1, k, lod_level);
-						const auto row_y1z1 = find_chunk->GetXRowWithOverlap(j + 1, k + 1, lod_level);
-						const auto row_y1z2 = find_chunk->GetXRowWithOverlap(j + 1, k + 2, lod_level);
+		int upload_count = 0;
+		for (auto&& e : collision_complete_array_[0])
+		{
+			// 生成後にStreamOutまたは物理範囲外となったチャンクはスキップ.
+			if (!collision_chunk_set_.Contains(e.chunk_id))
+				continue;
+			auto&& find_chunk_ptr = voxel_chunk_map_.Find(e.chunk_id);
+			if (!find_chunk_ptr || !*find_chunk_ptr || naga::VoxelChunkState::Active != (*find_chunk_ptr)->GetState())
+				continue;
 
-						const auto row_y2z0 = find_chunk->GetXRowWithOverlap(j + 2, k, lod_level);
-						const auto row_y2z1 = find_chunk->GetXRowWithOverlap(j + 2, k + 1, lod_level);
-						const auto row_y2z2 = find_chunk->GetXRowWithOverlap(j + 2, k + 2, lod_level);
+			UploadChunkCollision(e.chunk_id, e.mesh);
+			++upload_count;
+		}
+		frame_stats_[naga::VoxelEngineStat::CollisionUploadCount] = upload_count;
+	}
 
-						uint32_t x_row_x0y1z0 = 0;
-						uint32_t x_row_x0y0z1 = 0;
-						uint32_t x_row_x0y1z1 = 0;
+	// 処理統計をUE Stats(stat VoxelEngine)とCSVプロファイラへ出力し, ベンチマーク中は集計する.
+	void AVoxelEngine::PublishFrameStats()
+	{
+		const auto& stats = frame_stats_;
+		const auto func_ms = [&stats](naga::VoxelEngineStat::Type type) { return static_cast<float>(stats[type]) * 0.001f; };
+
+		SET_DWORD_STAT(STAT_VoxelEngine_StreamInCount, stats[naga::VoxelEngineStat::StreamInCount]);
+		SET_DWORD_STAT(STAT_VoxelEngine_StoreLoadCount, stats[naga::VoxelEngineStat::StoreLoadCount]);
+		SET_DWORD_STAT(STAT_VoxelEngine_StreamOutCount, stats[naga::VoxelEngineStat::StreamOutCount]);
+		SET_DWORD_STAT(STAT_VoxelEngine_EditChunkCount, stats[naga::VoxelEngineStat::EditChunkCount]);
+		SET_DWORD_STAT(STAT_VoxelEngine_MeshCount, stats[naga::VoxelEngineStat::MeshCount]);
+		SET_DWORD_STAT(STAT_VoxelEngine_MeshUploadCount, stats[naga::VoxelEngineStat::MeshUploadCount]);
+		SET_DWORD_STAT(STAT_VoxelEngine_CollisionCount, stats[naga::VoxelEngineStat::CollisionCount]);
+		SET_DWORD_STAT(STAT_VoxelEngine_CollisionUploadCount, stats[naga::VoxelEngineStat::CollisionUploadCount]);
+		SET_FLOAT_STAT(STAT_VoxelEngine_NoiseMs, func_ms(naga::VoxelEngineStat::NoiseMicroSec));
+		SET_FLOAT_STAT(STAT_VoxelEngine_StoreLoadMs, func_ms(naga::VoxelEngineStat::StoreLoadMicroSec));
+		SET_FLOAT_STAT(STAT_VoxelEngine_LodMs, func_ms(naga::VoxelEngineStat::LodMicroSec));
+		SET_FLOAT_STAT(STAT_VoxelEngine_MeshingMs, func_ms(naga::VoxelEngineStat::MeshingMicroSec));
+		SET_FLOAT_STAT(STAT_VoxelEngine_CollisionMs, func_ms(naga::VoxelEngineStat::CollisionMicroSec));
+		SET_FLOAT_STAT(STAT_VoxelEngine_AsyncMs, func_ms(naga::VoxelEngineStat::AsyncMicroSec));
+		SET_FLOAT_STAT(STAT_VoxelEngine_OverlapSyncMs, func_ms(naga::VoxelEngineStat::OverlapSyncMicroSec));
+		SET_FLOAT_STAT(STAT_VoxelEngine_MeshUploadMs, func_ms(naga::VoxelEngineStat::MeshUploadMicroSec));
+		SET_DWORD_STAT(STAT_VoxelEngine_StreamInQueueNum, stats[naga::VoxelEngineStat::StreamInQueueNum]);
+		SET_DWORD_STAT(STAT_VoxelEngine_StreamOutQueueNum, stats[naga::VoxelEngineStat::StreamOutQueueNum]);
+		SET_DWORD_STAT(STAT_VoxelEngine_MeshRequestNum, stats[naga::VoxelEngineStat::MeshRequestNum]);
+		SET_DWORD_STAT(STAT_VoxelEngine_CollisionRequestNum, stats[naga::VoxelEngineStat::CollisionRequestNum]);
+		SET_DWORD_STAT(STAT_VoxelEngine_VisibleChunkNum, stats[naga::VoxelEngineStat::VisibleChunkNum]);
+		SET_DWORD_STAT(STAT_VoxelEngine_MeshDeferredNum, stats[naga::VoxelEngineStat::MeshDeferredNum]);
+		SET_DWORD_STAT(STAT_VoxelEngine_RayCastCount, stats[naga::VoxelEngineStat::RayCastCount]);
+		SET_FLOAT_STAT(STAT_VoxelEngine_RayCastMs, func_ms(naga::VoxelEngineStat::RayCastMicroSec));
+
+		CSV_CUSTOM_STAT(VoxelEngine, StreamInCount, static_cast<int32>(stats[naga::VoxelEngineStat::StreamInCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, StoreLoadCount, static_cast<int32>(stats[naga::VoxelEngineStat::StoreLoadCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, StreamOutCount, static_cast<int32>(stats[naga::VoxelEngineStat::StreamOutCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, EditChunkCount, static_cast<int32>(stats[naga::VoxelEngineStat::EditChunkCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, MeshCount, static_cast<int32>(stats[naga::VoxelEngineStat::MeshCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, MeshUploadCount, static_cast<int32>(stats[naga::VoxelEngineStat::MeshUploadCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, CollisionCount, static_cast<int32>(stats[naga::VoxelEngineStat::CollisionCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, CollisionUploadCount, static_cast<int32>(stats[naga::VoxelEngineStat::CollisionUploadCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, NoiseMs, func_ms(naga::VoxelEngineStat::NoiseMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, StoreLoadMs, func_ms(naga::VoxelEngineStat::StoreLoadMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, LodMs, func_ms(naga::VoxelEngineStat::LodMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, MeshingMs, func_ms(naga::VoxelEngineStat::MeshingMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, CollisionMs, func_ms(naga::VoxelEngineStat::CollisionMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, AsyncMs, func_ms(naga::VoxelEngineStat::AsyncMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, OverlapSyncMs, func_ms(naga::VoxelEngineStat::OverlapSyncMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, MeshUploadMs, func_ms(naga::VoxelEngineStat::MeshUploadMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, SyncMs, func_ms(naga::VoxelEngineStat::SyncMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, TickMs, func_ms(naga::VoxelEngineStat::TickMicroSec), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, StreamInQueue, static_cast<int32>(stats[naga::VoxelEngineStat::StreamInQueueNum]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, StreamOutQueue, static_cast<int32>(stats[naga::VoxelEngineStat::StreamOutQueueNum]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, MeshRequestQueue, static_cast<int32>(stats[naga::VoxelEngineStat::MeshRequestNum]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, CollisionRequestQueue, static_cast<int32>(stats[naga::VoxelEngineStat::CollisionRequestNum]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, VisibleChunk, static_cast<int32>(stats[naga::VoxelEngineStat::VisibleChunkNum]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, MeshDeferredChunk, static_cast<int32>(stats[naga::VoxelEngineStat::MeshDeferredNum]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, RayCastCount, static_cast<int32>(stats[naga::VoxelEngineStat::RayCastCount]), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(VoxelEngine, RayCastMs, func_ms(naga::VoxelEngineStat::RayCastMicroSec), ECsvCustomStatOp::Set);
+
+		if (stream_benchmark_.is_running)
+		{
+			for (int i = 0; i < naga::VoxelEngineStat::Count; ++i)
+			{
+				stream_benchmark_.stat_sum[i] += stats[i];
+			}
+		}
+	}
+	// 生成済みメッシュをProceduralMeshComponentへ設定する.
+	void AVoxelEngine::UploadChunkMesh(const FIntVector& chunk_id, const naga::VoxelChunkMeshData& mesh_data)
+	{
+		UProceduralMeshComponent* mesh_comp = nullptr;
+		if (auto&& chunk_mesh = chunk_proc_mesh_component_map_.Find(chunk_id))
+		{
+			mesh_comp = *chunk_mesh;
+		}
 
-						for (auto ri = 0u; ri < ChunkType::CHUNK_RESOLUTION_WITH_OVERLAP(lod_level); ++ri)
-						{
-							x_row_x0y1z0 |= (row_y1z0[ri]) ? (0x01 << (ri)) : 0;
-							x_row_x0y0z1 |= (row_y0z1[ri]) ? (0x01 << (ri)) : 0;
-							x_row_x0y1z1 |= (row_y1z1[ri]) ? (0x01 << (ri)) : 0;
-						}
+		if (!mesh_comp)
+		{
+			// なければ生成
 
-						const auto shift_count_top = (chunk_reso - 1);
-						// X方向に-1シフトして+X隣接チャンクの情報を最上位に埋め込む.
-						uint32_t shifted_x0y1z0_row = x_row_x0y1z0 >> 1;//
-						uint32_t shifted_x0y1z1_row = x_row_x0y1z1 >> 1;//
-						uint32_t shifted_x0y0z1_row = x_row_x0y0z1 >> 1;//
+			mesh_comp = NewObject<UProceduralMeshComponent>(this);
+			mesh_comp->RegisterComponent();
+			mesh_comp->SetFlags(RF_Transactional);
+			// コリジョンはUploadChunkCollisionで別コンポーネントに設定する.
+			mesh_comp->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 
+			// シャドウ無効
+			mesh_comp->SetCastShadow(false);
+			mesh_comp->bCastDynamicShadow = false;
 
-						// XY 3x3の中心のZ差分
-						uint32_t z_dif_center = (shifted_x0y1z0_row) ^ (shifted_x0y1z1_row);
-						// YZ 3X3の中心のX差分
-						uint32_t x_dif_center = (x_row_x0y1z1) ^ (shifted_x0y1z1_row);
-						// ZX 3x3の中心のY差分
-						uint32_t y_dif_center = (shifted_x0y0z1_row) ^ (shifted_x0y1z1_row);
+			mesh_comp->SetMaterial(0, material_);
+			mesh_comp->SetVisibility(IsChunkVisible(chunk_id));
 
-						for (auto i = 0u; i < chunk_reso; ++i)
-						{
-							// Z差分
-							const bool has_z_diff = (z_dif_center & (1 << (i)));
-							// X差分
-							const bool has_x_diff = (x_dif_center & (1 << (i)));
-							// Y差分
-							const bool has_y_diff = (y_dif_center & (1 << (i)));
-
-							if (!has_x_diff && !has_y_diff && !has_z_diff)
-								continue;
+			if (chunk_proc_mesh_component_map_.Contains(chunk_id))
+				chunk_proc_mesh_component_map_[chunk_id] = mesh_comp;
+			else
+				chunk_proc_mesh_component_map_.Add(chunk_id, mesh_comp);
+		}
 
-							// return : SurfaceNetsのSurfacePoint位置を[0,1]の割合で返す.
-							// voxel_sdf_values : 8点のsdf値を xyzの順で優先した配列. (x0y0z0,x1y0z0,x0y1z0,x1y1z0...).
-							const auto func_gen_surface_point = [](float (&voxel_sdf_values)[8])
-							{
-								FVector pos_rate = FVector::ZeroVector;
+		// クリア
+		if (0 < mesh_comp->GetNumSections())
+			mesh_comp->ClearMeshSection(0);
 
-								float rate_div_work = 0.0f;
-								for (auto i = 0u; i < 4; i += 1)
-								{
-									const auto i0 = i * 2;
-									const auto i1 = i0 + 1;
-									if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
-									{
-										float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
-										pos_rate += FVector(rate, (i0 >> 1) & 0b01, (i0 >> 2) & 0b01);
-									
-										rate_div_work += 1.0f;
-									}
-								}
-							
-								for (auto i = 0u; i < 4; i += 1)
-								{
-									const auto i0 = (i & 0b01) + ((i>>1) & 0b01) * 4;
-									const auto i1 = i0 + 2;
-									if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
-									{
-										float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
-										pos_rate += FVector(i0 & 0b01, rate, (i0 >> 2) & 0b01);
+		if (0 < mesh_data.tri.Num())
+		{
+			bool bCreateCollision = false;
+			TArray<FVector2D> uv0;
+			TArray<FProcMeshTangent> tan;
+			mesh_comp->CreateMeshSection(0, mesh_data.vtx, mesh_data.tri, mesh_data.nor, uv0, mesh_data.col, tan, bCreateCollision);
+		}
+	}
+	// コリジョン用メッシュを非表示のProceduralMeshComponentへ設定する.
+	void AVoxelEngine::UploadChunkCollision(const FIntVector& chunk_id, const naga::VoxelChunkMeshData& mesh_data)
+	{
+		UProceduralMeshComponent* collision_comp = nullptr;
+		if (auto&& chunk_collision = chunk_collision_component_map_.Find(chunk_id))
+		{
+			collision_comp = *chunk_collision;
+		}
 
-										rate_div_work += 1.0f;
-									}
-								}
+		if (!collision_comp)
+		{
+			collision_comp = NewObject<UProceduralMeshComponent>(this);
+			// クッキングをバックグラウンドで実行し, 完了までは以前のコリジョンを使用する.
+			collision_comp->bUseAsyncCooking = true;
+			collision_comp->RegisterComponent();
+			collision_comp->SetFlags(RF_Transactional);
+			collision_comp->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+			collision_comp->SetVisibility(false);
+			collision_comp->SetCastShadow(false);
+
+			chunk_collision_component_map_.Add(chunk_id, collision_comp);
+		}
 
-								for (auto i = 0u; i < 4; i += 1)
-								{
-									const auto i0 = i;
-									const auto i1 = i0 + 4;
-									if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
-									{
-										float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
-										pos_rate += FVector(i0 & 0b01, (i0 >> 1) & 0b01, rate);
+		// 事前にクリアすると空のコリジョンのクッキングが挟まるため, 上書きのみとする.
+		if (0 < mesh_data.tri.Num())
+		{
+			bool bCreateCollision = true;
+			TArray<FVector> nor;
+			TArray<FVector2D> uv0;
+			TArray<FColor> col;
+			TArray<FProcMeshTangent> tan;
+			collision_comp->CreateMeshSection(0, mesh_data.vtx, mesh_data.tri, nor, uv0, col, tan, bCreateCollision);
+		}
+		else if (0 < collision_comp->GetNumSections())
+		{
+			collision_comp->ClearMeshSection(0);
+		}
+	}
 
-										rate_div_work += 1.0f;
-									}
-								}
+	// SurfaceNetsによるポリゴン生成. 検証用の素朴な実装.
+	// 元のVoxelを頂点とするようなSurfaceVoxelを考え、構成するエッジに境界があるかテストする.
+	void AVoxelEngine::BuildChunkMeshSurfaceNets_NaiveVoxel(const ChunkType& chunk, unsigned int lod_level, naga::VoxelChunkMeshData& out_mesh) const
+	{
+		const auto chunk_id = chunk.GetId();
+		const float lod_voxel_size = 1.0f * static_cast<float>(1 << lod_level);
+		const auto chunk_reso = ChunkType::CHUNK_RESOLUTION(lod_level);
+		const auto voxel_extent = GetVoxelSize(lod_level);
 
-								if (0.0f < rate_div_work)
-									pos_rate /= rate_div_work;
-
-								return pos_rate;
-							};
-
-
-							float local_voxel_sdf[8];
-							local_voxel_sdf[0] = (0 != row_y0z0[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[1] = (0 != row_y0z0[i+1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[2] = (0 != row_y1z0[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[3] = (0 != row_y1z0[i+1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[4] = (0 != row_y0z1[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[5] = (0 != row_y0z1[i+1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[6] = (0 != row_y1z1[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[7] = (0 != row_y1z1[i+1]) ? -1.0f : 1.0f;
-							const auto surface_pos_0 = func_gen_surface_point(local_voxel_sdf);
-
-							local_voxel_sdf[0] = (0 != row_y0z0[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[1] = (0 != row_y0z0[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[2] = (0 != row_y1z0[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[3] = (0 != row_y1z0[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[4] = (0 != row_y0z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[5] = (0 != row_y0z1[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[6] = (0 != row_y1z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[7] = (0 != row_y1z1[i + 2]) ? -1.0f : 1.0f;
-							const auto surface_pos_1 = func_gen_surface_point(local_voxel_sdf);
-
-							local_voxel_sdf[0] = (0 != row_y1z0[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[1] = (0 != row_y1z0[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[2] = (0 != row_y2z0[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[3] = (0 != row_y2z0[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[4] = (0 != row_y1z1[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[5] = (0 != row_y1z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[6] = (0 != row_y2z1[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[7] = (0 != row_y2z1[i + 1]) ? -1.0f : 1.0f;
-							const auto surface_pos_2 = func_gen_surface_point(local_voxel_sdf);
-
-							local_voxel_sdf[0] = (0 != row_y1z0[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[1] = (0 != row_y1z0[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[2] = (0 != row_y2z0[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[3] = (0 != row_y2z0[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[4] = (0 != row_y1z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[5] = (0 != row_y1z1[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[6] = (0 != row_y2z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[7] = (0 != row_y2z1[i + 2]) ? -1.0f : 1.0f;
-							const auto surface_pos_3 = func_gen_surface_point(local_voxel_sdf);
-
-							local_voxel_sdf[0] = (0 != row_y0z1[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[1] = (0 != row_y0z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[2] = (0 != row_y1z1[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[3] = (0 != row_y1z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[4] = (0 != row_y0z2[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[5] = (0 != row_y0z2[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[6] = (0 != row_y1z2[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[7] = (0 != row_y1z2[i + 1]) ? -1.0f : 1.0f;
-							const auto surface_pos_4 = func_gen_surface_point(local_voxel_sdf);
-
-							local_voxel_sdf[0] = (0 != row_y0z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[1] = (0 != row_y0z1[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[2] = (0 != row_y1z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[3] = (0 != row_y1z1[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[4] = (0 != row_y0z2[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[5] = (0 != row_y0z2[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[6] = (0 != row_y1z2[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[7] = (0 != row_y1z2[i + 2]) ? -1.0f : 1.0f;
-							const auto surface_pos_5 = func_gen_surface_point(local_voxel_sdf);
-
-							local_voxel_sdf[0] = (0 != row_y1z1[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[1] = (0 != row_y1z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[2] = (0 != row_y2z1[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[3] = (0 != row_y2z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[4] = (0 != row_y1z2[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[5] = (0 != row_y1z2[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[6] = (0 != row_y2z2[i]) ? -1.0f : 1.0f;
-							local_voxel_sdf[7] = (0 != row_y2z2[i + 1]) ? -1.0f : 1.0f;
-							const auto surface_pos_6 = func_gen_surface_point(local_voxel_sdf);
-
-							local_voxel_sdf[0] = (0 != row_y1z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[1] = (0 != row_y1z1[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[2] = (0 != row_y2z1[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[3] = (0 != row_y2z1[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[4] = (0 != row_y1z2[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[5] = (0 != row_y1z2[i + 2]) ? -1.0f : 1.0f;
-							local_voxel_sdf[6] = (0 != row_y2z2[i + 1]) ? -1.0f : 1.0f;
-							local_voxel_sdf[7] = (0 != row_y2z2[i + 2]) ? -1.0f : 1.0f;
-							const auto surface_pos_7 = func_gen_surface_point(local_voxel_sdf);
-
-
-
-							// 3x3近傍の中心でZの方向の境界があるか
-							if (has_z_diff)
-							{
-								// 正の方向を向いているか
-								const bool face_to_positive = 0 < (shifted_x0y1z0_row & (1 << (i)));
-
-								// 共有頂点は無視して独立して頂点生成してみる
-								// 頂点の値を無視して常にセル中心にサーフェイス頂点生成
-								auto pos0 = surface_pos_0 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i, j, k), lod_level);
-								auto pos1 = surface_pos_1 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i + 1, j, k), lod_level);
-								auto pos2 = surface_pos_2 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i, j + 1, k), lod_level);
-								auto pos3 = surface_pos_3 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i + 1, j + 1, k), lod_level);
-
-								// 時計回り
-								const auto vtx_id0 = vtx.Add(pos0);
-								const auto vtx_id1 = vtx.Add(pos1);
-								const auto vtx_id2 = vtx.Add(pos3);
-								const auto vtx_id3 = vtx.Add(pos2);
-
-								// 法線を計算
-								FVector face_normal =  FVector::CrossProduct(pos1 - pos0, pos2 - pos0);
-								if (!face_normal.IsNearlyZero())
-								{
-									face_normal.Normalize();
-								}
-								else
-								{
-									face_normal = FVector::CrossProduct(pos2 - pos3, pos1 - pos3);
-									face_normal.Normalize();
-								}
-								if (!face_to_positive)
-									face_normal = -face_normal;
-								for (auto nrm_i = 0u; nrm_i < 4; ++nrm_i)
-									nor.Add(face_normal);
+		// SurfaceVoxelの基準位置はオーバーラップ込の座標なので, チャンク内のVoxel座標へ変換するためのオフセット.
+		const FIntVector cell_offset(-1, -1, -1);
 
-								// カラー
-								for (auto col_i = 0u; col_i < 4; ++col_i)
-								{
-									if ((chunk_reso - 1) == i)
-										col.Add(FLinearColor(1.0f, 0.0f, 0.0f, 1.0f).ToFColor(true));
-									else if ((chunk_reso - 1) == j)
-										col.Add(FLinearColor(0.0f, 1.0f, 0.0f, 1.0f).ToFColor(true));
-									else if ((chunk_reso - 1) == k)
-										col.Add(FLinearColor(0.0f, 0.0f, 1.0f, 1.0f).ToFColor(true));
-									else if (0 == i)
-										col.Add(FLinearColor(0.25f, 0.0f, 0.0f, 1.0f).ToFColor(true));
-									else if (0 == j)
-										col.Add(FLinearColor(0.0f, 0.25f, 0.0f, 1.0f).ToFColor(true));
-									else if (0 == k)
-										col.Add(FLinearColor(0.0f, 0.0f, 0.25f, 1.0f).ToFColor(true));
-									else
-										col.Add(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f).ToFColor(true));
-								}
+		for (auto k = 0u; k < chunk_reso; ++k)
+		{
+			for (auto j = 0u; j < chunk_reso; ++j)
+			{
+				// SurfaceNetsの頂点計算のために必要な追加の近傍
+				const auto row_y0z0 = chunk.GetXRowWithOverlap(j, k, lod_level);
+				const auto row_y0z1 = chunk.GetXRowWithOverlap(j, k + 1, lod_level);
+				const auto row_y0z2 = chunk.GetXRowWithOverlap(j, k + 2, lod_level);
+
+				const auto row_y1z0 = chunk.GetXRowWithOverlap(j + 1, k, lod_level);
+				const auto row_y1z1 = chunk.GetXRowWithOverlap(j + 1, k + 1, lod_level);
+				const auto row_y1z2 = chunk.GetXRowWithOverlap(j + 1, k + 2, lod_level);
+
+				const auto row_y2z0 = chunk.GetXRowWithOverlap(j + 2, k, lod_level);
+				const auto row_y2z1 = chunk.GetXRowWithOverlap(j + 2, k + 1, lod_level);
+				const auto row_y2z2 = chunk.GetXRowWithOverlap(j + 2, k + 2, lod_level);
+
+				// 1bitVoxelのRowはオーバーラップ込のビット列なのでそのまま利用する.
+				const uint32_t x_row_x0y1z0 = static_cast<uint32_t>(row_y1z0);
+				const uint32_t x_row_x0y0z1 = static_cast<uint32_t>(row_y0z1);
+				const uint32_t x_row_x0y1z1 = static_cast<uint32_t>(row_y1z1);
+
+				const auto shift_count_top = (chunk_reso - 1);
+				// X方向に-1シフトして+X隣接チャンクの情報を最上位に埋め込む.
+				uint32_t shifted_x0y1z0_row = x_row_x0y1z0 >> 1;//
+				uint32_t shifted_x0y1z1_row = x_row_x0y1z1 >> 1;//
+				uint32_t shifted_x0y0z1_row = x_row_x0y0z1 >> 1;//
+
+
+				// XY 3x3の中心のZ差分
+				uint32_t z_dif_center = (shifted_x0y1z0_row) ^ (shifted_x0y1z1_row);
+				// YZ 3X3の中心のX差分
+				uint32_t x_dif_center = (x_row_x0y1z1) ^ (shifted_x0y1z1_row);
+				// ZX 3x3の中心のY差分
+				uint32_t y_dif_center = (shifted_x0y0z1_row) ^ (shifted_x0y1z1_row);
 
-								// インデックス
-								if (face_to_positive)
-								{
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id1);
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id3);
-									tri.Add(vtx_id2);
-								}
-								else
-								{
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id1);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id3);
-								}
+				for (auto i = 0u; i < chunk_reso; ++i)
+				{
+					// Z差分
+					const bool has_z_diff = (z_dif_center & (1 << (i)));
+					// X差分
+					const bool has_x_diff = (x_dif_center & (1 << (i)));
+					// Y差分
+					const bool has_y_diff = (y_dif_center & (1 << (i)));
+
+					if (!has_x_diff && !has_y_diff && !has_z_diff)
+						continue;
+
+					// return : SurfaceNetsのSurfacePoint位置を[0,1]の割合で返す.
+					// voxel_sdf_values : 8点のsdf値を xyzの順で優先した配列. (x0y0z0,x1y0z0,x0y1z0,x1y1z0...).
+					const auto func_gen_surface_point = [](float (&voxel_sdf_values)[8])
+					{
+						FVector pos_rate = FVector::ZeroVector;
+
+						float rate_div_work = 0.0f;
+						for (auto i = 0u; i < 4; i += 1)
+						{
+							const auto i0 = i * 2;
+							const auto i1 = i0 + 1;
+							if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
+							{
+								float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
+								pos_rate += FVector(rate, (i0 >> 1) & 0b01, (i0 >> 2) & 0b01);
+							
+								rate_div_work += 1.0f;
 							}
-							// 3x3近傍の中心でXの方向の境界があるか
-							if (has_x_diff)
+						}
+					
+						for (auto i = 0u; i < 4; i += 1)
+						{
+							const auto i0 = (i & 0b01) + ((i>>1) & 0b01) * 4;
+							const auto i1 = i0 + 2;
+							if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
 							{
-								// 正の方向を向いているか
-								const bool face_to_positive = 0 < (x_row_x0y1z1 & (1 << (i)));
-
-								auto pos0 = surface_pos_0 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i, j, k), lod_level);
-								auto pos1 = surface_pos_2 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i, j + 1, k), lod_level);
-								auto pos2 = surface_pos_4 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i, j, k + 1), lod_level);
-								auto pos3 = surface_pos_6 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i, j + 1, k + 1), lod_level);
-
-								// 頂点
-								const auto vtx_id0 = vtx.Add(pos0);
-								const auto vtx_id1 = vtx.Add(pos1);
-								const auto vtx_id2 = vtx.Add(pos3);
-								const auto vtx_id3 = vtx.Add(pos2);
-
-								// 法線を計算
-								FVector face_normal = FVector::CrossProduct(pos1 - pos0, pos2 - pos0);
-								if (!face_normal.IsNearlyZero())
-								{
-									face_normal.Normalize();
-								}
-								else
-								{
-									face_normal = FVector::CrossProduct(pos2 - pos3, pos1 - pos3);
-									face_normal.Normalize();
-								}
-								if (!face_to_positive)
-									face_normal = -face_normal;
-								for (auto nrm_i = 0u; nrm_i < 4; ++nrm_i)
-									nor.Add(face_normal);
+								float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
+								pos_rate += FVector(i0 & 0b01, rate, (i0 >> 2) & 0b01);
 
-								// カラー
-								for (auto col_i = 0u; col_i < 4; ++col_i)
-								{
-									if ((chunk_reso - 1) == i)
-										col.Add(FLinearColor(1.0f, 0.0f, 0.0f, 1.0f).ToFColor(true));
-									else if ((chunk_reso - 1) == j)
-										col.Add(FLinearColor(0.0f, 1.0f, 0.0f, 1.0f).ToFColor(true));
-									else if ((chunk_reso - 1) == k)
-										col.Add(FLinearColor(0.0f, 0.0f, 1.0f, 1.0f).ToFColor(true));
-									else if (0 == i)
-										col.Add(FLinearColor(0.25f, 0.0f, 0.0f, 1.0f).ToFColor(true));
-									else if (0 == j)
-										col.Add(FLinearColor(0.0f, 0.25f, 0.0f, 1.0f).ToFColor(true));
-									else if (0 == k)
-										col.Add(FLinearColor(0.0f, 0.0f, 0.25f, 1.0f).ToFColor(true));
-									else
-										col.Add(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f).ToFColor(true));
-								}
-
-								// インデックス
-								if (face_to_positive)
-								{
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id1);
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id3);
-									tri.Add(vtx_id2);
-								}
-								else
-								{
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id1);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id3);
-								}
+								rate_div_work += 1.0f;
 							}
+						}
 
-							// 3x3近傍の中心でYの方向の境界があるか
-							if (has_y_diff)
+						for (auto i = 0u; i < 4; i += 1)
+						{
+							const auto i0 = i;
+							const auto i1 = i0 + 4;
+							if (0 > voxel_sdf_values[i0] * voxel_sdf_values[i1])
 							{
-								// 正の方向を向いているか
-								const bool face_to_positive = 0 < (shifted_x0y0z1_row & (1 << (i)));
-
-								auto pos0 = surface_pos_0 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i, j, k), lod_level);
-								auto pos1 = surface_pos_1 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i + 1, j, k), lod_level);
-								auto pos2 = surface_pos_4 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i, j, k + 1), lod_level);
-								auto pos3 = surface_pos_5 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(e, FIntVector(i + 1, j, k + 1), lod_level);
-
-								// 時計回り
-								const auto vtx_id0 = vtx.Add(pos0);
-								const auto vtx_id1 = vtx.Add(pos2);
-								const auto vtx_id2 = vtx.Add(pos3);
-								const auto vtx_id3 = vtx.Add(pos1);
-
-								// 法線を計算
-								FVector face_normal = FVector::CrossProduct(pos2 - pos0, pos1 - pos0);
-								if (!face_normal.IsNearlyZero())
-								{
-									face_normal.Normalize();
-								}
-								else
-								{
-									face_normal = FVector::CrossProduct(pos1 - pos3, pos2 - pos3);
-									face_normal.Normalize();
-								}
-								if (!face_to_positive)
-									face_normal = -face_normal;
-								for (auto nrm_i = 0u; nrm_i < 4; ++nrm_i)
-									nor.Add(face_normal);
-
-								// カラー
-								for (auto col_i = 0u; col_i < 4; ++col_i)
-								{
-									if ((chunk_reso - 1) == i)
-										col.Add(FLinearColor(1.0f, 0.0f, 0.0f, 1.0f).ToFColor(true));
-									else if ((chunk_reso - 1) == j)
-										col.Add(FLinearColor(0.0f, 1.0f, 0.0f, 1.0f).ToFColor(true));
-									else if ((chunk_reso - 1) == k)
-										col.Add(FLinearColor(0.0f, 0.0f, 1.0f, 1.0f).ToFColor(true));
-									else if (0 == i)
-										col.Add(FLinearColor(0.25f, 0.0f, 0.0f, 1.0f).ToFColor(true));
-									else if (0 == j)
-										col.Add(FLinearColor(0.0f, 0.25f, 0.0f, 1.0f).ToFColor(true));
-									else if (0 == k)
-										col.Add(FLinearColor(0.0f, 0.0f, 0.25f, 1.0f).ToFColor(true));
-									else
-										col.Add(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f).ToFColor(true));
-								}
+								float rate = 1 - voxel_sdf_values[i0] / (voxel_sdf_values[i0] - voxel_sdf_values[i1]);
+								pos_rate += FVector(i0 & 0b01, (i0 >> 1) & 0b01, rate);
 
-								// インデックス
-								if (face_to_positive)
-								{
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id1);
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id3);
-									tri.Add(vtx_id2);
-								}
-								else
-								{
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id1);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id0);
-									tri.Add(vtx_id2);
-									tri.Add(vtx_id3);
-								}
+								rate_div_work += 1.0f;
 							}
 						}
 
+						if (0.0f < rate_div_work)
+							pos_rate /= rate_div_work;
+
+						return pos_rate;
+					};
+
+
+					// Rowの指定ビットが有効か.
+					const auto func_row_bit = [](ChunkType::RowType row, unsigned int bit)
+					{
+						return 0 != ((row >> bit) & ChunkType::RowType(1));
+					};
+
+					float local_voxel_sdf[8];
+					local_voxel_sdf[0] = func_row_bit(row_y0z0, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[1] = func_row_bit(row_y0z0, i+1) ? -1.0f : 1.0f;
+					local_voxel_sdf[2] = func_row_bit(row_y1z0, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[3] = func_row_bit(row_y1z0, i+1) ? -1.0f : 1.0f;
+					local_voxel_sdf[4] = func_row_bit(row_y0z1, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[5] = func_row_bit(row_y0z1, i+1) ? -1.0f : 1.0f;
+					local_voxel_sdf[6] = func_row_bit(row_y1z1, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[7] = func_row_bit(row_y1z1, i+1) ? -1.0f : 1.0f;
+					const auto surface_pos_0 = func_gen_surface_point(local_voxel_sdf);
+
+					local_voxel_sdf[0] = func_row_bit(row_y0z0, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[1] = func_row_bit(row_y0z0, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[2] = func_row_bit(row_y1z0, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[3] = func_row_bit(row_y1z0, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[4] = func_row_bit(row_y0z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[5] = func_row_bit(row_y0z1, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[6] = func_row_bit(row_y1z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[7] = func_row_bit(row_y1z1, i + 2) ? -1.0f : 1.0f;
+					const auto surface_pos_1 = func_gen_surface_point(local_voxel_sdf);
+
+					local_voxel_sdf[0] = func_row_bit(row_y1z0, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[1] = func_row_bit(row_y1z0, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[2] = func_row_bit(row_y2z0, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[3] = func_row_bit(row_y2z0, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[4] = func_row_bit(row_y1z1, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[5] = func_row_bit(row_y1z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[6] = func_row_bit(row_y2z1, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[7] = func_row_bit(row_y2z1, i + 1) ? -1.0f : 1.0f;
+					const auto surface_pos_2 = func_gen_surface_point(local_voxel_sdf);
+
+					local_voxel_sdf[0] = func_row_bit(row_y1z0, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[1] = func_row_bit(row_y1z0, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[2] = func_row_bit(row_y2z0, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[3] = func_row_bit(row_y2z0, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[4] = func_row_bit(row_y1z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[5] = func_row_bit(row_y1z1, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[6] = func_row_bit(row_y2z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[7] = func_row_bit(row_y2z1, i + 2) ? -1.0f : 1.0f;
+					const auto surface_pos_3 = func_gen_surface_point(local_voxel_sdf);
+
+					local_voxel_sdf[0] = func_row_bit(row_y0z1, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[1] = func_row_bit(row_y0z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[2] = func_row_bit(row_y1z1, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[3] = func_row_bit(row_y1z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[4] = func_row_bit(row_y0z2, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[5] = func_row_bit(row_y0z2, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[6] = func_row_bit(row_y1z2, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[7] = func_row_bit(row_y1z2, i + 1) ? -1.0f : 1.0f;
+					const auto surface_pos_4 = func_gen_surface_point(local_voxel_sdf);
+
+					local_voxel_sdf[0] = func_row_bit(row_y0z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[1] = func_row_bit(row_y0z1, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[2] = func_row_bit(row_y1z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[3] = func_row_bit(row_y1z1, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[4] = func_row_bit(row_y0z2, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[5] = func_row_bit(row_y0z2, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[6] = func_row_bit(row_y1z2, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[7] = func_row_bit(row_y1z2, i + 2) ? -1.0f : 1.0f;
+					const auto surface_pos_5 = func_gen_surface_point(local_voxel_sdf);
+
+					local_voxel_sdf[0] = func_row_bit(row_y1z1, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[1] = func_row_bit(row_y1z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[2] = func_row_bit(row_y2z1, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[3] = func_row_bit(row_y2z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[4] = func_row_bit(row_y1z2, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[5] = func_row_bit(row_y1z2, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[6] = func_row_bit(row_y2z2, i) ? -1.0f : 1.0f;
+					local_voxel_sdf[7] = func_row_bit(row_y2z2, i + 1) ? -1.0f : 1.0f;
+					const auto surface_pos_6 = func_gen_surface_point(local_voxel_sdf);
+
+					local_voxel_sdf[0] = func_row_bit(row_y1z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[1] = func_row_bit(row_y1z1, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[2] = func_row_bit(row_y2z1, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[3] = func_row_bit(row_y2z1, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[4] = func_row_bit(row_y1z2, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[5] = func_row_bit(row_y1z2, i + 2) ? -1.0f : 1.0f;
+					local_voxel_sdf[6] = func_row_bit(row_y2z2, i + 1) ? -1.0f : 1.0f;
+					local_voxel_sdf[7] = func_row_bit(row_y2z2, i + 2) ? -1.0f : 1.0f;
+					const auto surface_pos_7 = func_gen_surface_point(local_voxel_sdf);
+
+
+
+					// 3x3近傍の中心でZの方向の境界があるか
+					if (has_z_diff)
+					{
+						// 正の方向を向いているか
+						const bool face_to_positive = 0 < (shifted_x0y1z0_row & (1 << (i)));
+
+						// 共有頂点は無視して独立して頂点生成してみる
+						// 頂点の値を無視して常にセル中心にサーフェイス頂点生成
+						auto pos0 = surface_pos_0 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i, j, k), lod_level);
+						auto pos1 = surface_pos_1 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i + 1, j, k), lod_level);
+						auto pos2 = surface_pos_2 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i, j + 1, k), lod_level);
+						auto pos3 = surface_pos_3 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i + 1, j + 1, k), lod_level);
+
+						// 時計回り
+						const auto vtx_id0 = out_mesh.vtx.Add(pos0);
+						const auto vtx_id1 = out_mesh.vtx.Add(pos1);
+						const auto vtx_id2 = out_mesh.vtx.Add(pos3);
+						const auto vtx_id3 = out_mesh.vtx.Add(pos2);
+
+						// 法線を計算
+						FVector face_normal =  FVector::CrossProduct(pos1 - pos0, pos2 - pos0);
+						if (!face_normal.IsNearlyZero())
+						{
+							face_normal.Normalize();
+						}
+						else
+						{
+							face_normal = FVector::CrossProduct(pos2 - pos3, pos1 - pos3);
+							face_normal.Normalize();
+						}
+						if (!face_to_positive)
+							face_normal = -face_normal;
+						for (auto nrm_i = 0u; nrm_i < 4; ++nrm_i)
+							out_mesh.nor.Add(face_normal);
+
+						// カラー
+						for (auto col_i = 0u; col_i < 4; ++col_i)
+						{
+							if ((chunk_reso - 1) == i)
+								out_mesh.col.Add(FLinearColor(1.0f, 0.0f, 0.0f, 1.0f).ToFColor(true));
+							else if ((chunk_reso - 1) == j)
+								out_mesh.col.Add(FLinearColor(0.0f, 1.0f, 0.0f, 1.0f).ToFColor(true));
+							else if ((chunk_reso - 1) == k)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.0f, 1.0f, 1.0f).ToFColor(true));
+							else if (0 == i)
+								out_mesh.col.Add(FLinearColor(0.25f, 0.0f, 0.0f, 1.0f).ToFColor(true));
+							else if (0 == j)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.25f, 0.0f, 1.0f).ToFColor(true));
+							else if (0 == k)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.0f, 0.25f, 1.0f).ToFColor(true));
+							else
+								out_mesh.col.Add(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f).ToFColor(true));
+						}
+
+						// インデックス
+						if (face_to_positive)
+						{
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id1);
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id3);
+							out_mesh.tri.Add(vtx_id2);
+						}
+						else
+						{
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id1);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id3);
+						}
+					}
+					// 3x3近傍の中心でXの方向の境界があるか
+					if (has_x_diff)
+					{
+						// 正の方向を向いているか
+						const bool face_to_positive = 0 < (x_row_x0y1z1 & (1 << (i)));
+
+						auto pos0 = surface_pos_0 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i, j, k), lod_level);
+						auto pos1 = surface_pos_2 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i, j + 1, k), lod_level);
+						auto pos2 = surface_pos_4 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i, j, k + 1), lod_level);
+						auto pos3 = surface_pos_6 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i, j + 1, k + 1), lod_level);
+
+						// 頂点
+						const auto vtx_id0 = out_mesh.vtx.Add(pos0);
+						const auto vtx_id1 = out_mesh.vtx.Add(pos1);
+						const auto vtx_id2 = out_mesh.vtx.Add(pos3);
+						const auto vtx_id3 = out_mesh.vtx.Add(pos2);
+
+						// 法線を計算
+						FVector face_normal = FVector::CrossProduct(pos1 - pos0, pos2 - pos0);
+						if (!face_normal.IsNearlyZero())
+						{
+							face_normal.Normalize();
+						}
+						else
+						{
+							face_normal = FVector::CrossProduct(pos2 - pos3, pos1 - pos3);
+							face_normal.Normalize();
+						}
+						if (!face_to_positive)
+							face_normal = -face_normal;
+						for (auto nrm_i = 0u; nrm_i < 4; ++nrm_i)
+							out_mesh.nor.Add(face_normal);
+
+						// カラー
+						for (auto col_i = 0u; col_i < 4; ++col_i)
+						{
+							if ((chunk_reso - 1) == i)
+								out_mesh.col.Add(FLinearColor(1.0f, 0.0f, 0.0f, 1.0f).ToFColor(true));
+							else if ((chunk_reso - 1) == j)
+								out_mesh.col.Add(FLinearColor(0.0f, 1.0f, 0.0f, 1.0f).ToFColor(true));
+							else if ((chunk_reso - 1) == k)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.0f, 1.0f, 1.0f).ToFColor(true));
+							else if (0 == i)
+								out_mesh.col.Add(FLinearColor(0.25f, 0.0f, 0.0f, 1.0f).ToFColor(true));
+							else if (0 == j)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.25f, 0.0f, 1.0f).ToFColor(true));
+							else if (0 == k)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.0f, 0.25f, 1.0f).ToFColor(true));
+							else
+								out_mesh.col.Add(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f).ToFColor(true));
+						}
+
+						// インデックス
+						if (face_to_positive)
+						{
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id1);
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id3);
+							out_mesh.tri.Add(vtx_id2);
+						}
+						else
+						{
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id1);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id3);
+						}
+					}
+
+					// 3x3近傍の中心でYの方向の境界があるか
+					if (has_y_diff)
+					{
+						// 正の方向を向いているか
+						const bool face_to_positive = 0 < (shifted_x0y0z1_row & (1 << (i)));
+
+						auto pos0 = surface_pos_0 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i, j, k), lod_level);
+						auto pos1 = surface_pos_1 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i + 1, j, k), lod_level);
+						auto pos2 = surface_pos_4 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i, j, k + 1), lod_level);
+						auto pos3 = surface_pos_5 * FVector::OneVector * voxel_extent + CalcChunkVoxelCenterPosition(chunk_id, cell_offset + FIntVector(i + 1, j, k + 1), lod_level);
+
+						// 時計回り
+						const auto vtx_id0 = out_mesh.vtx.Add(pos0);
+						const auto vtx_id1 = out_mesh.vtx.Add(pos2);
+						const auto vtx_id2 = out_mesh.vtx.Add(pos3);
+						const auto vtx_id3 = out_mesh.vtx.Add(pos1);
+
+						// 法線を計算
+						FVector face_normal = FVector::CrossProduct(pos2 - pos0, pos1 - pos0);
+						if (!face_normal.IsNearlyZero())
+						{
+							face_normal.Normalize();
+						}
+						else
+						{
+							face_normal = FVector::CrossProduct(pos1 - pos3, pos2 - pos3);
+							face_normal.Normalize();
+						}
+						if (!face_to_positive)
+							face_normal = -face_normal;
+						for (auto nrm_i = 0u; nrm_i < 4; ++nrm_i)
+							out_mesh.nor.Add(face_normal);
+
+						// カラー
+						for (auto col_i = 0u; col_i < 4; ++col_i)
+						{
+							if ((chunk_reso - 1) == i)
+								out_mesh.col.Add(FLinearColor(1.0f, 0.0f, 0.0f, 1.0f).ToFColor(true));
+							else if ((chunk_reso - 1) == j)
+								out_mesh.col.Add(FLinearColor(0.0f, 1.0f, 0.0f, 1.0f).ToFColor(true));
+							else if ((chunk_reso - 1) == k)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.0f, 1.0f, 1.0f).ToFColor(true));
+							else if (0 == i)
+								out_mesh.col.Add(FLinearColor(0.25f, 0.0f, 0.0f, 1.0f).ToFColor(true));
+							else if (0 == j)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.25f, 0.0f, 1.0f).ToFColor(true));
+							else if (0 == k)
+								out_mesh.col.Add(FLinearColor(0.0f, 0.0f, 0.25f, 1.0f).ToFColor(true));
+							else
+								out_mesh.col.Add(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f).ToFColor(true));
+						}
+
+						// インデックス
+						if (face_to_positive)
+						{
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id1);
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id3);
+							out_mesh.tri.Add(vtx_id2);
+						}
+						else
+						{
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id1);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id0);
+							out_mesh.tri.Add(vtx_id2);
+							out_mesh.tri.Add(vtx_id3);
+						}
+					}
+				}
+
+			}
+		}
+	}
+
+	// LODの異なる近傍チャンクとの境界の亀裂を隠すスカートを生成する.
+	// 境界面上のSurfaceCellを結ぶメッシュの縁のエッジを求め, そこからソリッド側へskirt_length分垂らした両面Quadを追加する.
+	// メッシュの縁のエッジは境界面に平行なVoxelエッジの符号変化から求める. +側は自身の端のVoxel, -側はオーバーラップ部のVoxelで判定する.
+	// ブロック形状のメッシュでは縁はVoxelの角を結ぶため, SurfacePointの代わりにVoxelの角の位置を用いる.
+	// skirt_face_mask : naga::VoxelChunkFace のビットマスク.
+	void AVoxelEngine::BuildChunkMeshSkirt(const ChunkType& chunk, unsigned int lod_level, uint32 skirt_face_mask, float skirt_length, bool is_block_surface, naga::VoxelChunkMeshData& out_mesh) const
+	{
+		using RowType = ChunkType::RowType;
+
+		const int chunk_reso = static_cast<int>(ChunkType::CHUNK_RESOLUTION(lod_level));
+		const auto voxel_extent = GetVoxelSize(lod_level);
+		const auto cell_origin_pos = CalcChunkVoxelCenterPosition(chunk.GetId(), FIntVector(-1, -1, -1), lod_level);
+		const auto voxel_origin_pos = CalcChunkVoxelMinPosition(chunk.GetId(), FIntVector::ZeroValue, lod_level);
+
+		// オーバーラップ込のSurfaceCell座標のSurfacePointのワールド位置. ブロック形状ではSurfaceCell中心のVoxelの角.
+		const auto func_surface_pos = [&chunk, lod_level, &cell_origin_pos, &voxel_origin_pos, voxel_extent, is_block_surface](int x, int y, int z)
+		{
+			if (is_block_surface)
+				return voxel_origin_pos + FVector(x, y, z) * voxel_extent;
+
+			const RowType y0z0 = chunk.GetXRowWithOverlap(y, z, lod_level);
+			const RowType y1z0 = chunk.GetXRowWithOverlap(y + 1, z, lod_level);
+			const RowType y0z1 = chunk.GetXRowWithOverlap(y, z + 1, lod_level);
+			const RowType y1z1 = chunk.GetXRowWithOverlap(y + 1, z + 1, lod_level);
+			const auto pattern = static_cast<uint32>(((y0z0 >> x) & 0x03) | (((y1z0 >> x) & 0x03) << 2) | (((y0z1 >> x) & 0x03) << 4) | (((y1z1 >> x) & 0x03) << 6));
+			return cell_origin_pos + (FVector(x, y, z) + k_surface_nets_bit_pattern_table.surface_point_[pattern]) * voxel_extent;
+		};
+		// 両面Quad追加.
+		const auto func_add_skirt = [&out_mesh, skirt_length](const FVector& pos0, const FVector& pos1, const FVector& solid_dir)
+		{
+			const auto offset = solid_dir * skirt_length;
+			const auto vtx_id0 = out_mesh.vtx.Add(pos0);
+			const auto vtx_id1 = out_mesh.vtx.Add(pos1);
+			const auto vtx_id2 = out_mesh.vtx.Add(pos1 + offset);
+			const auto vtx_id3 = out_mesh.vtx.Add(pos0 + offset);
+			const auto color = FLinearColor(0.5f, 0.5f, 0.5f, 1.0f).ToFColor(true);
+			for (auto vi = 0u; vi < 4; ++vi)
+			{
+				out_mesh.nor.Add(-solid_dir);
+				out_mesh.col.Add(color);
+			}
+			// 向きは判定せず両面分追加.
+			out_mesh.tri.Add(vtx_id0);
+			out_mesh.tri.Add(vtx_id1);
+			out_mesh.tri.Add(vtx_id2);
+			out_mesh.tri.Add(vtx_id0);
+			out_mesh.tri.Add(vtx_id2);
+			out_mesh.tri.Add(vtx_id3);
+			out_mesh.tri.Add(vtx_id0);
+			out_mesh.tri.Add(vtx_id2);
+			out_mesh.tri.Add(vtx_id1);
+			out_mesh.tri.Add(vtx_id0);
+			out_mesh.tri.Add(vtx_id3);
+			out_mesh.tri.Add(vtx_id2);
+		};
+		// Voxelエッジ(v0が+側)の符号変化があればスカート追加.
+		const auto func_test_edge = [&func_add_skirt](bool v0, bool v1, const FVector& pos0, const FVector& pos1, const FVector& axis)
+		{
+			if (v0 != v1)
+				func_add_skirt(pos0, pos1, (v0) ? axis : -axis);
+		};
+
+		for (int face = 0; face < naga::VoxelChunkFace::Count; ++face)
+		{
+			if (0 == (skirt_face_mask & naga::VoxelChunkFace::Bit(static_cast<naga::VoxelChunkFace::Type>(face))))
+				continue;
+
+			// 判定するVoxel層 (オーバーラップを含まない座標) と, その+側のSurfaceCell層 (オーバーラップ込のSurfaceCell座標).
+			const bool is_positive = (0 != (face & 0x01));
+			const int c = (is_positive) ? chunk_reso - 1 : -1;
+			const int l = c + 1;
+
+			for (int b = 0; b < chunk_reso; ++b)
+			{
+				for (int a = 0; a < chunk_reso; ++a)
+				{
+					if (face < naga::VoxelChunkFace::NegativeY)
+					{
+						// X面. a:Y, b:Z
+						func_test_edge(chunk.Get(c, a, b, lod_level), chunk.Get(c, a, b - 1, lod_level), func_surface_pos(l, a, b), func_surface_pos(l, a + 1, b), FVector::UpVector);
+						func_test_edge(chunk.Get(c, a, b, lod_level), chunk.Get(c, a - 1, b, lod_level), func_surface_pos(l, a, b), func_surface_pos(l, a, b + 1), FVector::RightVector);
+					}
+					else if (face < naga::VoxelChunkFace::NegativeZ)
+					{
+						// Y面. a:X, b:Z
+						func_test_edge(chunk.Get(a, c, b, lod_level), chunk.Get(a, c, b - 1, lod_level), func_surface_pos(a, l, b), func_surface_pos(a + 1, l, b), FVector::UpVector);
+						func_test_edge(chunk.Get(a, c, b, lod_level), chunk.Get(a - 1, c, b, lod_level), func_surface_pos(a, l, b), func_surface_pos(a, l, b + 1), FVector::ForwardVector);
+					}
+					else
+					{
+						// Z面. a:X, b:Y
+						func_test_edge(chunk.Get(a, b, c, lod_level), chunk.Get(a - 1, b, c, lod_level), func_surface_pos(a, b, l), func_surface_pos(a, b + 1, l), FVector::ForwardVector);
+						func_test_edge(chunk.Get(a, b, c, lod_level), chunk.Get(a, b - 1, c, lod_level), func_surface_pos(a, b, l), func_surface_pos(a + 1, b, l), FVector::RightVector);
+					}
+				}
+			}
+		}
+	}
+
+	// 重視チャンクからの距離でLODを決定.
+	unsigned int AVoxelEngine::CalcChunkLodLevel(const FIntVector& chunk_id, const FIntVector& important_chunk_position) const
+	{
+		const auto chunk_distance = important_chunk_position - chunk_id;
+		const auto chunk_distance_len = FVector(chunk_distance).Length();
+
+		// 適当に距離に線形にLOD
+		auto lod_level = static_cast<unsigned int>(chunk_distance_len / FMath::Max(1.0f, lod_distance_chunk_count_));
+		// 最小LODでクランプ
+		lod_level = FMath::Min(ChunkType::LOD_MAX_INDEX(), FMath::Max(static_cast<unsigned int>(min_lod_level_), lod_level));
+		return lod_level;
+	}
+
+	// StreamInの優先度. 重視位置からのチャンク単位の距離に, 視線方向から外れるほど大きくなるペナルティを加算する.
+	// ペナルティを乗算ではなく加算とするのは, 世代更新時の優先度の減少量の上限をStreamQueueへ渡せるようにするため.
+	float AVoxelEngine::CalcChunkStreamInPriority(const FIntVector& chunk_id, const FVector& position, const FVector& forward) const
+	{
+		const float chunk_size = voxel_size_ * ChunkType::CHUNK_RESOLUTION();
+		const FVector chunk_center = (FVector(chunk_id) + FVector(0.5f)) * chunk_size;
+		const FVector to_chunk = (chunk_center - position) / chunk_size;
+		const float distance = to_chunk.Length();
+		if (UE_SMALL_NUMBER > distance)
+			return 0.0f;
+
+		// 正面で0, 真後ろで1.
+		const float back_rate = (1.0f - FVector::DotProduct(to_chunk / distance, forward)) * 0.5f;
+		return distance + CalcChunkStreamInViewPenaltyMax() * back_rate;
+	}
+	float AVoxelEngine::CalcChunkStreamInViewPenaltyMax() const
+	{
+		return FMath::Max(0.0f, stream_priority_view_weight_) * static_cast<float>(stream_in_chunk_range_horizontal);
+	}
+	// StreamOutの優先度. 遠いチャンクから処理する.
+	float AVoxelEngine::CalcChunkStreamOutPriority(const FIntVector& chunk_id, const FVector& position) const
+	{
+		const float chunk_size = voxel_size_ * ChunkType::CHUNK_RESOLUTION();
+		const FVector chunk_center = (FVector(chunk_id) + FVector(0.5f)) * chunk_size;
+		return -FVector::Distance(chunk_center, position) / chunk_size;
+	}
+
+	// SurfaceNetsによるポリゴン生成. Row単位のビット演算版.
+	// 境界エッジの検出をRow単位のシフトとXORで行い, 境界の無いRowはまとめてスキップする.
+	// 境界のあるビットのみctzで列挙し, SurfacePointは8頂点の占有パターンからテーブル参照する.
+	// 頂点はSurfaceCell毎に1つ生成してQuad間で共有し, 法線は占有パターンの勾配とする.
+	// 三角形の頂点位置は素朴な実装と同一.
+	void AVoxelEngine::BuildChunkMeshSurfaceNets_BitCompressionVoxel(const ChunkType& chunk, unsigned int lod_level, naga::VoxelChunkMeshData& out_mesh) const
+	{
+		using RowType = ChunkType::RowType;
+
+		const auto chunk_reso = ChunkType::CHUNK_RESOLUTION(lod_level);
+		const auto voxel_extent = GetVoxelSize(lod_level);
+
+		// オーバーラップ込のSurfaceCell座標(0,0,0)に対応するワールド位置.
+		const auto cell_origin_pos = CalcChunkVoxelCenterPosition(chunk.GetId(), FIntVector(-1, -1, -1), lod_level);
+		// オーバーラップを除いた範囲のマスク (X=0がbit0).
+		const RowType inner_mask = ChunkType::ROW_INNER_MASK(lod_level) >> 1;
+
+		// 最下位の有効ビット位置.
+		const auto func_count_trailing_zeros = [](RowType v) -> unsigned int
+		{
+			if constexpr (sizeof(RowType) > sizeof(uint32))
+				return static_cast<unsigned int>(FMath::CountTrailingZeros64(v));
+			else
+				return static_cast<unsigned int>(FMath::CountTrailingZeros(v));
+		};
+		// SurfaceCellの8頂点の占有パターン. 4Rowそれぞれから基準位置の2bitを取得.
+		const auto func_cell_pattern = [](RowType y0z0, RowType y1z0, RowType y0z1, RowType y1z1, unsigned int x) -> uint32
+		{
+			return static_cast<uint32>(((y0z0 >> x) & 0x03) | (((y1z0 >> x) & 0x03) << 2) | (((y0z1 >> x) & 0x03) << 4) | (((y1z1 >> x) & 0x03) << 6));
+		};
+
+		// SurfaceCell毎に1頂点を生成し, 複数のQuadで共有する.
+		// Quadが参照するSurfaceCellのZは処理中のkとk+1のみのため, 2スライス分のキャッシュを入れ替えながら使う.
+		const unsigned int cell_slice_width = chunk_reso + 1;
+		const int cell_slice_size = cell_slice_width * cell_slice_width;
+		TArray<int32> cell_vtx_cache;
+		cell_vtx_cache.Init(INDEX_NONE, cell_slice_size * 2);
+		int32* cell_vtx_slice[2] = { cell_vtx_cache.GetData(), cell_vtx_cache.GetData() + cell_slice_size };
+
+		// 勾配が0となるパターンの頂点は, 参照するQuadの面の向きを合計して法線とする.
+		const int32 vtx_base = out_mesh.vtx.Num();
+		TArray<bool> vtx_face_normal;
+
+		// SurfaceCellの頂点インデックス. 未生成なら生成する. x,y,zはオーバーラップ込のSurfaceCell座標, zはkまたはk+1.
+		const auto func_cell_vertex = [&](uint32 pattern, unsigned int x, unsigned int y, unsigned int z, unsigned int k) -> int32
+		{
+			auto&& vtx_id = cell_vtx_slice[z - k][y * cell_slice_width + x];
+			if (INDEX_NONE == vtx_id)
+			{
+				const auto& normal = k_surface_nets_bit_pattern_table.normal_[pattern];
+				vtx_id = out_mesh.vtx.Add(cell_origin_pos + (FVector(x, y, z) + k_surface_nets_bit_pattern_table.surface_point_[pattern]) * voxel_extent);
+				out_mesh.nor.Add(normal);
+				out_mesh.col.Add(CalcSurfaceNetsDebugColor(x, y, z, cell_slice_width));
+				vtx_face_normal.Add(normal.IsZero());
+			}
+			return vtx_id;
+		};
+		// Quad追加. 頂点はvtx0,vtx1,vtx3,vtx2の順で時計回り. axis_normalは正の方向を向く場合の面の向き.
+		const auto func_add_quad = [&out_mesh, &vtx_face_normal, vtx_base](int32 vtx0, int32 vtx1, int32 vtx2, int32 vtx3, bool face_to_positive, const FVector& axis_normal)
+		{
+			for (const auto vtx_id : { vtx0, vtx1, vtx2, vtx3 })
+			{
+				if (vtx_face_normal[vtx_id - vtx_base])
+					out_mesh.nor[vtx_id] += face_to_positive ? axis_normal : -axis_normal;
+			}
+
+			// インデックス
+			if (face_to_positive)
+			{
+				out_mesh.tri.Add(vtx0);
+				out_mesh.tri.Add(vtx3);
+				out_mesh.tri.Add(vtx1);
+				out_mesh.tri.Add(vtx0);
+				out_mesh.tri.Add(vtx2);
+				out_mesh.tri.Add(vtx3);
+			}
+			else
+			{
+				out_mesh.tri.Add(vtx0);
+				out_mesh.tri.Add(vtx1);
+				out_mesh.tri.Add(vtx3);
+				out_mesh.tri.Add(vtx0);
+				out_mesh.tri.Add(vtx3);
+				out_mesh.tri.Add(vtx2);
+			}
+		};
+
+		for (auto k = 0u; k < chunk_reso; ++k)
+		{
+			for (auto j = 0u; j < chunk_reso; ++j)
+			{
+				// 中心Row (j+1, k+1) と -Y,-Z側のRow.
+				const RowType row_y1z1 = chunk.GetXRowWithOverlap(j + 1, k + 1, lod_level);
+				const RowType row_y1z0 = chunk.GetXRowWithOverlap(j + 1, k, lod_level);
+				const RowType row_y0z1 = chunk.GetXRowWithOverlap(j, k + 1, lod_level);
+
+				// 中心Voxelと各軸の-1方向のVoxelとの差分をRow単位で計算. bit iがチャンク内X=iに対応.
+				const RowType center = row_y1z1 >> 1;
+				const RowType x_dif = (row_y1z1 ^ center) & inner_mask;
+				const RowType y_dif = ((row_y0z1 >> 1) ^ center) & inner_mask;
+				const RowType z_dif = ((row_y1z0 >> 1) ^ center) & inner_mask;
+
+				// 境界の無いRowはまとめてスキップ.
+				RowType edge_bits = x_dif | y_dif | z_dif;
+				if (0 == edge_bits)
+					continue;
+
+				// SurfacePoint計算に必要な残りの近傍Row.
+				const RowType row_y0z0 = chunk.GetXRowWithOverlap(j, k, lod_level);
+				const RowType row_y0z2 = chunk.GetXRowWithOverlap(j, k + 2, lod_level);
+				const RowType row_y1z2 = chunk.GetXRowWithOverlap(j + 1, k + 2, lod_level);
+				const RowType row_y2z0 = chunk.GetXRowWithOverlap(j + 2, k, lod_level);
+				const RowType row_y2z1 = chunk.GetXRowWithOverlap(j + 2, k + 1, lod_level);
+				const RowType row_y2z2 = chunk.GetXRowWithOverlap(j + 2, k + 2, lod_level);
+
+				// 境界を含むビットのみ列挙.
+				for (; 0 != edge_bits; edge_bits &= (edge_bits - 1))
+				{
+					const auto i = func_count_trailing_zeros(edge_bits);
+					const auto bit = RowType(1) << i;
+
+					// 3x3近傍の中心でZの方向の境界があるか
+					if (z_dif & bit)
+					{
+						// 正の方向を向いているか
+						const bool face_to_positive = 0 != ((row_y1z0 >> (i + 1)) & 0x01);
+
+						const auto vtx0 = func_cell_vertex(func_cell_pattern(row_y0z0, row_y1z0, row_y0z1, row_y1z1, i), i, j, k, k);
+						const auto vtx1 = func_cell_vertex(func_cell_pattern(row_y0z0, row_y1z0, row_y0z1, row_y1z1, i + 1), i + 1, j, k, k);
+						const auto vtx2 = func_cell_vertex(func_cell_pattern(row_y1z0, row_y2z0, row_y1z1, row_y2z1, i), i, j + 1, k, k);
+						const auto vtx3 = func_cell_vertex(func_cell_pattern(row_y1z0, row_y2z0, row_y1z1, row_y2z1, i + 1), i + 1, j + 1, k, k);
+
+						func_add_quad(vtx0, vtx1, vtx2, vtx3, face_to_positive, FVector(0.0f, 0.0f, 1.0f));
+					}
+					// 3x3近傍の中心でXの方向の境界があるか
+					if (x_dif & bit)
+					{
+						// 正の方向を向いているか
+						const bool face_to_positive = 0 != ((row_y1z1 >> i) & 0x01);
+
+						const auto vtx0 = func_cell_vertex(func_cell_pattern(row_y0z0, row_y1z0, row_y0z1, row_y1z1, i), i, j, k, k);
+						const auto vtx1 = func_cell_vertex(func_cell_pattern(row_y1z0, row_y2z0, row_y1z1, row_y2z1, i), i, j + 1, k, k);
+						const auto vtx2 = func_cell_vertex(func_cell_pattern(row_y0z1, row_y1z1, row_y0z2, row_y1z2, i), i, j, k + 1, k);
+						const auto vtx3 = func_cell_vertex(func_cell_pattern(row_y1z1, row_y2z1, row_y1z2, row_y2z2, i), i, j + 1, k + 1, k);
+
+						func_add_quad(vtx0, vtx1, vtx2, vtx3, face_to_positive, FVector(1.0f, 0.0f, 0.0f));
+					}
+					// 3x3近傍の中心でYの方向の境界があるか
+					if (y_dif & bit)
+					{
+						// 正の方向を向いているか
+						const bool face_to_positive = 0 != ((row_y0z1 >> (i + 1)) & 0x01);
+
+						const auto vtx0 = func_cell_vertex(func_cell_pattern(row_y0z0, row_y1z0, row_y0z1, row_y1z1, i), i, j, k, k);
+						const auto vtx1 = func_cell_vertex(func_cell_pattern(row_y0z0, row_y1z0, row_y0z1, row_y1z1, i + 1), i + 1, j, k, k);
+						const auto vtx2 = func_cell_vertex(func_cell_pattern(row_y0z1, row_y1z1, row_y0z2, row_y1z2, i), i, j, k + 1, k);
+						const auto vtx3 = func_cell_vertex(func_cell_pattern(row_y0z1, row_y1z1, row_y0z2, row_y1z2, i + 1), i + 1, j, k + 1, k);
+
+						// Y方向は頂点順を入れ替えて他の軸と同じ処理で時計回りにする.
+						func_add_quad(vtx0, vtx2, vtx1, vtx3, face_to_positive, FVector(0.0f, 1.0f, 0.0f));
+					}
+				}
+			}
+
+			// 次のkではk+1のスライスがkのスライスとなる.
+			Swap(cell_vtx_slice[0], cell_vtx_slice[1]);
+			FMemory::Memset(cell_vtx_slice[1], 0xff, sizeof(int32) * cell_slice_size);
+		}
+
+		// 面の向きも打ち消し合う場合は上向きとする.
+		for (int32 vi = 0; vi < vtx_face_normal.Num(); ++vi)
+		{
+			if (vtx_face_normal[vi])
+				out_mesh.nor[vtx_base + vi] = out_mesh.nor[vtx_base + vi].GetSafeNormal(UE_SMALL_NUMBER, FVector::UpVector);
+		}
+	}
+
+	// Voxel編集要求を追加. 次回のSyncでAsyncへ渡される.
+	void AVoxelEngine::EditVoxel(const naga::VoxelEditRequest& request)
+	{
+		if (0.0 >= request.extent.GetMin())
+			return;
+		edit_request_array_.Add(request);
+	}
+	bool AVoxelEngine::RayCastVoxel(const FVector& start, const FVector& end, naga::VoxelRayHit& out_hit)
+	{
+		async_task_.WaitAsyncUpdate();
+
+		TArray<ChunkType::RowType> scratch_rows;
+		return RayCastVoxelImpl(start, end, out_hit, scratch_rows);
+	}
+	void AVoxelEngine::RayCastVoxelBatch(const TArray<naga::VoxelRayQuery>& queries, TArray<naga::VoxelRayHit>& out_hits)
+	{
+		async_task_.WaitAsyncUpdate();
+
+		ExecuteRayCastVoxel(queries, out_hits);
+	}
+	bool AVoxelEngine::LineTraceVoxel(const FVector& start, const FVector& end, FVector& out_position, FVector& out_normal)
+	{
+		naga::VoxelRayHit hit;
+		const bool is_hit = RayCastVoxel(start, end, hit);
+		out_position = hit.position;
+		out_normal = hit.normal;
+		return is_hit;
+	}
+	int32 AVoxelEngine::RequestRayCastVoxel(const FVector& start, const FVector& end)
+	{
+		naga::VoxelRayQuery query;
+		query.start = start;
+		query.end = end;
+		return ray_cast_request_array_.Add(query);
+	}
+	void AVoxelEngine::ExecuteRayCastVoxel(const TArray<naga::VoxelRayQuery>& queries, TArray<naga::VoxelRayHit>& out_hits) const
+	{
+		out_hits.SetNum(queries.Num());
+		if (0 >= queries.Num())
+			return;
+
+		// ワーカー毎にまとめて処理し, 圧縮チャンクの展開先を使い回す.
+		constexpr int query_count_per_job = 64;
+		const int job_count = (queries.Num() + query_count_per_job - 1) / query_count_per_job;
+		ParallelFor(job_count,
+			[this, &queries, &out_hits](int32 job_index)
+			{
+				TArray<ChunkType::RowType> scratch_rows;
+				const int query_end = FMath::Min(queries.Num(), (job_index + 1) * query_count_per_job);
+				for (int i = job_index * query_count_per_job; i < query_end; ++i)
+				{
+					RayCastVoxelImpl(queries[i].start, queries[i].end, out_hits[i], scratch_rows);
+				}
+			});
+	}
+
+	// LODピラミッドを加速構造としたDDA.
+	// LODは下位LODの2x2x2の論理和のため, 空のLODのVoxelに含まれるLOD0のVoxelは全て空となる.
+	// 現在のVoxelについて最も粗いLODから順に判定し, 空となった最も粗いセルを一度に通過する. LOD0まで埋まっていればヒット.
+	// 未ロードやStreamIn/Out中のチャンクは空として扱い, チャンク単位で通過する. チャンクを変更しないため並列に実行できる.
+	bool AVoxelEngine::RayCastVoxelImpl(const FVector& start, const FVector& end, naga::VoxelRayHit& out_hit, TArray<ChunkType::RowType>& scratch_rows) const
+	{
+		out_hit = {};
+
+		constexpr int chunk_reso = static_cast<int>(ChunkType::CHUNK_RESOLUTION());
+		constexpr int lod_max = static_cast<int>(ChunkType::LOD_MAX_INDEX());
+		const auto func_floor_div = [](int v, int d)
+		{
+			return (0 <= v) ? (v / d) : (-((-v - 1) / d) - 1);
+		};
+
+		// LOD0のVoxelを単位とする空間で走査する. Rayのパラメータtは始点0, 終点1.
+		const FVector ray_origin = start / voxel_size_;
+		const FVector ray_delta = (end - start) / voxel_size_;
+		int step[3];
+		double inv_delta[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			step[a] = (0.0 < ray_delta[a]) ? 1 : ((0.0 > ray_delta[a]) ? -1 : 0);
+			inv_delta[a] = (0 != step[a]) ? 1.0 / ray_delta[a] : 0.0;
+		}
+
+		FIntVector voxel = naga::math::FVectorFloorToInt(ray_origin);
+		double ray_t = 0.0;
+		int enter_axis = -1;
+
+		FIntVector cached_chunk_id(MAX_int32);
+		const ChunkType* cached_chunk = nullptr;
+		const ChunkType::RowType* cached_rows = nullptr;
+
+		// 各反復で少なくとも1軸は進むため, 通過し得るLOD0のVoxel数で打ち切る.
+		const int max_iteration = FMath::CeilToInt(FMath::Abs(ray_delta.X) + FMath::Abs(ray_delta.Y) + FMath::Abs(ray_delta.Z)) + 3;
+		for (int iteration = 0; iteration < max_iteration; ++iteration)
+		{
+			const FIntVector chunk_id(func_floor_div(voxel.X, chunk_reso), func_floor_div(voxel.Y, chunk_reso), func_floor_div(voxel.Z, chunk_reso));
+			if (chunk_id != cached_chunk_id)
+			{
+				cached_chunk_id = chunk_id;
+				cached_chunk = nullptr;
+				cached_rows = nullptr;
+				auto&& chunk_ptr = voxel_chunk_map_.Find(chunk_id);
+				if (chunk_ptr && *chunk_ptr && naga::VoxelChunkState::Active == (*chunk_ptr)->GetState())
+				{
+					cached_chunk = *chunk_ptr;
+					if (naga::VoxelChunkFillState::Mixed == cached_chunk->GetFillState())
+						cached_rows = cached_chunk->GetRowsForRead(scratch_rows);
+				}
+			}
+
+			// 通過するセルのサイズ. 0の場合はヒット.
+			int skip_size = chunk_reso;
+			if (cached_chunk)
+			{
+				const auto fill_state = cached_chunk->GetFillState();
+				if (naga::VoxelChunkFillState::Solid == fill_state)
+				{
+					skip_size = 0;
+				}
+				else if (naga::VoxelChunkFillState::Mixed == fill_state)
+				{
+					const FIntVector local = voxel - chunk_id * chunk_reso;
+					skip_size = 0;
+					for (int lod = lod_max; 0 <= lod; --lod)
+					{
+						if (!ChunkType::GetFromRows(cached_rows, local.X >> lod, local.Y >> lod, local.Z >> lod, lod))
+						{
+							skip_size = 1 << lod;
+							break;
+						}
+					}
+				}
+			}
+
+			if (0 >= skip_size)
+			{
+				out_hit.is_hit = true;
+				out_hit.ray_t = static_cast<float>(ray_t);
+				out_hit.position = start + (end - start) * ray_t;
+				if (0 <= enter_axis)
+					out_hit.normal[enter_axis] = -step[enter_axis];
+				out_hit.chunk_id = chunk_id;
+				out_hit.voxel = voxel - chunk_id * chunk_reso;
+				return true;
+			}
+
+			// 空のセルの出口へ進む.
+			FIntVector cell_min;
+			for (int a = 0; a < 3; ++a)
+			{
+				cell_min[a] = func_floor_div(voxel[a], skip_size) * skip_size;
+			}
+			double exit_t = TNumericLimits<double>::Max();
+			for (int a = 0; a < 3; ++a)
+			{
+				if (0 == step[a])
+					continue;
+				const double boundary = (0 < step[a]) ? (cell_min[a] + skip_size) : cell_min[a];
+				exit_t = FMath::Min(exit_t, (boundary - ray_origin[a]) * inv_delta[a]);
+			}
+			if (1.0 <= exit_t)
+				break;
+
+			// 出口の面の軸は隣のセルへ. 他の軸はセル内に収めつつ後退しないようにする.
+			for (int a = 0; a < 3; ++a)
+			{
+				if (0 == step[a])
+					continue;
+				const double boundary = (0 < step[a]) ? (cell_min[a] + skip_size) : cell_min[a];
+				if ((boundary - ray_origin[a]) * inv_delta[a] <= exit_t)
+				{
+					voxel[a] = (0 < step[a]) ? (cell_min[a] + skip_size) : (cell_min[a] - 1);
+					enter_axis = a;
+				}
+				else
+				{
+					const int v = FMath::Clamp(FMath::FloorToInt(ray_origin[a] + ray_delta[a] * exit_t), cell_min[a], cell_min[a] + skip_size - 1);
+					voxel[a] = (0 < step[a]) ? FMath::Max(voxel[a], v) : FMath::Min(voxel[a], v);
+				}
+			}
+			ray_t = exit_t;
+		}
+		return false;
+	}
+
+	void AVoxelEngine::EditVoxelSphere(const FVector& center, float radius, bool fill)
+	{
+		naga::VoxelEditRequest request;
+		request.shape = naga::VoxelEditRequest::Shape::Sphere;
+		request.fill = fill;
+		request.center = center;
+		request.extent = FVector(radius);
+		EditVoxel(request);
+	}
+	void AVoxelEngine::EditVoxelBox(const FVector& center, const FVector& half_extent, bool fill)
+	{
+		naga::VoxelEditRequest request;
+		request.shape = naga::VoxelEditRequest::Shape::Box;
+		request.fill = fill;
+		request.center = center;
+		request.extent = half_extent;
+		EditVoxel(request);
+	}
+
+	// ストリーミングのベンチマークを開始する.
+	// 現在のチャンクを破棄してから重視位置をパスに沿って移動させ, StreamIn要求からメッシュ反映までの遅延を計測する.
+	// 計測条件を揃えるためチャンクストアは閉じたままとし, 全チャンクをノイズから生成する.
+	void AVoxelEngine::StartStreamBenchmark()
+	{
+		async_task_.WaitAsyncUpdate();
+		FinalizeVoxel();
+
+		stream_benchmark_ = {};
+		stream_benchmark_.path = stream_benchmark_path_;
+		if (2 > stream_benchmark_.path.Num())
+		{
+			// 原点から+X方向へ直進.
+			const float chunk_size = voxel_size_ * ChunkType::CHUNK_RESOLUTION();
+			stream_benchmark_.path = { FVector(0.0f, 0.0f, chunk_size * 0.5f), FVector(chunk_size * 64.0f, 0.0f, chunk_size * 0.5f) };
+		}
+		for (int i = 1; i < stream_benchmark_.path.Num(); ++i)
+		{
+			stream_benchmark_.path_length += FVector::Distance(stream_benchmark_.path[i - 1], stream_benchmark_.path[i]);
+		}
+		stream_benchmark_.start_sec = FPlatformTime::Seconds();
+		stream_benchmark_.is_running = true;
+
+		UE_LOG(LogTemp, Display, TEXT("[AVoxelEngine] Stream Benchmark Start: path length %.0f, speed %.0f"), stream_benchmark_.path_length, stream_benchmark_speed_);
+	}
+	// パス上の位置を進めて重視位置と視線方向を設定する. パスの終端に達したら終了.
+	void AVoxelEngine::UpdateStreamBenchmark(float delta_time)
+	{
+		auto& bench = stream_benchmark_;
+		if (bench.path_length <= bench.distance)
+		{
+			FinishStreamBenchmark();
+			return;
+		}
+		bench.distance = FMath::Min(bench.distance + FMath::Max(0.0f, stream_benchmark_speed_) * delta_time, bench.path_length);
+		bench.frame_ms.Add(delta_time * 1000.0);
+		++bench.frame_count;
+
+		float segment_start = 0.0f;
+		for (int i = 1; i < bench.path.Num(); ++i)
+		{
+			const auto segment = bench.path[i] - bench.path[i - 1];
+			const float segment_length = segment.Length();
+			if (i == bench.path.Num() - 1 || bench.distance <= segment_start + segment_length)
+			{
+				const float rate = (0.0f < segment_length) ? FMath::Clamp((bench.distance - segment_start) / segment_length, 0.0f, 1.0f) : 1.0f;
+				main2AsyncParam_[0].important_position_ = bench.path[i - 1] + segment * rate;
+				if (0.0f < segment_length)
+					main2AsyncParam_[0].important_forward_ = segment / segment_length;
+				break;
+			}
+			segment_start += segment_length;
+		}
+	}
+	// ベンチマーク結果をログ出力する.
+	void AVoxelEngine::FinishStreamBenchmark()
+	{
+		auto& bench = stream_benchmark_;
+		bench.is_running = false;
+
+		bench.ready_latency_ms.Sort();
+		bench.frame_ms.Sort();
+		const double frame_count = static_cast<double>(FMath::Max(1, bench.frame_count));
+		const auto func_avg_ms = [&bench, frame_count](naga::VoxelEngineStat::Type type) { return static_cast<double>(bench.stat_sum[type]) * 0.001 / frame_count; };
+		const auto func_avg = [&bench, frame_count](naga::VoxelEngineStat::Type type) { return static_cast<double>(bench.stat_sum[type]) / frame_count; };
+		const int worker_count = (0 < async_worker_count_) ? async_worker_count_ : (FTaskGraphInterface::Get().GetNumWorkerThreads() + 1);
+
+		UE_LOG(LogTemp, Display, TEXT("[AVoxelEngine] Stream Benchmark: %.2f [sec], frame %d, stream_in_range %d/%d, stream_out_range %d, worker %d"),
+			FPlatformTime::Seconds() - bench.start_sec, bench.frame_count, stream_in_chunk_range_horizontal, stream_in_chunk_range_vertical, stream_out_chunk_range, worker_count);
+		UE_LOG(LogTemp, Display, TEXT("    Chunk Ready Latency [ms]: count %d, p50 %.2f, p90 %.2f, p99 %.2f, max %.2f, not ready %d"),
+			bench.ready_latency_ms.Num(), CalcSortedPercentile(bench.ready_latency_ms, 50.0), CalcSortedPercentile(bench.ready_latency_ms, 90.0), CalcSortedPercentile(bench.ready_latency_ms, 99.0), CalcSortedPercentile(bench.ready_latency_ms, 100.0), bench.request_sec_map.Num());
+		UE_LOG(LogTemp, Display, TEXT("    Frame [ms]: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f"),
+			CalcSortedPercentile(bench.frame_ms, 50.0), CalcSortedPercentile(bench.frame_ms, 90.0), CalcSortedPercentile(bench.frame_ms, 99.0), CalcSortedPercentile(bench.frame_ms, 100.0));
+		UE_LOG(LogTemp, Display, TEXT("    Per Frame Avg: tick %.3f [ms], sync %.3f [ms], overlap_sync %.3f [ms], mesh_upload %.3f [ms] (%.2f)"),
+			func_avg_ms(naga::VoxelEngineStat::TickMicroSec), func_avg_ms(naga::VoxelEngineStat::SyncMicroSec), func_avg_ms(naga::VoxelEngineStat::OverlapSyncMicroSec), func_avg_ms(naga::VoxelEngineStat::MeshUploadMicroSec), func_avg(naga::VoxelEngineStat::MeshUploadCount));
+		UE_LOG(LogTemp, Display, TEXT("    Per Frame Avg: async %.3f [ms], stream_in %.2f, noise %.3f [ms], lod %.3f [ms], meshing %.3f [ms] (%.2f)"),
+			func_avg_ms(naga::VoxelEngineStat::AsyncMicroSec), func_avg(naga::VoxelEngineStat::StreamInCount), func_avg_ms(naga::VoxelEngineStat::NoiseMicroSec), func_avg_ms(naga::VoxelEngineStat::LodMicroSec), func_avg_ms(naga::VoxelEngineStat::MeshingMicroSec), func_avg(naga::VoxelEngineStat::MeshCount));
+		UE_LOG(LogTemp, Display, TEXT("    Queue Avg: stream_in %.1f, stream_out %.1f, mesh_request %.1f"),
+			func_avg(naga::VoxelEngineStat::StreamInQueueNum), func_avg(naga::VoxelEngineStat::StreamOutQueueNum), func_avg(naga::VoxelEngineStat::MeshRequestNum));
+
+		bench.request_sec_map.Empty();
+
+		if (stream_benchmark_quit_on_finish_)
+		{
+			FPlatformMisc::RequestExit(false);
+		}
+	}
+
+	// チャンクストアに保存したデータをすべて破棄する.
+	void AVoxelEngine::ClearChunkStore()
+	{
+		async_task_.WaitAsyncUpdate();
+
+		// 未初期化の場合もディレクトリを指定して削除.
+		if (!chunk_store_.IsInitialized())
+		{
+			chunk_store_.Initialize(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("VoxelChunkStore"), chunk_store_name_));
+			chunk_store_.Clear();
+			chunk_store_.Finalize();
+		}
+		else
+		{
+			chunk_store_.Clear();
+			// 現在のチャンクは再度保存が必要.
+			for (auto&& it : voxel_chunk_map_)
+			{
+				if (it.Value)
+					it.Value->SetStoreDirtyFlag(true);
+			}
+		}
+		UE_LOG(LogTemp, Display, TEXT("[AVoxelEngine] Clear Chunk Store: %s"), *chunk_store_name_);
+	}
+
+	// 露出面の貪欲マージによるブロック形状のポリゴン生成.
+	// 面の向き毎に露出面のビットマスクをRow単位で計算し, 法線軸のスライス毎に2次元のマスクとして最大の矩形へまとめる.
+	// 1bitVoxelのため材質は単一として扱う.
+	void AVoxelEngine::BuildChunkMeshGreedy_BitCompressionVoxel(const ChunkType& chunk, unsigned int lod_level, naga::VoxelChunkMeshData& out_mesh) const
+	{
+		using RowType = ChunkType::RowType;
+
+		const int chunk_reso = static_cast<int>(ChunkType::CHUNK_RESOLUTION(lod_level));
+		const auto voxel_extent = GetVoxelSize(lod_level);
+		const auto voxel_origin_pos = CalcChunkVoxelMinPosition(chunk.GetId(), FIntVector::ZeroValue, lod_level);
+		// オーバーラップを除いた範囲のマスク (X=0がbit0).
+		const RowType inner_mask = ChunkType::ROW_INNER_MASK(lod_level) >> 1;
+		const auto color = FColor(128, 128, 128, 255);
+
+		// 最下位の有効ビット位置.
+		const auto func_count_trailing_zeros = [](RowType v) -> unsigned int
+		{
+			if constexpr (sizeof(RowType) > sizeof(uint32))
+				return static_cast<unsigned int>(FMath::CountTrailingZeros64(v));
+			else
+				return static_cast<unsigned int>(FMath::CountTrailingZeros(v));
+		};
+
+		// 面の向き毎のスライス単位のマスク. [face][slice][v] のビットuが露出面.
+		// 軸毎の(u,v)は X面:(Y,Z), Y面:(X,Z), Z面:(X,Y).
+		const int plane_size = chunk_reso * chunk_reso;
+		TArray<RowType> face_plane_array;
+		face_plane_array.SetNumZeroed(naga::VoxelChunkFace::Count * plane_size);
+		const auto func_face_plane = [&](int face, int slice) -> RowType*
+		{
+			return face_plane_array.GetData() + face * plane_size + slice * chunk_reso;
+		};
+
+		for (int k = 0; k < chunk_reso; ++k)
+		{
+			for (int j = 0; j < chunk_reso; ++j)
+			{
+				const RowType row_y1z1 = chunk.GetXRowWithOverlap(j + 1, k + 1, lod_level);
+				const RowType solid = (row_y1z1 >> 1) & inner_mask;
+				if (0 == solid)
+					continue;
+
+				// 隣接Voxelが空の面. bit iがチャンク内X=iに対応.
+				const RowType face_px = solid & ~(row_y1z1 >> 2);
+				const RowType face_nx = solid & ~row_y1z1;
+				func_face_plane(naga::VoxelChunkFace::PositiveY, j)[k] = solid & ~(chunk.GetXRowWithOverlap(j + 2, k + 1, lod_level) >> 1);
+				func_face_plane(naga::VoxelChunkFace::NegativeY, j)[k] = solid & ~(chunk.GetXRowWithOverlap(j, k + 1, lod_level) >> 1);
+				func_face_plane(naga::VoxelChunkFace::PositiveZ, k)[j] = solid & ~(chunk.GetXRowWithOverlap(j + 1, k + 2, lod_level) >> 1);
+				func_face_plane(naga::VoxelChunkFace::NegativeZ, k)[j] = solid & ~(chunk.GetXRowWithOverlap(j + 1, k, lod_level) >> 1);
+
+				// X面はRowのビット方向が法線軸となるため, スライスX=i毎の(Y,Z)マスクへ転置する.
+				for (RowType bits = face_px; 0 != bits; bits &= (bits - 1))
+				{
+					func_face_plane(naga::VoxelChunkFace::PositiveX, func_count_trailing_zeros(bits))[k] |= RowType(1) << j;
+				}
+				for (RowType bits = face_nx; 0 != bits; bits &= (bits - 1))
+				{
+					func_face_plane(naga::VoxelChunkFace::NegativeX, func_count_trailing_zeros(bits))[k] |= RowType(1) << j;
+				}
+			}
+		}
+
+		// 矩形追加. slice_pos は法線軸上の面の位置, [u0,u1)x[v0,v1) が矩形範囲 (いずれもVoxel単位).
+		const auto func_add_rect = [&](int axis, bool face_to_positive, int slice_pos, int u0, int u1, int v0, int v1)
+		{
+			const int u_axis = (0 == axis) ? 1 : 0;
+			const int v_axis = (2 == axis) ? 1 : 2;
+			const auto func_pos = [&](int u, int v)
+			{
+				FVector p;
+				p[axis] = slice_pos;
+				p[u_axis] = u;
+				p[v_axis] = v;
+				return voxel_origin_pos + p * voxel_extent;
+			};
+			FVector face_normal = FVector::ZeroVector;
+			face_normal[axis] = face_to_positive ? 1.0f : -1.0f;
+
+			const auto vtx_id0 = out_mesh.vtx.Add(func_pos(u0, v0));
+			const auto vtx_id1 = out_mesh.vtx.Add(func_pos(u1, v0));
+			const auto vtx_id2 = out_mesh.vtx.Add(func_pos(u0, v1));
+			const auto vtx_id3 = out_mesh.vtx.Add(func_pos(u1, v1));
+			for (auto vi = 0u; vi < 4; ++vi)
+			{
+				out_mesh.nor.Add(face_normal);
+				out_mesh.col.Add(color);
+			}
+
+			// 時計回り. u軸とv軸の外積はX,Z面で法線軸の正方向, Y面で負方向.
+			if ((1 != axis) == face_to_positive)
+			{
+				out_mesh.tri.Add(vtx_id0);
+				out_mesh.tri.Add(vtx_id2);
+				out_mesh.tri.Add(vtx_id1);
+				out_mesh.tri.Add(vtx_id1);
+				out_mesh.tri.Add(vtx_id2);
+				out_mesh.tri.Add(vtx_id3);
+			}
+			else
+			{
+				out_mesh.tri.Add(vtx_id0);
+				out_mesh.tri.Add(vtx_id1);
+				out_mesh.tri.Add(vtx_id2);
+				out_mesh.tri.Add(vtx_id1);
+				out_mesh.tri.Add(vtx_id3);
+				out_mesh.tri.Add(vtx_id2);
+			}
+		};
+
+		for (int face = 0; face < naga::VoxelChunkFace::Count; ++face)
+		{
+			const int axis = face >> 1;
+			const bool face_to_positive = 0 != (face & 0x01);
+			for (int slice = 0; slice < chunk_reso; ++slice)
+			{
+				RowType* plane = func_face_plane(face, slice);
+				// 正方向の面はVoxelの+側境界に位置する.
+				const int slice_pos = face_to_positive ? (slice + 1) : slice;
+				for (int v = 0; v < chunk_reso; ++v)
+				{
+					while (0 != plane[v])
+					{
+						// 行内の連続ビット範囲を取得し, 後続の行に同じ範囲が揃っている限りv方向へ伸ばす.
+						const auto u_begin = func_count_trailing_zeros(plane[v]);
+						const auto u_count = func_count_trailing_zeros(static_cast<RowType>(~(plane[v] >> u_begin)));
+						const RowType run = ((RowType(1) << u_count) - 1) << u_begin;
+						int v_end = v + 1;
+						for (; v_end < chunk_reso && run == (plane[v_end] & run); ++v_end)
+						{
+							plane[v_end] &= ~run;
+						}
+						plane[v] &= ~run;
+
+						func_add_rect(axis, face_to_positive, slice_pos, u_begin, u_begin + u_count, v, v_end);
+					}
+				}
+			}
+		}
+	}
+
+	// メッシュ生成のベンチマーク.
+	// ノイズから生成したチャンクでSurfaceNetsの素朴な実装とビット演算版, 貪欲マージ版の生成時間とポリゴン数を比較する.
+	// デバッグキューブ表示は中身のあるVoxel毎に1インスタンス(キューブ1つで12ポリゴン)として比較する.
+	void AVoxelEngine::RunSurfaceNetsBenchmark()
+	{
+		// 地表付近を含むように原点周辺のチャンクを生成.
+		TMap<FIntVector, ChunkType*> bench_chunk_map;
+		const int range_h = FMath::Max(0, benchmark_chunk_range_);
+		for (int k = -1; k <= 1; ++k)
+		{
+			for (int j = -range_h; j <= range_h; ++j)
+			{
+				for (int i = -range_h; i <= range_h; ++i)
+				{
+					const auto chunk_id = FIntVector(i, j, k);
+					auto* chunk = new ChunkType();
+					chunk->SetId(chunk_id);
+					chunk->Allocate();
+					chunk->Fill(false);
+					GenerateChunkFromNoise(*chunk, default_chunk_noise_scale_, 2);
+					chunk->UpdateLod();
+					chunk->SetState(naga::VoxelChunkState::Active);
+
+					bench_chunk_map.Add(chunk_id, chunk);
+				}
+			}
+		}
+		// 近傍からオーバーラップ部を取り込む.
+		for (auto&& e : bench_chunk_map)
+		{
+			for (int nk = -1; nk <= 1; ++nk)
+			{
+				for (int nj = -1; nj <= 1; ++nj)
+				{
+					for (int ni = -1; ni <= 1; ++ni)
+					{
+						if (auto* neighbor = bench_chunk_map.Find(e.Key + FIntVector(ni, nj, nk)))
+						{
+							CopyChunkOverlapFromNeighbor(e.Value, *neighbor, ni, nj, nk);
+						}
 					}
 				}
+			}
+		}
 
-				if (0 < tri.Num())
-					mesh_comp->CreateMeshSection(0, vtx, tri, nor, uv0, col, tan, bCreateCollision);
+		naga::VoxelChunkMeshData mesh_naive;
+		naga::VoxelChunkMeshData mesh_bit;
+		naga::VoxelChunkMeshData mesh_greedy;
+		long long naive_micro_sec = 0;
+		long long bit_micro_sec = 0;
+		long long greedy_micro_sec = 0;
+		int naive_vtx_count = 0;
+		int naive_tri_count = 0;
+		int bit_vtx_count = 0;
+		int bit_tri_count = 0;
+		int greedy_vtx_count = 0;
+		int greedy_tri_count = 0;
+		int cube_instance_count = 0;
+		int mismatch_chunk_count = 0;
+
+		const int iteration_count = FMath::Max(1, benchmark_iteration_count_);
+		for (int iter = 0; iter < iteration_count; ++iter)
+		{
+			for (auto&& e : bench_chunk_map)
+			{
+				mesh_naive.Reset();
+				mesh_bit.Reset();
+				mesh_greedy.Reset();
+
+				const auto naive_start_time = std::chrono::system_clock::now();
+				BuildChunkMeshSurfaceNets_NaiveVoxel(*e.Value, 0, mesh_naive);
+				const auto bit_start_time = std::chrono::system_clock::now();
+				BuildChunkMeshSurfaceNets_BitCompressionVoxel(*e.Value, 0, mesh_bit);
+				const auto bit_end_time = std::chrono::system_clock::now();
+				BuildChunkMeshGreedy_BitCompressionVoxel(*e.Value, 0, mesh_greedy);
+				const auto greedy_end_time = std::chrono::system_clock::now();
+
+				naive_micro_sec += std::chrono::duration_cast<std::chrono::microseconds>(bit_start_time - naive_start_time).count();
+				bit_micro_sec += std::chrono::duration_cast<std::chrono::microseconds>(bit_end_time - bit_start_time).count();
+				greedy_micro_sec += std::chrono::duration_cast<std::chrono::microseconds>(greedy_end_time - bit_end_time).count();
+
+				if (0 == iter)
+				{
+					naive_vtx_count += mesh_naive.vtx.Num();
+					naive_tri_count += mesh_naive.tri.Num() / 3;
+					bit_vtx_count += mesh_bit.vtx.Num();
+					bit_tri_count += mesh_bit.tri.Num() / 3;
+					greedy_vtx_count += mesh_greedy.vtx.Num();
+					greedy_tri_count += mesh_greedy.tri.Num() / 3;
+
+					// デバッグキューブ表示のインスタンス数.
+					const auto chunk_reso = ChunkType::CHUNK_RESOLUTION(0);
+					const auto inner_mask = ChunkType::ROW_INNER_MASK(0);
+					for (auto k = 0u; k < chunk_reso; ++k)
+					{
+						for (auto j = 0u; j < chunk_reso; ++j)
+						{
+							const uint64 solid = e.Value->GetXRowWithOverlap(j + 1, k + 1, 0) & inner_mask;
+							cube_instance_count += static_cast<int>(FMath::CountBits(solid));
+						}
+					}
+
+					// 出力が一致するかチェック. ビット演算版は頂点を共有するため, 三角形の頂点位置で比較する.
+					bool is_match = (mesh_naive.tri.Num() == mesh_bit.tri.Num());
+					for (int ti = 0; is_match && ti < mesh_naive.tri.Num(); ++ti)
+					{
+						is_match = mesh_naive.vtx[mesh_naive.tri[ti]].Equals(mesh_bit.vtx[mesh_bit.tri[ti]], 0.01f);
+					}
+					if (!is_match)
+						++mismatch_chunk_count;
+				}
 			}
 		}
+
+		const int chunk_count = bench_chunk_map.Num();
+		const double sample_count = static_cast<double>(FMath::Max(1, chunk_count * iteration_count));
+		UE_LOG(LogTemp, Display, TEXT("[AVoxelEngine] Mesh Benchmark: chunk %d, iteration %d"), chunk_count, iteration_count);
+		UE_LOG(LogTemp, Display, TEXT("    Naive: %.2f [micro sec/chunk], vtx %d, tri %d"), naive_micro_sec / sample_count, naive_vtx_count, naive_tri_count);
+		UE_LOG(LogTemp, Display, TEXT("    BitCompression: %.2f [micro sec/chunk], vtx %d, tri %d"), bit_micro_sec / sample_count, bit_vtx_count, bit_tri_count);
+		UE_LOG(LogTemp, Display, TEXT("    Speedup: x%.2f, mismatch chunk %d"), static_cast<double>(naive_micro_sec) / static_cast<double>(FMath::Max(1ll, bit_micro_sec)), mismatch_chunk_count);
+		UE_LOG(LogTemp, Display, TEXT("    Greedy: %.2f [micro sec/chunk], vtx %d, tri %d (x%.2f tri of BitCompression)"), greedy_micro_sec / sample_count, greedy_vtx_count, greedy_tri_count,
+			static_cast<double>(greedy_tri_count) / static_cast<double>(FMath::Max(1, bit_tri_count)));
+		UE_LOG(LogTemp, Display, TEXT("    DebugCube: instance %d, tri %d"), cube_instance_count, cube_instance_count * 12);
+
+		for (auto&& e : bench_chunk_map)
+		{
+			delete e.Value;
+		}
+		bench_chunk_map.Empty();
 	}
 
 	// デバッグ用のキューブ描画.
@@ -1408,6 +3547,9 @@ class AVoxelEngine;
 
 			if (naga::VoxelChunkState::Active != find_chunk->GetState())
 				continue;
+			// 圧縮状態のチャンクはAsyncと競合するためここでは展開しない.
+			if (find_chunk->IsCompressed())
+				continue;
 
 			UInstancedStaticMeshComponent* mesh_comp = nullptr;
 			if (auto&& chunk_mesh = chunk_mesh_component_map_.Find(e))
@@ -1451,35 +3593,24 @@ class AVoxelEngine;
 				for (auto j = 0u; j < chunk_reso; ++j)
 				{
 					// Overlap込取得のため +1
-					auto* xrow = find_chunk->GetXRowWithOverlap(j + 1, k + 1, lod_level);
+					const auto xrow = find_chunk->GetXRowWithOverlap(j + 1, k + 1, lod_level);
 
 					// 簡易に境界のみ表示するため近傍Voxelを参照
 					// Overlap込取得で前後を取得
-					auto* xrow0 = find_chunk->GetXRowWithOverlap(j, k + 1, lod_level);
-					auto* xrow1 = find_chunk->GetXRowWithOverlap(j + 2, k + 1, lod_level);
-					auto* xrow2 = find_chunk->GetXRowWithOverlap(j + 1, k, lod_level);
-					auto* xrow3 = find_chunk->GetXRowWithOverlap(j + 1, k + 2, lod_level);
-
-					uint32_t visible_bits = 0;
-
-					for (auto i = 0u; i < chunk_reso; ++i)
-					{
-						const auto x_i_with_overlap = i + 1;
-
-						if (0 < xrow[x_i_with_overlap])
-						{
-							// 各軸の隣接セルがすべて有効な場合は不可視.
-							const auto exist_side_x = xrow[x_i_with_overlap - 1] && xrow[x_i_with_overlap + 1];
-							const auto exist_side_y = xrow0[x_i_with_overlap] && xrow1[x_i_with_overlap];
-							const auto exist_side_z = xrow2[x_i_with_overlap] && xrow3[x_i_with_overlap];
-
-							if (!(exist_side_x && exist_side_y && exist_side_z))
-							{
-								visible_bits |= 0x01 << i;
-								++num_visible_cell;
-							}
-						}
-					}
+					const auto xrow0 = find_chunk->GetXRowWithOverlap(j, k + 1, lod_level);
+					const auto xrow1 = find_chunk->GetXRowWithOverlap(j + 2, k + 1, lod_level);
+					const auto xrow2 = find_chunk->GetXRowWithOverlap(j + 1, k, lod_level);
+					const auto xrow3 = find_chunk->GetXRowWithOverlap(j + 1, k + 2, lod_level);
+
+					// 各軸の隣接セルがすべて有効な場合は不可視. Row単位でまとめて判定する.
+					const auto exist_side_x = (xrow >> 1) & (xrow << 1);
+					const auto exist_side_y = xrow0 & xrow1;
+					const auto exist_side_z = xrow2 & xrow3;
+					const auto visible_bits_with_overlap = xrow & ~(exist_side_x & exist_side_y & exist_side_z) & ChunkType::ROW_INNER_MASK(lod_level);
+
+					// オーバーラップ分をシフトしてX=0をbit0にする.
+					const uint32_t visible_bits = static_cast<uint32_t>(visible_bits_with_overlap >> 1);
+					num_visible_cell += naga::math::BitCount(visible_bits);
 
 					x_row_visible_bits_work.Add(std::tuple<int, int, uint32_t>(j, k, visible_bits));
 				}
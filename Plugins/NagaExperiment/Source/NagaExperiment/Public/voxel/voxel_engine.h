@@ -12,6 +12,13 @@
 
 #include "util/entity_buffer.h"
 #include "util/async_task.h"
+#include "util/math_util.h"
+
+#include "voxel_chunk_codec.h"
+#include "voxel_chunk_index.h"
+#include "voxel_chunk_pool.h"
+#include "voxel_chunk_store.h"
+#include "voxel_chunk_stream_queue.h"
 
 #include "voxel_engine.generated.h"
 
@@ -38,6 +45,42 @@ namespace naga
 			Deletable,
 		};
 	};
+
+	// チャンク内部(オーバーラップを除く)のLOD0の占有状態. 可視判定に使用する.
+	struct VoxelChunkFillState
+	{
+		enum Type : uint8
+		{
+			// 空と中身が混在, または未判定.
+			Mixed,
+			// すべて空.
+			Empty,
+			// すべて中身あり.
+			Solid,
+		};
+	};
+
+	// チャンクの面.
+	struct VoxelChunkFace
+	{
+		enum Type : int
+		{
+			NegativeX,
+			PositiveX,
+			NegativeY,
+			PositiveY,
+			NegativeZ,
+			PositiveZ,
+
+			Count
+		};
+
+		// 面のビットマスク.
+		static constexpr uint32 Bit(Type v)
+		{
+			return 1u << v;
+		}
+	};
 	
 	// LOD情報. 1Voxelオーバーラップ有り
 	template<unsigned int COUNT_X, unsigned int COUNT_Y, unsigned int COUNT_Z>
@@ -79,6 +122,11 @@ namespace naga
 				// 両端で1Voxelオーバーラップするため +2 している.
 				return ((COUNT_X + 2)*(COUNT_Y + 2)*(COUNT_Z + 2)) + CalcLodVoixelCount<CalcDiv2<COUNT_X>::eval(), CalcDiv2<COUNT_Y>::eval(), CalcDiv2<COUNT_Z>::eval()>::TotalElementCount();
 			}
+			static constexpr unsigned int TotalRowCount()
+			{
+				// X軸Row単位の数. オーバーラップ分を含む.
+				return ((COUNT_Y + 2)*(COUNT_Z + 2)) + CalcLodVoixelCount<CalcDiv2<COUNT_X>::eval(), CalcDiv2<COUNT_Y>::eval(), CalcDiv2<COUNT_Z>::eval()>::TotalRowCount();
+			}
 		};
 		template<>
 		struct CalcLodVoixelCount<1, 1, 1>
@@ -89,7 +137,12 @@ namespace naga
 			}
 			static constexpr unsigned int TotalElementCount()
 			{
-				return 1;
+				// 最大LODもオーバーラップ込で3x3x3.
+				return 3 * 3 * 3;
+			}
+			static constexpr unsigned int TotalRowCount()
+			{
+				return 3 * 3;
 			}
 		};
 
@@ -104,13 +157,20 @@ namespace naga
 			// 両端で1Voxelオーバーラップするため +2 している.
 			return ((COUNT_X + 2)*(COUNT_Y + 2)*(COUNT_Z + 2)) + CalcLodVoixelCount<CalcDiv2<COUNT_X>::eval(), CalcDiv2<COUNT_Y>::eval(), CalcDiv2<COUNT_Z>::eval()>::TotalElementCount();
 		}
+		// LODを含めたX軸Rowの全数.
+		static constexpr unsigned int TotalRowCount()
+		{
+			return ((COUNT_Y + 2)*(COUNT_Z + 2)) + CalcLodVoixelCount<CalcDiv2<COUNT_X>::eval(), CalcDiv2<COUNT_Y>::eval(), CalcDiv2<COUNT_Z>::eval()>::TotalRowCount();
+		}
 
 		CalcLodOverlapedVoixelInfo()
 		{
 			unsigned int count = 0;
+			unsigned int row_count = 0;
 			for (unsigned int i = 0; i < std::size(offsets_); ++i)
 			{
 				offsets_[i] = count;
+				row_offsets_[i] = row_count;
 				resolution_x_[i] = std::max(1u, COUNT_X >> i);
 				resolution_y_[i] = std::max(1u, COUNT_Y >> i);
 				resolution_z_[i] = std::max(1u, COUNT_Z >> i);
@@ -121,6 +181,10 @@ namespace naga
 				// カウントにはオーバーラップ分を追加.
 				counts_[i] = ((resolution_x_overlap_[i]) * (resolution_y_overlap_[i]) * (resolution_z_overlap_[i]));
 				count += counts_[i];
+
+				// X軸Row単位の数. 
+				row_counts_[i] = ((resolution_y_overlap_[i]) * (resolution_z_overlap_[i]));
+				row_count += row_counts_[i];
 			}
 		}
 
@@ -129,6 +193,11 @@ namespace naga
 		// LOD毎の要素数
 		unsigned int counts_[LodCount()];
 
+		// LOD毎のX軸Row単位のオフセット
+		unsigned int row_offsets_[LodCount()];
+		// LOD毎のX軸Row数
+		unsigned int row_counts_[LodCount()];
+
 		// オーバーラップ無しのLOD毎の解像度数
 		unsigned int resolution_x_overlap_[LodCount()];
 		unsigned int resolution_y_overlap_[LodCount()];
@@ -239,6 +308,46 @@ namespace naga
 			return &cells_.GetData()[index + lod_info_.offsets_[lod]];
 		}
 
+		// LOD0から全LODを再生成する.
+		// LODは上位LODの2x2x2の最大値とする.
+		void UpdateLod()
+		{
+			for (auto lod = 1u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto parent_lod = lod - 1;
+				const auto reso = CHUNK_RESOLUTION(lod);
+
+				for (auto lk = 0u; lk < reso; ++lk)
+				{
+					for (auto lj = 0u; lj < reso; ++lj)
+					{
+						auto* child_row = GetXRow(lj, lk, lod);
+
+						const auto parent_lk_base = lk * 2;
+						const auto parent_lj_base = lj * 2;
+
+						const auto* parent_row0 = GetXRow(parent_lj_base, parent_lk_base, parent_lod);
+						const auto* parent_row1 = GetXRow(parent_lj_base + 1, parent_lk_base, parent_lod);
+						const auto* parent_row2 = GetXRow(parent_lj_base, parent_lk_base + 1, parent_lod);
+						const auto* parent_row3 = GetXRow(parent_lj_base + 1, parent_lk_base + 1, parent_lod);
+
+						for (auto li = 0u; li < reso; ++li)
+						{
+							const auto parent_li_base = li * 2;
+
+							// 現状のLODは上位の最大値を入れておく
+							const auto pvmax0 = FMath::Max(parent_row0[parent_li_base], parent_row0[parent_li_base + 1]);
+							const auto pvmax1 = FMath::Max(parent_row1[parent_li_base], parent_row1[parent_li_base + 1]);
+							const auto pvmax2 = FMath::Max(parent_row2[parent_li_base], parent_row2[parent_li_base + 1]);
+							const auto pvmax3 = FMath::Max(parent_row3[parent_li_base], parent_row3[parent_li_base + 1]);
+
+							child_row[li] = FMath::Max(FMath::Max(pvmax0, pvmax1), FMath::Max(pvmax2, pvmax3));
+						}
+					}
+				}
+			}
+		}
+
 		VoxelChunkState::Type GetState() const
 		{
 			return state_.load(std::memory_order_acquire);
@@ -519,124 +628,1227 @@ namespace naga
 	// LOD情報
 	template<typename DATA_TYPE, unsigned int RESOLUTION, bool DEBUG_RANGE_CHECK>
 	const CalcLodOverlapedVoixelInfo<RESOLUTION, RESOLUTION, RESOLUTION> SimpleOverlapBothVoxelChunkT<DATA_TYPE, RESOLUTION, DEBUG_RANGE_CHECK>::lod_info_ = {};
-	
-}
-
-
-// 非同期タスク.
-//	寿命はオーナーのAVoxelEngineが管理する.
-class VoxelEngineAsyncTask : public naga::FAsyncTaskBase
-{
-public:
-	VoxelEngineAsyncTask();
-	~VoxelEngineAsyncTask();
-
-	bool Initialize(AVoxelEngine* owner);
-	void Finalize();
-
-private:
-	// 非同期実行関数
-	void AsyncUpdate() override;
-private:
-	AVoxelEngine* owner_ = nullptr;
-};
 
-// Actor.
-UCLASS()
-class AVoxelEngine : public AActor
-{
-	GENERATED_BODY()
-	
-	friend class VoxelEngineAsyncTask;
 
-	// 1byteボクセル. 可能なら1bitvoxelまで圧縮できると良いかも.
-	using ChunkType = naga::SimpleOverlapBothVoxelChunkT<unsigned char, 16, true>;
+	// 1bitVoxel版.
+	// SimpleOverlapBothVoxelChunkTと同様に両端1Voxelオーバーラップ方式だが, オーバーラップを含むX軸Rowを1ワードのビット列として格納する.
+	// Rowのビット位置はオーバーラップ込のX座標に対応する (bit0 : -X側オーバーラップ, bit[RESOLUTION+1] : +X側オーバーラップ).
+	// SurfaceNets等のRow単位のビット演算でそのまま利用できる.
+	template<unsigned int RESOLUTION = 16, bool DEBUG_RANGE_CHECK = false>
+	struct SimpleOverlapBothBitVoxelChunkT
+	{
+		static_assert(64 >= (RESOLUTION + 2), "RESOLUTION + Overlap must fit in 64bit row.");
 
-public:
-	AVoxelEngine();
-	~AVoxelEngine();
+		// オーバーラップ込のRowが格納できる最小のワード型.
+		using RowType = typename std::conditional<(32 >= (RESOLUTION + 2)), uint32_t, uint64_t>::type;
+		static constexpr unsigned int ROW_BIT_WIDTH = sizeof(RowType) * 8;
 
-protected:
-	virtual void BeginPlay() override;
-	virtual void EndPlay(EEndPlayReason::Type reason) override;
+		// LOD情報.
+		using LodInfoType = CalcLodOverlapedVoixelInfo<RESOLUTION, RESOLUTION, RESOLUTION>;
+		static const LodInfoType lod_info_;
 
-public:
-	virtual void OnConstruction(const FTransform& transform) override;
-	virtual void Tick(float DeltaTime) override;
+		static const unsigned int CHUNK_RESOLUTION_BASE = RESOLUTION;
 
-	// EditorMode Tick Enable.
-	virtual bool ShouldTickIfViewportsOnly() const override;
+		// オーバーラップを含まないチャンク基準解像度
+		static constexpr unsigned int CHUNK_RESOLUTION(unsigned int lod = 0)
+		{
+			if (DEBUG_RANGE_CHECK)
+			{
+				if (LOD_COUNT() <= lod)
+				{
+					assert(LOD_COUNT() > lod);
+					return 0;
+				}
+			}
+			return RESOLUTION >> lod;
+		}
 
-	float GetVoxelSize(unsigned int lod = 0) const;
-	FVector CalcChunkVoxelMinPosition(const FIntVector& chunk, const FIntVector& pos, unsigned int lod = 0) const;
-	FVector CalcChunkVoxelCenterPosition(const FIntVector& chunk, const FIntVector& pos, unsigned int lod = 0) const;
+		// オーバーラップを含むチャンク基準解像度
+		static constexpr unsigned int CHUNK_RESOLUTION_WITH_OVERLAP(unsigned int lod = 0)
+		{
+			// 前後のオーバーラップ分を含む.
+			return CHUNK_RESOLUTION(lod) + 2;
+		}
 
-private:
-	// 完全に破棄
-	void FinalizeVoxel();
+		// Lod数
+		static constexpr unsigned int LOD_COUNT()
+		{
+			return LodInfoType::LodCount();
+		}
+		// 最大LODインデックス
+		static constexpr unsigned int LOD_MAX_INDEX()
+		{
+			return LOD_COUNT() - 1;
+		}
 
-	UInstancedStaticMeshComponent* GetChunkMeshComponentFromPool();
-	void RestoreChunkMeshComponentToPool(UInstancedStaticMeshComponent* comp);
+		// オーバーラップ部を除いたRowのビットマスク(オーバーラップ込のビット位置).
+		static constexpr RowType ROW_INNER_MASK(unsigned int lod = 0)
+		{
+			return ((RowType(1) << CHUNK_RESOLUTION(lod)) - 1) << 1;
+		}
+		// オーバーラップ部を含むRowのビットマスク.
+		static constexpr RowType ROW_FULL_MASK(unsigned int lod = 0)
+		{
+			// Rowがワード幅ちょうどの場合はワード幅のシフトが未定義となるため全ビットとする.
+			return (sizeof(RowType) * 8 <= CHUNK_RESOLUTION_WITH_OVERLAP(lod)) ? ~RowType(0) : ((RowType(1) << CHUNK_RESOLUTION_WITH_OVERLAP(lod)) - 1);
+		}
 
+		// LOD込のRow総数.
+		static constexpr unsigned int TOTAL_ROW_COUNT = LodInfoType::TotalRowCount();
+		static constexpr unsigned int ROWS_BYTE_SIZE = sizeof(RowType) * TOTAL_ROW_COUNT;
 
-	//void UpdateStreamInChunk(const TArray<FIntVector>& chunk_id_array);
-	//void UpdateStreamOutChunk(const TArray<FIntVector>& chunk_id_array);
-	void UpdateRenderChunk(const TArray<FIntVector>& render_dirty_chunk_id_array);
+		// 全Row(Voxel本体)の確保先. サイズ固定のためブロックプールから確保し, 解放したブロックは再利用する.
+		static VoxelFixedBlockPool& GetRowsPool()
+		{
+			static VoxelFixedBlockPool pool(ROWS_BYTE_SIZE, 64);
+			return pool;
+		}
 
-	// デバッグ用のキューブ描画.
-	void UpdateRenderChunkDebugCube(const TArray<FIntVector>& render_dirty_chunk_id_array);
-	// SurfaceNetsによるポリゴン生成.
-	void UpdateRenderChunkSurfaceNets_NaiveVoxel(const TArray<FIntVector>& render_dirty_chunk_id_array);
+		SimpleOverlapBothBitVoxelChunkT()
+		{
+		}
+		~SimpleOverlapBothBitVoxelChunkT()
+		{
+			ReleaseRows();
+		}
+		SimpleOverlapBothBitVoxelChunkT(const SimpleOverlapBothBitVoxelChunkT&) = delete;
+		SimpleOverlapBothBitVoxelChunkT& operator=(const SimpleOverlapBothBitVoxelChunkT&) = delete;
 
-	void SyncUpdate();
-	void AsyncUpdate();
+		// 確保.
+		void Allocate()
+		{
+			if (!rows_)
+				rows_ = static_cast<RowType*>(GetRowsPool().Allocate());
+		}
+		// Voxel本体をプールへ戻し, 状態を生成直後に戻す. チャンクオブジェクトの再利用時に使用する.
+		void Release()
+		{
+			ReleaseRows();
+			compressed_rows_.Empty();
+			id_ = FIntVector::ZeroValue;
+			current_lod_level_ = 0;
+			edge_voxel_changed_ = 0;
+			neighbor_changed_ = 0;
+			overlap_sync_epoch_ = 0;
+			overlap_source_index_ = -1;
+			any_voxel_changed_ = false;
+			store_dirty_ = false;
+			fill_state_ = VoxelChunkFillState::Mixed;
+			state_.store(VoxelChunkState::Empty, std::memory_order_release);
+		}
+		// 確保サイズ. 圧縮状態の場合は圧縮データのサイズ.
+		unsigned int GetAllocatedSize() const
+		{
+			return ((rows_) ? ROWS_BYTE_SIZE : 0) + compressed_rows_.GetAllocatedSize();
+		}
+		// 値で埋める
+		void Fill(bool v)
+		{
+			memset(rows_, (v) ? ~0u : 0u, ROWS_BYTE_SIZE);
+		}
 
-private:
-	void GenerateChunkFromNoise(ChunkType& out_chunk, float default_chunk_gen_noise_scale, int noise_octave_count) const;
+		// -----------------------------------------------------------------------------
+		// 圧縮状態での常駐.
+		// 全LODのオーバーラップを含む全RowをVoxelRowCodecで圧縮して保持し, 展開状態のRowを解放する.
+		// 圧縮状態ではVoxelへのアクセスは不可. メッシュ生成や編集の前にDecompressする.
+		bool IsCompressed() const
+		{
+			return 0 < compressed_rows_.Num();
+		}
+		// 圧縮. 既に圧縮状態の場合は何もしない.
+		void Compress()
+		{
+			if (IsCompressed() || !rows_)
+				return;
+			VoxelRowCodec::Encode(rows_, TOTAL_ROW_COUNT, CHUNK_RESOLUTION_WITH_OVERLAP(0), compressed_rows_);
+			compressed_rows_.Shrink();
+			ReleaseRows();
+		}
+		// 展開. 圧縮状態でない場合は何もしない.
+		void Decompress()
+		{
+			if (!IsCompressed())
+				return;
+			Allocate();
+			const bool result = VoxelRowCodec::Decode(compressed_rows_.GetData(), compressed_rows_.Num(), rows_, TOTAL_ROW_COUNT, CHUNK_RESOLUTION_WITH_OVERLAP(0));
+			assert(result);
+			compressed_rows_.Empty();
+		}
 
-private:
-	// メインスレッドで変更してAsyncへ読み取るパラメータ
-	struct Main2AsyncParam
-	{
-		FVector									important_position_ = FVector::ZeroVector;
-		FVector									important_position_prev_ = FVector::ZeroVector;
-	};
-	Main2AsyncParam main2AsyncParam_[2];
+		// オーバラップ込みのX軸Rowを取得
+		RowType& GetXRowWithOverlap(unsigned int y, unsigned int z, unsigned int lod = 0)
+		{
+			const unsigned int index = y + lod_info_.resolution_y_overlap_[lod] * z;
+			return rows_[index + lod_info_.row_offsets_[lod]];
+		}
+		const RowType& GetXRowWithOverlap(unsigned int y, unsigned int z, unsigned int lod = 0) const
+		{
+			const unsigned int index = y + lod_info_.resolution_y_overlap_[lod] * z;
+			return rows_[index + lod_info_.row_offsets_[lod]];
+		}
+		// オーバラップを含まないX軸Rowを取得. bit0がX=0に対応する.
+		// -1でオーバーラップ部へアクセスするために符号付き引数としている.
+		RowType GetXRow(int y, int z, unsigned int lod = 0) const
+		{
+			return (GetXRowWithOverlap(y + 1, z + 1, lod) & ROW_INNER_MASK(lod)) >> 1;
+		}
+		// オーバラップを含まないX軸Rowを設定. bit0がX=0に対応する. X方向のオーバーラップ部は保持される.
+		void SetXRow(RowType v, int y, int z, unsigned int lod = 0)
+		{
+			auto& row = GetXRowWithOverlap(y + 1, z + 1, lod);
+			row = (row & ~ROW_INNER_MASK(lod)) | ((v << 1) & ROW_INNER_MASK(lod));
+		}
+		// 全Row. 圧縮状態では空.
+		TConstArrayView<RowType> GetRows() const
+		{
+			return (rows_) ? TConstArrayView<RowType>(rows_, TOTAL_ROW_COUNT) : TConstArrayView<RowType>();
+		}
 
-	long long									async_micro_sec_ = {};
+		// 単一Voxel取得. オーバーラップ部へアクセスするために符号付き引数としている.
+		bool Get(int x, int y, int z, unsigned int lod = 0) const
+		{
+			return 0 != ((GetXRowWithOverlap(y + 1, z + 1, lod) >> (x + 1)) & RowType(1));
+		}
+		// 読み取り用の全Row. 圧縮状態の場合はscratch_rowsへ展開したものを返す.
+		// チャンク自体は変更しないため, 並列の読み取り(RayCast等)で使用する.
+		const RowType* GetRowsForRead(TArray<RowType>& scratch_rows) const
+		{
+			if (!IsCompressed())
+				return rows_;
+			scratch_rows.SetNumUninitialized(TOTAL_ROW_COUNT, EAllowShrinking::No);
+			const bool result = VoxelRowCodec::Decode(compressed_rows_.GetData(), compressed_rows_.Num(), scratch_rows.GetData(), TOTAL_ROW_COUNT, CHUNK_RESOLUTION_WITH_OVERLAP(0));
+			assert(result);
+			return scratch_rows.GetData();
+		}
+		// GetRowsForReadで取得したRowから単一Voxel取得.
+		static bool GetFromRows(const RowType* rows, int x, int y, int z, unsigned int lod = 0)
+		{
+			const unsigned int index = (y + 1) + lod_info_.resolution_y_overlap_[lod] * (z + 1);
+			return 0 != ((rows[index + lod_info_.row_offsets_[lod]] >> (x + 1)) & RowType(1));
+		}
+		// 単一Voxel設定. オーバーラップ部へアクセスするために符号付き引数としている.
+		void Set(bool v, int x, int y, int z, unsigned int lod = 0)
+		{
+			auto& row = GetXRowWithOverlap(y + 1, z + 1, lod);
+			const auto bit = RowType(1) << (x + 1);
+			row = (v) ? (row | bit) : (row & ~bit);
+		}
 
-	float										async_fast_terminate_sec_ = (1.0f / 60.0f) * 0.8f;// 非同期処理を適当な時間内に切り上げる
-	//float										async_fast_terminate_sec_ = 1000.0f;// 非同期処理が完全に終了するまで走らせる.
+		// LOD0から全LODを再生成する.
+		// LODは上位LODの2x2x2の最大値(論理和)とする. Row単位のビット演算で処理する.
+		void UpdateLod()
+		{
+			UpdateLodRegion(FIntVector::ZeroValue, FIntVector(RESOLUTION - 1));
+		}
+		// LOD0の変更範囲[dirty_min, dirty_max]を含む上位LODのVoxelのみ再生成する. 座標はオーバーラップを含まない.
+		// X方向はRow単位でまとめて処理するため, 限定するのはY,Z方向の範囲のみ.
+		void UpdateLodRegion(const FIntVector& dirty_min, const FIntVector& dirty_max)
+		{
+			const FIntVector region_min(FMath::Max(dirty_min.X, 0), FMath::Max(dirty_min.Y, 0), FMath::Max(dirty_min.Z, 0));
+			const FIntVector region_max(FMath::Min<int>(dirty_max.X, RESOLUTION - 1), FMath::Min<int>(dirty_max.Y, RESOLUTION - 1), FMath::Min<int>(dirty_max.Z, RESOLUTION - 1));
+			if (region_min.X > region_max.X || region_min.Y > region_max.Y || region_min.Z > region_max.Z)
+				return;
 
-public:
-	// どれくらい離れたチャンクまでストリームインするか(水平面)
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	int										stream_in_chunk_range_horizontal		= 3;
-	// どれくらい離れたチャンクまでストリームインするか(高さ方向)
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	int										stream_in_chunk_range_vertical			= 2;
+			for (auto lod = 1u; lod < LOD_COUNT(); ++lod)
+			{
+				// 解像度が2の冪でない場合は上位LODの端が切り捨てられるため範囲を制限する.
+				const unsigned int reso = CHUNK_RESOLUTION(lod);
+				const unsigned int lj_begin = FMath::Min<unsigned int>(region_min.Y >> lod, reso - 1);
+				const unsigned int lj_end = FMath::Min<unsigned int>(region_max.Y >> lod, reso - 1);
+				const unsigned int lk_begin = FMath::Min<unsigned int>(region_min.Z >> lod, reso - 1);
+				const unsigned int lk_end = FMath::Min<unsigned int>(region_max.Z >> lod, reso - 1);
+				for (auto lk = lk_begin; lk <= lk_end; ++lk)
+				{
+					ReduceLodRows(lod, lk, lj_begin, lj_end);
+				}
+			}
+		}
 
-	// どれくらい離れたチャンクをストリームアウトするか
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	int									stream_out_chunk_range					= 4;
+		// -----------------------------------------------------------------------------
+		// 永続化用のVoxelデータ.
+		// LOD0のオーバーラップを含まないRowのみVoxelRowCodecで圧縮して格納する. LODは読み込み時に再生成し, オーバーラップ部は近傍チャンクからコピーする.
+		// 圧縮状態では呼び出し不可.
+		struct VoxelDataHeader
+		{
+			uint32	resolution = RESOLUTION;
+			uint32	row_byte_size = sizeof(RowType);
+			uint32	version = 2;
+		};
+		// Voxelデータを書き出し.
+		void WriteVoxelData(TArray<uint8>& out_data) const
+		{
+			assert(!IsCompressed());
+			constexpr auto row_count = CHUNK_RESOLUTION_BASE * CHUNK_RESOLUTION_BASE;
+			RowType inner_rows[row_count];
+			for (auto k = 0u; k < CHUNK_RESOLUTION_BASE; ++k)
+			{
+				for (auto j = 0u; j < CHUNK_RESOLUTION_BASE; ++j)
+				{
+					inner_rows[j + k * CHUNK_RESOLUTION_BASE] = GetXRow(j, k, 0);
+				}
+			}
 
-	// LOD0のVoxelサイズ.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	float									voxel_size_ = 100.0f;
+			const VoxelDataHeader header = {};
+			out_data.SetNumUninitialized(sizeof(header));
+			memcpy(out_data.GetData(), &header, sizeof(header));
+			VoxelRowCodec::Encode(inner_rows, row_count, CHUNK_RESOLUTION_BASE, out_data);
+		}
+		// Voxelデータを読み込み, LODを再生成. 形式が異なる場合はfalse.
+		bool ReadVoxelData(const TArray<uint8>& data)
+		{
+			assert(!IsCompressed());
+			constexpr auto row_count = CHUNK_RESOLUTION_BASE * CHUNK_RESOLUTION_BASE;
+			const VoxelDataHeader expect_header = {};
+			if (sizeof(expect_header) > data.Num())
+				return false;
+
+			VoxelDataHeader header;
+			memcpy(&header, data.GetData(), sizeof(header));
+			if (expect_header.resolution != header.resolution || expect_header.row_byte_size != header.row_byte_size || expect_header.version != header.version)
+				return false;
+
+			RowType inner_rows[row_count];
+			if (!VoxelRowCodec::Decode(data.GetData() + sizeof(header), data.Num() - sizeof(header), inner_rows, row_count, CHUNK_RESOLUTION_BASE))
+				return false;
+
+			for (auto k = 0u; k < CHUNK_RESOLUTION_BASE; ++k)
+			{
+				for (auto j = 0u; j < CHUNK_RESOLUTION_BASE; ++j)
+				{
+					SetXRow(inner_rows[j + k * CHUNK_RESOLUTION_BASE], j, k, 0);
+				}
+			}
+			UpdateLod();
+			return true;
+		}
 
-private:
+		VoxelChunkState::Type GetState() const
+		{
+			return state_.load(std::memory_order_acquire);
+		}
+		void SetState(VoxelChunkState::Type v)
+		{
+			state_.store(v, std::memory_order_release);
+		};
 
-	// メインのHashMap
-	TMap<FIntVector, ChunkType*>			voxel_chunk_map_;
+		FIntVector GetId() const
+		{
+			return id_;
+		}
+		void SetId(const FIntVector& v)
+		{
+			id_ = v;
+		}
 
-	// ------------------------------------------------------------------------------------------------------------------------------------------
-	// InstancedMeshで可視化する場合
-	UPROPERTY()
-	UStaticMesh*										voxel_mesh_ = nullptr; // デバッグ表示用メッシュアセット
+		unsigned int GetCurrentLodLevel() const
+		{
+			return current_lod_level_;
+		}
+		void SetCurrentLodLevel(const unsigned int v)
+		{
+			current_lod_level_ = FMath::Min(v, LOD_MAX_INDEX());
+		}
 
-	// マテリアル
-	UPROPERTY(EditAnywhere)
-	UMaterialInterface*									material_;
+		// -----------------------------------------------------------------------------
+		void SetAnyVoxelChangeFlag(bool v)
+		{
+			any_voxel_changed_ = v;
+		}
+		bool GetAnyVoxelChangeFlag() const
+		{
+			return any_voxel_changed_;
+		}
+		// ストアへ未保存の変更があるか.
+		void SetStoreDirtyFlag(bool v)
+		{
+			store_dirty_ = v;
+		}
+		bool GetStoreDirtyFlag() const
+		{
+			return store_dirty_;
+		}
+		// 占有状態. Voxel変更後にUpdateFillStateで更新する.
+		VoxelChunkFillState::Type GetFillState() const
+		{
+			return fill_state_;
+		}
+		// LOD0のRowから占有状態を更新する.
+		void UpdateFillState()
+		{
+			constexpr RowType inner_mask = ROW_INNER_MASK(0);
+			RowType any_bits = 0;
+			RowType all_bits = inner_mask;
+			for (auto k = 0u; k < RESOLUTION; ++k)
+			{
+				for (auto j = 0u; j < RESOLUTION; ++j)
+				{
+					const RowType row = GetXRowWithOverlap(j + 1, k + 1, 0);
+					any_bits |= row;
+					all_bits &= row;
+				}
+			}
+			if (0 == (any_bits & inner_mask))
+				fill_state_ = VoxelChunkFillState::Empty;
+			else if (inner_mask == all_bits)
+				fill_state_ = VoxelChunkFillState::Solid;
+			else
+				fill_state_ = VoxelChunkFillState::Mixed;
+		}
+		// -----------------------------------------------------------------------------
+		// クリア
+		uint32_t GetEdgeKindBit(int dir_x, int dir_y, int dir_z) const
+		{
+			const auto x_shift = std::min(std::max(dir_x + 1, 0), 2);
+			const auto y_shift = std::min(std::max(dir_y + 1, 0), 2) * (3);
+			const auto z_shift = std::min(std::max(dir_z + 1, 0), 2) * (3 * 3);
+			const auto shift = x_shift + y_shift + z_shift;
+			return (0x01 << shift);
+		}
+
+		void ClearEdgeVoxelChangeFlag(unsigned int v = 0)
+		{
+			auto max_bit = GetEdgeKindBit(1, 1, 1);
+			// 0,0,0 に対応するbitは無効.
+			auto unused_bit = GetEdgeKindBit(0, 0, 0);
+			// 利用する最大ビット範囲と無効ビット(0,0,0 に対応)は常に0になるようにクリア.
+			auto enable_mask = ((max_bit << 1) - 1) & (~unused_bit);
+			edge_voxel_changed_ = v & enable_mask;
+		}
+		// このチャンク自体の各方向のエッジ部変更状態
+		// dir_x: [-1, 0, +1], dir_y: [-1, 0, +1], dir_z: [-1, 0, +1]
+		void SetEdgeVoxelChangeFlag(int dir_x, int dir_y, int dir_z)
+		{
+			edge_voxel_changed_ |= (GetEdgeKindBit(dir_x, dir_y, dir_z));
+		}
+		// このチャンク自体の各方向のエッジ部変更状態
+		// dir_x: [-1, 0, +1], dir_y: [-1, 0, +1], dir_z: [-1, 0, +1]
+		bool GetEdgeVoxelChangeFlag(int dir_x, int dir_y, int dir_z) const
+		{
+			return (edge_voxel_changed_ & (GetEdgeKindBit(dir_x, dir_y, dir_z)));
+		}
+		// このチャンク自体の各方向のエッジ部変更状態
+		bool GetAnyEdgeVoxelChangeFlag() const
+		{
+			return 0 != edge_voxel_changed_;
+		}
+		// 変更前の全Rowと比較し, 変更が近傍チャンクとオーバーラップするエッジ部に及んだ方向の変更フラグをセットする.
+		// 各LODのオーバーラップは近傍チャンクの同一LODからコピーされるため全LODを比較する.
+		void SetEdgeVoxelChangeFlagFromDiff(const TArray<RowType>& prev_rows)
+		{
+			assert(prev_rows.Num() == TOTAL_ROW_COUNT);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const int reso = CHUNK_RESOLUTION(lod);
+				for (int k = 0; k < reso; ++k)
+				{
+					for (int j = 0; j < reso; ++j)
+					{
+						const auto row_index = (j + 1) + lod_info_.resolution_y_overlap_[lod] * (k + 1) + lod_info_.row_offsets_[lod];
+						const RowType diff = (rows_[row_index] ^ prev_rows[row_index]) & ROW_INNER_MASK(lod);
+						if (0 == diff)
+							continue;
+
+						// 各軸で変更が及ぶ方向の範囲. 0方向は常に含む.
+						const int dir_x_min = (diff & (RowType(1) << 1)) ? -1 : 0;
+						const int dir_x_max = (diff & (RowType(1) << reso)) ? 1 : 0;
+						const int dir_y_min = (0 == j) ? -1 : 0;
+						const int dir_y_max = (reso - 1 == j) ? 1 : 0;
+						const int dir_z_min = (0 == k) ? -1 : 0;
+						const int dir_z_max = (reso - 1 == k) ? 1 : 0;
+						for (int dir_z = dir_z_min; dir_z <= dir_z_max; ++dir_z)
+						{
+							for (int dir_y = dir_y_min; dir_y <= dir_y_max; ++dir_y)
+							{
+								for (int dir_x = dir_x_min; dir_x <= dir_x_max; ++dir_x)
+								{
+									if (0 != dir_x || 0 != dir_y || 0 != dir_z)
+										SetEdgeVoxelChangeFlag(dir_x, dir_y, dir_z);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		// クリア
+		void ClearNeighborChunkChangeFlag(unsigned int v = 0)
+		{
+			auto max_bit = GetEdgeKindBit(1, 1, 1);
+			// 0,0,0 に対応するbitは無効.
+			auto unused_bit = GetEdgeKindBit(0, 0, 0);
+			// 利用する最大ビット範囲と無効ビット(0,0,0 に対応)は常に0になるようにクリア.
+			auto enable_mask = ((max_bit << 1) - 1) & (~unused_bit);
+			neighbor_changed_ = v & enable_mask;
+		}
+		// このチャンクからみて各方向の近傍チャンクのオーバーラップ部変更状態
+		// dir_x: [-1, 0, +1], dir_y: [-1, 0, +1], dir_z: [-1, 0, +1]
+		void SetNeighborChunkChangeFlag(int dir_x, int dir_y, int dir_z)
+		{
+			neighbor_changed_ |= (GetEdgeKindBit(dir_x, dir_y, dir_z));
+		}
+		// このチャンクからみて各方向の近傍チャンクのオーバーラップ部変更状態
+		// dir_x: [-1, 0, +1], dir_y: [-1, 0, +1], dir_z: [-1, 0, +1]
+		bool GetNeighborChunkChangeFlag(int dir_x, int dir_y, int dir_z) const
+		{
+			return (neighbor_changed_ & (GetEdgeKindBit(dir_x, dir_y, dir_z)));
+		}
+		// このチャンクからみて各方向の近傍チャンクのオーバーラップ部変更状態
+		bool GetAnyNeighborChunkChangeFlag() const
+		{
+			return 0 != neighbor_changed_;
+		}
+		// オーバーラップ同期のソースとしての登録. 同期回sync_epochで登録済みであればスナップショット内の位置を返し, 未登録であればnew_indexで登録する.
+		int RegisterOverlapSource(uint32_t sync_epoch, int new_index)
+		{
+			if (overlap_sync_epoch_ != sync_epoch)
+			{
+				overlap_sync_epoch_ = sync_epoch;
+				overlap_source_index_ = new_index;
+			}
+			return overlap_source_index_;
+		}
+		// -----------------------------------------------------------------------------
+
+
+		// -----------------------------------------------------------------------------
+		// オーバーラップ部のコピーは全LODに対して実行する. 各LODは自身のLOD0から生成されているため近傍チャンクの同一LODの端をコピーすればよい.
+		// 
+		// face_sign:	false	-> 自身の-X面へsrcの+X面をコピー
+		//				true	-> 自身の+X面へsrcの-X面をコピー
+		template<bool FACE_SIGN>
+		void CopyOverlapFromSrcEdgeX(const SimpleOverlapBothBitVoxelChunkT* src)
+		{
+			assert(src);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				const auto dst_i = (FACE_SIGN) ? reso + 1 : 0;
+				const auto src_i = (FACE_SIGN) ? 1 : reso;
+				for (auto k = 0u; k < reso; ++k)
+				{
+					for (auto j = 0u; j < reso; ++j)
+					{
+						CopyRowBit(GetXRowWithOverlap(j + 1, k + 1, lod), dst_i, src->GetXRowWithOverlap(j + 1, k + 1, lod), src_i);
+					}
+				}
+			}
+		}
+		// face_sign:	false	-> 自身の-Y面へsrcの+Y面をコピー
+		//				true	-> 自身の+Y面へsrcの-Y面をコピー
+		template<bool FACE_SIGN>
+		void CopyOverlapFromSrcEdgeY(const SimpleOverlapBothBitVoxelChunkT* src)
+		{
+			assert(src);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				const auto dst_j = (FACE_SIGN) ? reso + 1 : 0;
+				const auto src_j = (FACE_SIGN) ? 1 : reso;
+				for (auto k = 0u; k < reso; ++k)
+				{
+					CopyRowInner(GetXRowWithOverlap(dst_j, k + 1, lod), src->GetXRowWithOverlap(src_j, k + 1, lod), lod);
+				}
+			}
+		}
+		// face_sign:	false	-> 自身の-Z面へsrcの+Z面をコピー
+		//				true	-> 自身の+Z面へsrcの-Z面をコピー
+		template<bool FACE_SIGN>
+		void CopyOverlapFromSrcEdgeZ(const SimpleOverlapBothBitVoxelChunkT* src)
+		{
+			assert(src);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				const auto dst_k = (FACE_SIGN) ? reso + 1 : 0;
+				const auto src_k = (FACE_SIGN) ? 1 : reso;
+				for (auto j = 0u; j < reso; ++j)
+				{
+					CopyRowInner(GetXRowWithOverlap(j + 1, dst_k, lod), src->GetXRowWithOverlap(j + 1, src_k, lod), lod);
+				}
+			}
+		}
+
+		// FACE_SIGN: 自身のどのエッジにコピーするかをエッジ自身からみたエッジの符号で指定
+		template<bool FACE_SIGNX, bool FACE_SIGNY>
+		void CopyOverlapFromSrcEdgeXY(const SimpleOverlapBothBitVoxelChunkT* src)
+		{
+			assert(src);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				const auto dst_j = (FACE_SIGNY) ? reso + 1 : 0;
+				const auto src_j = (FACE_SIGNY) ? 1 : reso;
+				const auto dst_i = (FACE_SIGNX) ? reso + 1 : 0;
+				const auto src_i = (FACE_SIGNX) ? 1 : reso;
+				for (auto k = 0u; k < reso; ++k)
+				{
+					CopyRowBit(GetXRowWithOverlap(dst_j, k + 1, lod), dst_i, src->GetXRowWithOverlap(src_j, k + 1, lod), src_i);
+				}
+			}
+		}
+		// FACE_SIGN: 自身のどのエッジにコピーするかをエッジ自身からみたエッジの符号で指定
+		template<bool FACE_SIGNX, bool FACE_SIGNZ>
+		void CopyOverlapFromSrcEdgeXZ(const SimpleOverlapBothBitVoxelChunkT* src)
+		{
+			assert(src);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				const auto dst_k = (FACE_SIGNZ) ? reso + 1 : 0;
+				const auto src_k = (FACE_SIGNZ) ? 1 : reso;
+				const auto dst_i = (FACE_SIGNX) ? reso + 1 : 0;
+				const auto src_i = (FACE_SIGNX) ? 1 : reso;
+				for (auto j = 0u; j < reso; ++j)
+				{
+					CopyRowBit(GetXRowWithOverlap(j + 1, dst_k, lod), dst_i, src->GetXRowWithOverlap(j + 1, src_k, lod), src_i);
+				}
+			}
+		}
+		// FACE_SIGN: 自身のどのエッジにコピーするかをエッジ自身からみたエッジの符号で指定
+		template<bool FACE_SIGNY, bool FACE_SIGNZ>
+		void CopyOverlapFromSrcEdgeYZ(const SimpleOverlapBothBitVoxelChunkT* src)
+		{
+			assert(src);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				const auto dst_k = (FACE_SIGNZ) ? reso + 1 : 0;
+				const auto src_k = (FACE_SIGNZ) ? 1 : reso;
+				const auto dst_j = (FACE_SIGNY) ? reso + 1 : 0;
+				const auto src_j = (FACE_SIGNY) ? 1 : reso;
+
+				CopyRowInner(GetXRowWithOverlap(dst_j, dst_k, lod), src->GetXRowWithOverlap(src_j, src_k, lod), lod);
+			}
+		}
+		// FACE_SIGN: 自身のどのエッジにコピーするかをエッジ自身からみたエッジの符号で指定
+		template<bool FACE_SIGNX, bool FACE_SIGNY, bool FACE_SIGNZ>
+		void CopyOverlapFromSrcEdgeXYZ(const SimpleOverlapBothBitVoxelChunkT* src)
+		{
+			assert(src);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				const auto dst_k = (FACE_SIGNZ) ? reso + 1 : 0;
+				const auto src_k = (FACE_SIGNZ) ? 1 : reso;
+				const auto dst_j = (FACE_SIGNY) ? reso + 1 : 0;
+				const auto src_j = (FACE_SIGNY) ? 1 : reso;
+				const auto dst_i = (FACE_SIGNX) ? reso + 1 : 0;
+				const auto src_i = (FACE_SIGNX) ? 1 : reso;
+
+				CopyRowBit(GetXRowWithOverlap(dst_j, dst_k, lod), dst_i, src->GetXRowWithOverlap(src_j, src_k, lod), src_i);
+			}
+		}
+		// -----------------------------------------------------------------------------
+
+		// -----------------------------------------------------------------------------
+		// 境界スナップショット経由のオーバーラップ部コピー. 複数チャンクのオーバーラップ同期を並列に実行するために使用する.
+		// 近傍チャンクのRowを直接読むと, 近傍側が自身のX方向オーバーラップビットを書き換えている同一ワードを読むことになるため,
+		// 先に全ソースチャンクの境界Voxelをスナップショットへ取り出し, コピーはスナップショットからのみ読む.
+		//
+		// スナップショットのレイアウト(LOD毎):
+		//	[-X面][+X面] : X=1, X=reso の面. ワードkのビットjがVoxel(j,k). Z毎のRow群をビット行列転置して1ワードに面の1列を格納.
+		//	[-Y面][+Y面] : Y=1, Y=reso のRow. ワードkがRow(k).
+		//	[-Z面][+Z面] : Z=1, Z=reso のRow. ワードjがRow(j).
+		static constexpr unsigned int BOUNDARY_OFFSET(unsigned int lod)
+		{
+			unsigned int offset = 0;
+			for (unsigned int l = 0; l < lod; ++l)
+				offset += CHUNK_RESOLUTION(l) * 6;
+			return offset;
+		}
+		static constexpr unsigned int BOUNDARY_WORD_COUNT()
+		{
+			return BOUNDARY_OFFSET(LOD_COUNT());
+		}
+
+		// 境界Voxelをスナップショットへ書き出す. out_boundary は BOUNDARY_WORD_COUNT() ワード.
+		void StoreBoundary(RowType* out_boundary) const
+		{
+			assert(rows_);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				RowType* out_x = out_boundary + BOUNDARY_OFFSET(lod);
+				RowType* out_y = out_x + reso * 2;
+				RowType* out_z = out_y + reso * 2;
+
+				const RowType face_mask = (RowType(1) << reso) - 1;
+				for (auto k = 0u; k < reso; ++k)
+				{
+					// X面. Z=kのスライスのRow群をビット行列として転置し, X=1とX=resoの列を取り出す.
+					RowType matrix[ROW_BIT_WIDTH] = {};
+					const RowType* slice = &GetXRowWithOverlap(0, k + 1, lod);
+					for (auto j = 0u; j < reso + 2; ++j)
+						matrix[j] = slice[j];
+					TransposeRowMatrix(matrix);
+					out_x[k] = (matrix[1] >> 1) & face_mask;
+					out_x[reso + k] = (matrix[reso] >> 1) & face_mask;
+
+					out_y[k] = GetXRowWithOverlap(1, k + 1, lod);
+					out_y[reso + k] = GetXRowWithOverlap(reso, k + 1, lod);
+				}
+				for (auto j = 0u; j < reso; ++j)
+				{
+					out_z[j] = GetXRowWithOverlap(j + 1, 1, lod);
+					out_z[reso + j] = GetXRowWithOverlap(j + 1, reso, lod);
+				}
+			}
+		}
+
+		// 近傍チャンクの境界スナップショットから自身のオーバーラップ部へコピーする. 自身のRowのみ書き換える.
+		// ni,nj,nk : 自身からみた近傍チャンクの方向.
+		void CopyOverlapFromNeighborBoundary(const RowType* src_boundary, int ni, int nj, int nk)
+		{
+			assert(src_boundary);
+			assert(0 != ni || 0 != nj || 0 != nk);
+			for (auto lod = 0u; lod < LOD_COUNT(); ++lod)
+			{
+				const auto reso = CHUNK_RESOLUTION(lod);
+				// +方向の近傍からは近傍の-側境界, -方向の近傍からは近傍の+側境界を読む.
+				const RowType* src_x = src_boundary + BOUNDARY_OFFSET(lod) + ((0 < ni) ? 0 : reso);
+				const RowType* src_y = src_boundary + BOUNDARY_OFFSET(lod) + reso * 2 + ((0 < nj) ? 0 : reso);
+				const RowType* src_z = src_boundary + BOUNDARY_OFFSET(lod) + reso * 4 + ((0 < nk) ? 0 : reso);
+
+				const auto dst_i = (0 < ni) ? reso + 1 : 0;
+				const auto src_i = (0 < ni) ? 1 : reso;
+				const auto dst_j = (0 < nj) ? reso + 1 : 0;
+				const auto dst_k = (0 < nk) ? reso + 1 : 0;
+				const auto src_k = (0 < nk) ? 1 : reso;
+
+				if (0 != ni && 0 == nj && 0 == nk)
+				{
+					// X面. 面の1列をビット行列のdst_i行へ置いて転置し, 各Rowのdst_iビットへマスク付きで合成する.
+					const RowType dst_mask = ~(RowType(1) << dst_i);
+					for (auto k = 0u; k < reso; ++k)
+					{
+						RowType matrix[ROW_BIT_WIDTH] = {};
+						matrix[dst_i] = (src_x[k] << 1) & ROW_INNER_MASK(lod);
+						TransposeRowMatrix(matrix);
+						RowType* slice = &GetXRowWithOverlap(0, k + 1, lod);
+						for (auto j = 1u; j <= reso; ++j)
+							slice[j] = (slice[j] & dst_mask) | matrix[j];
+					}
+				}
+				else if (0 == ni && 0 != nj && 0 == nk)
+				{
+					for (auto k = 0u; k < reso; ++k)
+						CopyRowInner(GetXRowWithOverlap(dst_j, k + 1, lod), src_y[k], lod);
+				}
+				else if (0 == ni && 0 == nj && 0 != nk)
+				{
+					for (auto j = 0u; j < reso; ++j)
+						CopyRowInner(GetXRowWithOverlap(j + 1, dst_k, lod), src_z[j], lod);
+				}
+				else if (0 != ni && 0 != nj && 0 == nk)
+				{
+					for (auto k = 0u; k < reso; ++k)
+						CopyRowBit(GetXRowWithOverlap(dst_j, k + 1, lod), dst_i, src_y[k], src_i);
+				}
+				else if (0 != ni && 0 == nj && 0 != nk)
+				{
+					for (auto j = 0u; j < reso; ++j)
+						CopyRowBit(GetXRowWithOverlap(j + 1, dst_k, lod), dst_i, src_z[j], src_i);
+				}
+				else if (0 == ni && 0 != nj && 0 != nk)
+				{
+					CopyRowInner(GetXRowWithOverlap(dst_j, dst_k, lod), src_y[src_k - 1], lod);
+				}
+				else
+				{
+					CopyRowBit(GetXRowWithOverlap(dst_j, dst_k, lod), dst_i, src_y[src_k - 1], src_i);
+				}
+			}
+		}
+		// -----------------------------------------------------------------------------
+
+	private:
+		// 上位LODの2x2x2の論理和でLODのRowを生成するカーネル. 出力LODのZ位置lkの[lj_begin, lj_end]のRowを生成する.
+		// 上位LODのY方向に隣接する2Rowはメモリ上で連続しているため, RowTypeが32bitの場合は64bitワード単位で読み込み,
+		// 出力2Row分を1ワードにまとめてX方向の縮約を行う. 64bitワードの下位側が先頭のRowとなるリトルエンディアンを前提とする.
+		void ReduceLodRows(unsigned int lod, unsigned int lk, unsigned int lj_begin, unsigned int lj_end)
+		{
+			const auto parent_lod = lod - 1;
+			const auto parent_inner_mask = ROW_INNER_MASK(parent_lod);
+			// 上位LODのZ方向2スライスで, 出力lj_beginに対応する先頭Row.
+			const RowType* parent_rows_z0 = &GetXRowWithOverlap(lj_begin * 2 + 1, lk * 2 + 1, parent_lod);
+			const RowType* parent_rows_z1 = &GetXRowWithOverlap(lj_begin * 2 + 1, lk * 2 + 2, parent_lod);
+
+			auto lj = lj_begin;
+			if constexpr (sizeof(RowType) == sizeof(uint32_t))
+			{
+				constexpr uint64 LOWER_MASK = 0x00000000ffffffffull;
+				const uint64 parent_inner_mask_pair = uint64(parent_inner_mask) | (uint64(parent_inner_mask) << 32);
+				for (; lj + 1 <= lj_end; lj += 2)
+				{
+					const auto offset = (lj - lj_begin) * 2;
+					uint64 z0_rows01, z0_rows23, z1_rows01, z1_rows23;
+					memcpy(&z0_rows01, parent_rows_z0 + offset, sizeof(uint64));
+					memcpy(&z0_rows23, parent_rows_z0 + offset + 2, sizeof(uint64));
+					memcpy(&z1_rows01, parent_rows_z1 + offset, sizeof(uint64));
+					memcpy(&z1_rows23, parent_rows_z1 + offset + 2, sizeof(uint64));
+
+					// Z方向の論理和.
+					const uint64 rows01 = z0_rows01 | z1_rows01;
+					const uint64 rows23 = z0_rows23 | z1_rows23;
+					// Y方向の論理和. 下位32bitが出力lj, 上位32bitが出力lj+1.
+					const uint64 row_pair = ((rows01 | (rows01 >> 32)) & LOWER_MASK) | ((rows23 | (rows23 << 32)) & ~LOWER_MASK);
+					// オーバーラップ部を除いてX=0をbit0へ.
+					const uint64 inner_pair = (row_pair & parent_inner_mask_pair) >> 1;
+					// X方向の隣接2bitの論理和を偶数ビットに集めてから詰める. 下位16bitが出力lj, 上位16bitが出力lj+1.
+					const uint64 compact_pair = math::BitCompact1_u64(inner_pair | (inner_pair >> 1));
+
+					SetXRow(static_cast<RowType>(compact_pair & 0xffffu), lj, lk, lod);
+					SetXRow(static_cast<RowType>(compact_pair >> 16), lj + 1, lk, lod);
+				}
+			}
+			// 端数と64bitのRowは1Rowずつ.
+			for (; lj <= lj_end; ++lj)
+			{
+				const auto offset = (lj - lj_begin) * 2;
+				// YZ方向の2x2の論理和.
+				const RowType parent_row = ((parent_rows_z0[offset] | parent_rows_z0[offset + 1] | parent_rows_z1[offset] | parent_rows_z1[offset + 1]) & parent_inner_mask) >> 1;
+				// X方向の隣接2bitの論理和を偶数ビットに集めてから詰める.
+				SetXRow(CompactRowPair(parent_row | (parent_row >> 1)), lj, lk, lod);
+			}
+		}
+
+		// src_rowのsrc_bit位置のビットをdst_rowのdst_bit位置へコピー.
+		static void CopyRowBit(RowType& dst_row, unsigned int dst_bit, const RowType& src_row, unsigned int src_bit)
+		{
+			dst_row = (dst_row & ~(RowType(1) << dst_bit)) | (((src_row >> src_bit) & RowType(1)) << dst_bit);
+		}
+		// RowType幅の正方ビット行列を転置する. matrix[r]のビットcがmatrix[c]のビットrへ移る.
+		// 半分ずつのブロックを入れ替えるSWARでlog2(ROW_BIT_WIDTH)段.
+		static void TransposeRowMatrix(RowType* matrix)
+		{
+			RowType block_mask = ~RowType(0) >> (ROW_BIT_WIDTH / 2);
+			for (unsigned int width = ROW_BIT_WIDTH / 2; 0 != width; width >>= 1, block_mask ^= (block_mask << width))
+			{
+				for (unsigned int r = 0; r < ROW_BIT_WIDTH; r = ((r | width) + 1) & ~width)
+				{
+					const RowType t = ((matrix[r] >> width) ^ matrix[r | width]) & block_mask;
+					matrix[r | width] ^= t;
+					matrix[r] ^= (t << width);
+				}
+			}
+		}
+		// X方向のオーバーラップ部を除いたビットをコピー.
+		static void CopyRowInner(RowType& dst_row, const RowType& src_row, unsigned int lod)
+		{
+			dst_row = (dst_row & ~ROW_INNER_MASK(lod)) | (src_row & ROW_INNER_MASK(lod));
+		}
+		// 偶数ビットを下位へ詰める.
+		static RowType CompactRowPair(RowType v)
+		{
+			if constexpr (sizeof(RowType) > sizeof(uint32_t))
+				return static_cast<RowType>(math::BitCompact1_u64(v));
+			else
+				return static_cast<RowType>(math::BitCompact1(v));
+		}
+
+		void ReleaseRows()
+		{
+			if (rows_)
+			{
+				GetRowsPool().Free(rows_);
+				rows_ = nullptr;
+			}
+		}
+
+	private:
+		//	全Row情報. オーバーラップVoxel分を含む.
+		//		LOD0,LOD1...LODMax まで格納. GetRowsPoolから確保する.
+		RowType*				rows_ = nullptr;
+		// 圧縮状態のRow. 圧縮状態ではrows_は解放されている.
+		TArray<uint8>			compressed_rows_;
+
+		// 識別ID
+		FIntVector				id_ = FIntVector::ZeroValue;
+
+		unsigned int			current_lod_level_ = 0;
+
+		// 近傍Chunkとオーバーラップするエッジ部のDirtyフラグ
+		uint32_t				edge_voxel_changed_ = 0;
+
+		// 各方向の近傍Chunkの変更フラグ. 
+		// 変更があったChunkが自身のエッジ部の変更をチェックしてその方向の近傍Chunkのこのフラグへ変更通知をセットする.
+		// 各チャンクは近傍からオーバーラップ部をコピーしてくる.
+		uint32_t				neighbor_changed_ = 0;
+
+		// オーバーラップ同期でソースとして登録された同期回と, その回のスナップショット内の位置. 0は未登録.
+		uint32_t				overlap_sync_epoch_ = 0;
+		int						overlap_source_index_ = -1;
+
+		// ChunkのVoxel自体が変更されたか
+		bool					any_voxel_changed_ = false;
+
+		// ストアへ未保存の変更があるか
+		bool					store_dirty_ = false;
+
+		// 占有状態
+		VoxelChunkFillState::Type	fill_state_ = VoxelChunkFillState::Mixed;
+
+		// ステート
+		std::atomic < VoxelChunkState::Type> state_ = VoxelChunkState::Empty;
+	};
+
+	// LOD情報
+	template<unsigned int RESOLUTION, bool DEBUG_RANGE_CHECK>
+	const CalcLodOverlapedVoixelInfo<RESOLUTION, RESOLUTION, RESOLUTION> SimpleOverlapBothBitVoxelChunkT<RESOLUTION, DEBUG_RANGE_CHECK>::lod_info_ = {};
+
+
+	// チャンクのメッシュ生成結果.
+	struct VoxelChunkMeshData
+	{
+		TArray<FVector>		vtx;
+		TArray<int32>		tri;
+		TArray<FVector>		nor;
+		TArray<FColor>		col;
+
+		// メモリは保持したままクリア.
+		void Reset()
+		{
+			vtx.Reset();
+			tri.Reset();
+			nor.Reset();
+			col.Reset();
+		}
+	};
+	// チャンクIDとメッシュ生成結果.
+	struct VoxelChunkMeshResult
+	{
+		FIntVector			chunk_id = FIntVector::ZeroValue;
+		VoxelChunkMeshData	mesh;
+	};
+
+	// Voxelに対するRayCastの要求.
+	struct VoxelRayQuery
+	{
+		FVector				start = FVector::ZeroVector;
+		FVector				end = FVector::ZeroVector;
+	};
+	// Voxelに対するRayCastの結果.
+	struct VoxelRayHit
+	{
+		bool				is_hit = false;
+		// 始点から終点までを[0,1]としたヒット位置.
+		float				ray_t = 1.0f;
+		// ヒット位置(ワールド座標).
+		FVector				position = FVector::ZeroVector;
+		// ヒットしたVoxelの面の法線. 始点がVoxelの内部の場合はゼロ.
+		FVector				normal = FVector::ZeroVector;
+		// ヒットしたチャンクと, チャンク内のLOD0 Voxel座標.
+		FIntVector			chunk_id = FIntVector::ZeroValue;
+		FIntVector			voxel = FIntVector::ZeroValue;
+	};
+
+	// オーバーラップ同期のコピー要求. ソースチャンクの境界スナップショットと, 対象チャンクからみたソースチャンクの方向.
+	struct VoxelOverlapCopyRequest
+	{
+		int					source_index = 0;
+		int8				ni = 0;
+		int8				nj = 0;
+		int8				nk = 0;
+	};
+
+	// 処理統計の項目.
+	// Asyncの項目は前回のAsyncの結果. 時間はワーカーで並列実行した分の合計.
+	struct VoxelEngineStat
+	{
+		enum Type : uint8
+		{
+			// Async.
+			StreamInCount,			// StreamInで生成または読み込んだチャンク数.
+			StoreLoadCount,			// StreamInのうちストアから読み込んだチャンク数.
+			StreamOutCount,
+			EditChunkCount,			// 編集でVoxelが変化したチャンク数.
+			MeshCount,
+			NoiseMicroSec,
+			StoreLoadMicroSec,		// ストアからの読み込み. LOD生成を含む.
+			LodMicroSec,
+			MeshingMicroSec,
+			CollisionCount,			// コリジョン用メッシュを生成したチャンク数.
+			CollisionMicroSec,
+			AsyncMicroSec,			// Async全体の経過時間.
+
+			// Main.
+			OverlapSyncMicroSec,
+			MeshUploadCount,
+			MeshUploadMicroSec,
+			CollisionUploadCount,
+			SyncMicroSec,
+			TickMicroSec,
+
+			// Sync完了時点のキューの要素数.
+			StreamInQueueNum,
+			StreamOutQueueNum,
+			MeshRequestNum,
+			CollisionRequestNum,
+			VisibleChunkNum,		// 可視判定で可視となったチャンク数.
+			MeshDeferredNum,		// 不可視のためメッシュ生成を保留しているチャンク数.
+			RayCastCount,			// Tickで処理したRayCast要求数.
+			RayCastMicroSec,
+
+			Count
+		};
+	};
+
+	// Voxel編集要求.
+	// 形状内に中心が含まれるLOD0のVoxelを追加または削除する.
+	struct VoxelEditRequest
+	{
+		enum class Shape : uint8
+		{
+			Sphere,
+			Box,
+		};
+
+		Shape				shape = Shape::Sphere;
+		// true: 追加, false: 削除.
+		bool				fill = true;
+		// ワールド座標での中心.
+		FVector				center = FVector::ZeroVector;
+		// 各軸の半径. Sphereの場合はXを半径とし, 全軸同じ値とする.
+		FVector				extent = FVector::ZeroVector;
+	};
+	
+}
+
+
+// 非同期タスク.
+//	寿命はオーナーのAVoxelEngineが管理する.
+class VoxelEngineAsyncTask : public naga::FAsyncTaskBase
+{
+public:
+	VoxelEngineAsyncTask();
+	~VoxelEngineAsyncTask();
+
+	bool Initialize(AVoxelEngine* owner);
+	void Finalize();
+
+private:
+	// 非同期実行関数
+	void AsyncUpdate() override;
+private:
+	AVoxelEngine* owner_ = nullptr;
+};
+
+// Actor.
+UCLASS()
+class AVoxelEngine : public AActor
+{
+	GENERATED_BODY()
+	
+	friend class VoxelEngineAsyncTask;
+
+	// 1bitボクセル. オーバーラップ込のX軸Rowを1ワードで保持する.
+	//using ChunkType = naga::SimpleOverlapBothVoxelChunkT<unsigned char, 16, true>;
+	using ChunkType = naga::SimpleOverlapBothBitVoxelChunkT<16, true>;
+
+public:
+	AVoxelEngine();
+	~AVoxelEngine();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(EEndPlayReason::Type reason) override;
+
+public:
+	virtual void OnConstruction(const FTransform& transform) override;
+	virtual void Tick(float DeltaTime) override;
+
+	// EditorMode Tick Enable.
+	virtual bool ShouldTickIfViewportsOnly() const override;
+
+	float GetVoxelSize(unsigned int lod = 0) const;
+	FVector CalcChunkVoxelMinPosition(const FIntVector& chunk, const FIntVector& pos, unsigned int lod = 0) const;
+	FVector CalcChunkVoxelCenterPosition(const FIntVector& chunk, const FIntVector& pos, unsigned int lod = 0) const;
+
+	// Voxel編集. 要求はAsyncで適用され, 変更のあったチャンクとオーバーラップ部が変化した近傍チャンクのみメッシュを再生成する.
+	// StreamIn完了前のチャンクに対する編集は破棄される.
+	void EditVoxel(const naga::VoxelEditRequest& request);
+	// 球の範囲のVoxelを追加(fill=true)または削除(fill=false).
+	UFUNCTION(BlueprintCallable)
+		void EditVoxelSphere(const FVector& center, float radius, bool fill);
+	// 箱の範囲のVoxelを追加(fill=true)または削除(fill=false).
+	UFUNCTION(BlueprintCallable)
+		void EditVoxelBox(const FVector& center, const FVector& half_extent, bool fill);
+
+	// Voxelに対するRayCast. コリジョンのクッキングを待たずにVoxelデータを直接走査する.
+	// Asyncの実行中はVoxelが変更され得るため, 完了を待ってから実行する. 毎フレーム多数発行する場合はRequestRayCastVoxelを使用する.
+	bool RayCastVoxel(const FVector& start, const FVector& end, naga::VoxelRayHit& out_hit);
+	// 複数のRayCastをワーカーで並列に実行する. RayCastVoxelと同様にAsyncの完了を待つ.
+	void RayCastVoxelBatch(const TArray<naga::VoxelRayQuery>& queries, TArray<naga::VoxelRayHit>& out_hits);
+	UFUNCTION(BlueprintCallable)
+		bool LineTraceVoxel(const FVector& start, const FVector& end, FVector& out_position, FVector& out_normal);
+	// RayCast要求の登録. 次のTickでAsyncの停止中にまとめて並列実行される. 戻り値は結果配列のインデックス.
+	int32 RequestRayCastVoxel(const FVector& start, const FVector& end);
+	// 前回のTickで実行したRayCast要求の結果. インデックスはRequestRayCastVoxelの戻り値.
+	const TArray<naga::VoxelRayHit>& GetRayCastVoxelResults() const
+	{
+		return ray_cast_result_array_;
+	}
+
+private:
+	// 完全に破棄
+	void FinalizeVoxel();
+
+	UInstancedStaticMeshComponent* GetChunkMeshComponentFromPool();
+	void RestoreChunkMeshComponentToPool(UInstancedStaticMeshComponent* comp);
+
+
+	//void UpdateStreamInChunk(const TArray<FIntVector>& chunk_id_array);
+	//void UpdateStreamOutChunk(const TArray<FIntVector>& chunk_id_array);
+	void UpdateRenderChunk(const TArray<FIntVector>& render_dirty_chunk_id_array);
+
+	// デバッグ用のキューブ描画.
+	void UpdateRenderChunkDebugCube(const TArray<FIntVector>& render_dirty_chunk_id_array);
+	// チャンクの可視判定. 不可視チャンクのコンポーネントを非表示にし, メッシュ生成を保留する.
+	void UpdateChunkVisibility();
+	bool IsChunkVisible(const FIntVector& chunk_id) const
+	{
+		return !is_visibility_culling_ || visible_chunk_set_.Contains(chunk_id);
+	}
+	// Asyncで生成済みのメッシュを反映.
+	void UploadCompletedChunkMesh();
+	// Asyncで生成済みのコリジョン用メッシュを反映し, 物理範囲外のコリジョンを破棄.
+	void UploadCompletedChunkCollision();
+
+	// 処理統計をUE Stats, CSVプロファイラ, ベンチマークへ反映.
+	void PublishFrameStats();
+	// Asyncの処理統計へ加算. ワーカーから呼び出される.
+	void AddAsyncStat(naga::VoxelEngineStat::Type type, int64 value)
+	{
+		async_stats_[type].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	// ストリーミングベンチマーク.
+	void UpdateStreamBenchmark(float delta_time);
+	void FinishStreamBenchmark();
+
+	// チャンクのメッシュ生成. Asyncから呼び出される.
+	void BuildChunkMesh(const ChunkType& chunk, naga::VoxelChunkMeshData& out_mesh) const;
+	// コリジョン用メッシュ生成. Asyncから呼び出される.
+	void BuildChunkCollisionMesh(const ChunkType& chunk, naga::VoxelChunkMeshData& out_mesh) const;
+	// LODの異なる近傍チャンクとの境界のスカート生成. is_block_surface : メッシュがSurfaceNetsではなくブロック形状か.
+	void BuildChunkMeshSkirt(const ChunkType& chunk, unsigned int lod_level, uint32 skirt_face_mask, float skirt_length, bool is_block_surface, naga::VoxelChunkMeshData& out_mesh) const;
+	// 重視チャンクからの距離でLODを決定.
+	unsigned int CalcChunkLodLevel(const FIntVector& chunk_id, const FIntVector& important_chunk_position) const;
+	// SurfaceNetsによるポリゴン生成. 検証用の素朴な実装とRow単位のビット演算版.
+	void BuildChunkMeshSurfaceNets_NaiveVoxel(const ChunkType& chunk, unsigned int lod_level, naga::VoxelChunkMeshData& out_mesh) const;
+	void BuildChunkMeshSurfaceNets_BitCompressionVoxel(const ChunkType& chunk, unsigned int lod_level, naga::VoxelChunkMeshData& out_mesh) const;
+	// 同一平面上で隣接する露出面を矩形にまとめたブロック形状のポリゴン生成.
+	void BuildChunkMeshGreedy_BitCompressionVoxel(const ChunkType& chunk, unsigned int lod_level, naga::VoxelChunkMeshData& out_mesh) const;
+	// 生成したメッシュをProceduralMeshComponentへ設定.
+	void UploadChunkMesh(const FIntVector& chunk_id, const naga::VoxelChunkMeshData& mesh_data);
+	// 生成したコリジョン用メッシュを非表示のProceduralMeshComponentへ設定. クッキングは非同期.
+	void UploadChunkCollision(const FIntVector& chunk_id, const naga::VoxelChunkMeshData& mesh_data);
+
+	// 近傍チャンクから自身のオーバーラップ部へコピー.
+	static void CopyChunkOverlapFromNeighbor(ChunkType* target, const ChunkType* neightbor_chunk, int ni, int nj, int nk);
+	// LODピラミッドを加速構造としたRayCast本体. scratch_rowsは圧縮状態のチャンクの展開先.
+	bool RayCastVoxelImpl(const FVector& start, const FVector& end, naga::VoxelRayHit& out_hit, TArray<ChunkType::RowType>& scratch_rows) const;
+	// RayCast要求をワーカーで並列に実行する. Asyncの停止中に呼び出す.
+	void ExecuteRayCastVoxel(const TArray<naga::VoxelRayQuery>& queries, TArray<naga::VoxelRayHit>& out_hits) const;
+	// メッシュ生成要求の追加. 要求済みのチャンクは追加しない.
+	void AddMeshRequest(const FIntVector& chunk_id);
+	// 近傍更新フラグが立っているチャンク群のオーバーラップ部を並列に同期する. 近傍チャンクの境界スナップショットを作成してからコピーする.
+	void SyncChunkOverlapParallel(const TArray<ChunkType*>& target_chunk_array);
+
+	void SyncUpdate();
+	void AsyncUpdate();
+
+private:
+	void GenerateChunkFromNoise(ChunkType& out_chunk, float default_chunk_gen_noise_scale, int noise_octave_count) const;
+	// 編集要求をチャンクのLOD0へ適用. LODは更新しない. 変更があった場合はtrueを返し, LOD0での変更範囲を拡張する.
+	bool ApplyVoxelEdit(ChunkType& chunk, const naga::VoxelEditRequest& request, FIntVector& inout_dirty_min, FIntVector& inout_dirty_max) const;
+
+private:
+	// メインスレッドで変更してAsyncへ読み取るパラメータ
+	struct Main2AsyncParam
+	{
+		FVector									important_position_ = FVector::ZeroVector;
+		FVector									important_position_prev_ = FVector::ZeroVector;
+		// 視線方向. ストリーミングの優先度に利用する.
+		FVector									important_forward_ = FVector::ForwardVector;
+	};
+	Main2AsyncParam main2AsyncParam_[2];
+
+	// ストリーミングの優先度. 値が小さいほど優先. 単位はチャンク数.
+	// StreamInは重視位置からの距離に視線方向から外れるほど大きくなるペナルティを加算し, StreamOutは遠いものから処理する.
+	// キューの世代の基準位置と視線方向(stream_priority_position_, stream_priority_forward_)で計算する.
+	float CalcChunkStreamInPriority(const FIntVector& chunk_id, const FVector& position, const FVector& forward) const;
+	float CalcChunkStreamOutPriority(const FIntVector& chunk_id, const FVector& position) const;
+	// StreamInの視線方向ペナルティの最大値.
+	float CalcChunkStreamInViewPenaltyMax() const;
+
+	// 処理統計. Asyncで加算したものをWaitAsyncUpdate後にフレームの統計へ移す.
+	std::atomic<int64>							async_stats_[naga::VoxelEngineStat::Count] = {};
+	int64										frame_stats_[naga::VoxelEngineStat::Count] = {};
+
+	// デバッグ表示用のチャンク統計. Asyncの実行中はチャンクのメモリが再確保されるため, Asyncの起動前に集計する.
+	struct DebugChunkStats
+	{
+		int		chunk_count = 0;
+		int		sparse_chunk_count = 0;
+		int		compressed_chunk_count = 0;
+		size_t	chunk_memory_byte_size = 0;
+		naga::VoxelFixedBlockPool::Usage	rows_pool_usage = {};
+	};
+	DebugChunkStats								debug_chunk_stats_;
+
+	float										async_fast_terminate_sec_ = (1.0f / 60.0f) * 0.8f;// 非同期処理を適当な時間内に切り上げる
+	//float										async_fast_terminate_sec_ = 1000.0f;// 非同期処理が完全に終了するまで走らせる.
+
+public:
+	// どれくらい離れたチャンクまでストリームインするか(水平面)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int										stream_in_chunk_range_horizontal		= 3;
+	// どれくらい離れたチャンクまでストリームインするか(高さ方向)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int										stream_in_chunk_range_vertical			= 2;
+
+	// どれくらい離れたチャンクをストリームアウトするか
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int									stream_out_chunk_range					= 4;
+
+	// ストリーミング要求キューの取り出し順を毎回全要素の再計算とソートによる順序と比較し, 不一致をログ出力する. デバッグ用で重い.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool								debug_validate_stream_queue_			= false;
+
+	// StreamInの優先度を視線方向へ寄せる度合い. 0で距離のみ, 1で真後ろのチャンクはstream_in_chunk_range_horizontal分遠いものとして扱う.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float								stream_priority_view_weight_			= 1.0f;
+
+	// どれくらい離れたチャンクを圧縮状態で常駐させるか. 圧縮状態のチャンクはメッシュ生成や編集の際に展開される.
+	// stream_out_chunk_range以上の場合は圧縮しない.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int									compress_chunk_range					= 3;
+	// 時間予算に関わらず毎フレーム圧縮するチャンク数. StreamIn中も圧縮が進むようにする.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int									compress_chunk_min_per_frame			= 4;
+
+	// LOD0のVoxelサイズ.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float									voxel_size_ = 100.0f;
+
+private:
+
+	// メインのチャンク索引
+	// 重視位置のチャンクを中心としたリング窓内はリングバッファ3D配列で引くため, 窓内のチャンクの参照はハッシュ計算無しで済む.
+	naga::VoxelChunkIndexT<ChunkType*>		voxel_chunk_map_;
+	// チャンクオブジェクトのプール. StreamIn/Outの度にnew/deleteしないよう再利用する. Voxel本体はChunkType側のブロックプールで管理.
+	naga::VoxelChunkObjectPoolT<ChunkType>	chunk_pool_;
+
+	// ------------------------------------------------------------------------------------------------------------------------------------------
+	// InstancedMeshで可視化する場合
+	UPROPERTY()
+	UStaticMesh*										voxel_mesh_ = nullptr; // デバッグ表示用メッシュアセット
+
+	// マテリアル
+	UPROPERTY(EditAnywhere)
+	UMaterialInterface*									material_;
 
 	UPROPERTY()
 	TMap<FIntVector, UInstancedStaticMeshComponent*>	chunk_mesh_component_map_;
@@ -647,6 +1859,9 @@ private:
 	// ProceduralMeshで可視化する場合
 	UPROPERTY()
 	TMap<FIntVector, class UProceduralMeshComponent*>	chunk_proc_mesh_component_map_;
+	// コリジョン専用. 描画用とは別コンポーネントにして描画更新がクッキングを待たないようにする.
+	UPROPERTY()
+	TMap<FIntVector, class UProceduralMeshComponent*>	chunk_collision_component_map_;
 	// ------------------------------------------------------------------------------------------------------------------------------------------
 
 
@@ -656,14 +1871,91 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int													min_lod_level_ = 0;
 
+	// LODを1段階下げる距離(チャンク数).
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float												lod_distance_chunk_count_ = 2.0f;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float												default_chunk_noise_scale_ = 0.0006f;
 
+	// コリジョンを生成する範囲(重視チャンクからのチャンク数). 範囲から1チャンク以上離れたコリジョンは破棄する.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int													physics_chunk_range_ = 1;
+	// コリジョン用メッシュを生成するLOD. 描画のLODとは独立で, 粗くするほどポリゴン数とクッキング負荷が減る.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int													collision_lod_level_ = 1;
+	// 1回のAsyncで生成するコリジョン用メッシュの最大数. 残りは次回へ繰り越す.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int													collision_build_count_per_frame_ = 2;
+
+	// 視錐台と中身の詰まったチャンクによる遮蔽でチャンクの可視判定をし, 不可視チャンクの描画とメッシュ生成を省略する.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool												use_visibility_culling_ = true;
+
+	// チャンクのメッシュをSurfaceNetsではなく露出面を貪欲マージしたブロック形状で生成する.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool												use_greedy_mesh_ = false;
+
+	// Asyncでチャンク生成やメッシュ生成を並列実行するワーカー数. 0以下の場合はタスクグラフのワーカー数 + 1.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int													async_worker_count_ = 0;
+
+	// チャンクストアに保存したデータをすべて破棄する. 次回からStreamInはノイズから生成される.
+	UFUNCTION(CallInEditor, BlueprintCallable)
+		void ClearChunkStore();
+
+	// StreamOutしたチャンクをディスクに保存し, StreamInで読み込むか.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool												use_chunk_store_ = true;
+	// チャンクストアの名前. Saved/VoxelChunkStore/以下のディレクトリ名.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString												chunk_store_name_ = TEXT("VoxelEngine");
+
+	// メッシュ生成のベンチマーク. SurfaceNetsの素朴な実装とビット演算版, 貪欲マージ版の生成時間とポリゴン数を比較してログ出力する.
+	UFUNCTION(CallInEditor, BlueprintCallable)
+		void RunSurfaceNetsBenchmark();
+
+	// ベンチマークで生成するチャンクの範囲(水平面).
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int													benchmark_chunk_range_ = 2;
+	// ベンチマークの繰り返し回数.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int													benchmark_iteration_count_ = 8;
+
+	// ストリーミングのベンチマーク. 重視位置をパスに沿って移動させ, StreamIn要求からメッシュ反映までの遅延をパーセンタイルでログ出力する.
+	UFUNCTION(CallInEditor, BlueprintCallable)
+		void StartStreamBenchmark();
+	// ベンチマークで重視位置を移動させるパス(ワールド座標). 2点未満の場合は原点から+X方向へ直進する.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<FVector>										stream_benchmark_path_;
+	// ベンチマークの移動速度.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float												stream_benchmark_speed_ = 2000.0f;
+	// BeginPlayでベンチマークを開始する. -nullrhi等のヘッドレス実行用.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool												stream_benchmark_auto_start_ = false;
+	// ベンチマーク完了時にアプリケーションを終了する.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool												stream_benchmark_quit_on_finish_ = false;
+
 	// 非同期タスク
 	VoxelEngineAsyncTask									async_task_;
 
-	TArray<FIntVector>										stream_out_chunk_array_[2];
-	TArray<FIntVector>										stream_in_chunk_array_[2];
+	// チャンクの永続化.
+	naga::VoxelChunkStore									chunk_store_;
+
+	// Tickでリストアップし, Syncで優先度付きキューへ追加する.
+	TArray<FIntVector>										stream_out_chunk_array_;
+	TArray<FIntVector>										stream_in_chunk_array_;
+
+	// Asyncで処理するストリーミング要求. 未処理分は次回へ繰り越し.
+	naga::VoxelChunkStreamQueue								stream_out_queue_;
+	naga::VoxelChunkStreamQueue								stream_in_queue_;
+	// キューの世代を進めた時点の重視位置と視線方向. 一定以上変化したら世代を進める.
+	FVector													stream_priority_position_ = FVector::ZeroVector;
+	FVector													stream_priority_forward_ = FVector::ForwardVector;
+	// 範囲外のStreamIn要求を最後に破棄した時点の重視チャンク.
+	FIntVector												stream_in_purge_chunk_position_ = FIntVector(MAX_int32);
 
 	TArray<FIntVector>										stream_out_chunk_complete_array_;
 	TArray<FIntVector>										stream_in_chunk_complete_array_;
@@ -672,4 +1964,81 @@ public:
 	// 描画更新が必要なチャンクのID
 	TArray<FIntVector>										render_dirty_chunk_id_array_;
 
+	// ストリーミングベンチマークの状態.
+	struct StreamBenchmarkState
+	{
+		bool						is_running = false;
+		TArray<FVector>				path;
+		float						path_length = 0.0f;
+		float						distance = 0.0f;
+		double						start_sec = 0.0;
+		int							frame_count = 0;
+		// StreamIn要求時刻. メッシュ反映時に除去して遅延を記録する.
+		TMap<FIntVector, double>	request_sec_map;
+		TArray<double>				ready_latency_ms;
+		TArray<double>				frame_ms;
+		int64						stat_sum[naga::VoxelEngineStat::Count] = {};
+	};
+	StreamBenchmarkState									stream_benchmark_;
+
+	// Voxel編集要求. メインスレッドで追加し, Syncで非同期側へ移してAsyncで適用する.
+	TArray<naga::VoxelEditRequest>							edit_request_array_;
+	TArray<naga::VoxelEditRequest>							edit_apply_array_;
+	// Asyncで編集を適用し, Voxelが変化したチャンク.
+	TArray<FIntVector>										edit_chunk_complete_array_;
+
+	// LODを変更するチャンク. Asyncのメッシュ生成がLODを参照するためSyncで反映する.
+	TArray<TPair<FIntVector, unsigned int>>					lod_change_chunk_array_;
+
+	// Asyncでメッシュ生成するチャンクのID. Sync中に追加しAsyncで消費する. 未処理分は次回へ繰り越し.
+	TArray<FIntVector>										mesh_request_chunk_array_;
+	// mesh_request_chunk_array_と同じ要素のセット. 要求済みの判定用.
+	TSet<FIntVector>										mesh_request_chunk_set_;
+	// 圧縮候補のチャンク. 圧縮範囲外へ出た時とメッシュ生成の完了時に追加し, Asyncで消費する. 重複は取り出し時の判定で除外される.
+	TArray<FIntVector>										compress_candidate_chunk_array_;
+	// 圧縮候補の登録に用いた重視チャンク位置と圧縮範囲. 変化した場合に範囲外となった部分を候補に登録する.
+	FIntVector												compress_candidate_center_ = FIntVector::ZeroValue;
+	int														compress_candidate_range_ = -1;
+	// Asyncで生成したメッシュ. Asyncは[1]へ書き込み, Syncで入れ替えて描画側は[0]を反映する.
+	TArray<naga::VoxelChunkMeshResult>						mesh_complete_array_[2];
+
+	// 可視判定の視点. Tickで重視位置と合わせて更新する.
+	struct VisibilityView
+	{
+		bool						is_valid = false;
+		FVector						location = FVector::ZeroVector;
+		FRotator					rotation = FRotator::ZeroRotator;
+		// 水平画角.
+		float						fov_degree = 90.0f;
+		float						aspect_ratio = 1.0f;
+	};
+	VisibilityView											visibility_view_;
+	// 可視判定が有効か. 無効の場合はすべて可視として扱う.
+	bool													is_visibility_culling_ = false;
+	// 可視判定で可視となったチャンク.
+	TSet<FIntVector>										visible_chunk_set_;
+	// 不可視のためメッシュ生成を保留しているチャンク. 可視になったらメッシュ生成要求へ戻す.
+	TSet<FIntVector>										mesh_deferred_chunk_set_;
+
+	// 物理範囲内でコリジョンを要求済みのチャンク. 範囲外へ出たチャンクは除去され, 描画側でコリジョンを破棄する.
+	TSet<FIntVector>										collision_chunk_set_;
+	// Asyncでコリジョン用メッシュを生成するチャンクのID. 近いチャンクが末尾になるようにSyncで整列する.
+	TArray<FIntVector>										collision_request_chunk_array_;
+	// Asyncで生成したコリジョン用メッシュ. mesh_complete_array_と同様にダブルバッファ.
+	TArray<naga::VoxelChunkMeshResult>						collision_complete_array_[2];
+
+	// オーバーラップ同期用. フレーム毎の再確保を避けるため保持する.
+	// 近傍チャンクの境界スナップショット. ChunkType::BOUNDARY_WORD_COUNT()ワード単位でソースチャンク毎に格納.
+	TArray<ChunkType::RowType>								overlap_boundary_buffer_;
+	TArray<ChunkType*>										overlap_source_chunk_array_;
+	// ソースチャンクの重複登録判定に使う同期回. 同期毎に進め, チャンク側に記録した値と比較する.
+	uint32													overlap_sync_epoch_ = 0;
+	// 同期対象チャンク毎のコピー要求. overlap_copy_begin_[i]からoverlap_copy_begin_[i+1]までが対象チャンクiの要求.
+	TArray<naga::VoxelOverlapCopyRequest>					overlap_copy_array_;
+	TArray<int>												overlap_copy_begin_;
+
+	// Tickで実行するRayCast要求と, 前回のTickで実行した結果.
+	TArray<naga::VoxelRayQuery>								ray_cast_request_array_;
+	TArray<naga::VoxelRayHit>								ray_cast_result_array_;
+
 };
\ No newline at end of file
@@ -3,7 +3,122 @@
 
 #include "voxel_noise.h"
 
+#include "Math/VectorRegister.h"
+
 namespace naga
 {
-	
+	namespace
+	{
+		// FVectorと同じく倍精度で計算する. Hashは大きな値の小数部を利用するため単精度では結果が大きく変わってしまう.
+		using NoiseVectorRegister = VectorRegister4Double;
+
+		FORCEINLINE NoiseVectorRegister FracV(const NoiseVectorRegister& v)
+		{
+			return VectorSubtract(v, VectorFloor(v));
+		}
+
+		// TestVoxelNoise::Hashの4要素版. 位置はXYZ成分毎のレジスタで渡す.
+		FORCEINLINE NoiseVectorRegister HashV(const NoiseVectorRegister& x, const NoiseVectorRegister& y, const NoiseVectorRegister& z)
+		{
+			const NoiseVectorRegister scale = VectorSetFloat1(static_cast<double>(0.3183099f));
+			const NoiseVectorRegister fifty = VectorSetFloat1(50.0);
+
+			const auto px = VectorMultiply(FracV(VectorAdd(VectorMultiply(x, scale), VectorSetFloat1(static_cast<double>(0.71f)))), fifty);
+			const auto py = VectorMultiply(FracV(VectorAdd(VectorMultiply(y, scale), VectorSetFloat1(static_cast<double>(0.113f)))), fifty);
+			const auto pz = VectorMultiply(FracV(VectorAdd(VectorMultiply(z, scale), VectorSetFloat1(static_cast<double>(0.419f)))), fifty);
+
+			const auto h = VectorMultiply(VectorMultiply(VectorMultiply(px, py), pz), VectorAdd(VectorAdd(px, py), pz));
+
+			// スカラー版と同様に最後の小数部は単精度で計算する.
+			const auto hf = MakeVectorRegisterFloatFromDouble(h);
+			const auto frac_hf = VectorSubtract(hf, VectorFloor(hf));
+			return MakeVectorRegisterDouble(VectorSubtract(VectorMultiply(frac_hf, VectorSetFloat1(2.0f)), VectorOne()));
+		}
+
+		// TestVoxelNoise::Noise<false>の4要素版. 値のみ.
+		FORCEINLINE NoiseVectorRegister NoiseV(const NoiseVectorRegister& x, const NoiseVectorRegister& y, const NoiseVectorRegister& z)
+		{
+			const NoiseVectorRegister one = VectorOneDouble();
+
+			const auto ix = VectorFloor(x);
+			const auto iy = VectorFloor(y);
+			const auto iz = VectorFloor(z);
+			const auto ix1 = VectorAdd(ix, one);
+			const auto iy1 = VectorAdd(iy, one);
+			const auto iz1 = VectorAdd(iz, one);
+
+			// quintic
+			auto func_quintic = [](const NoiseVectorRegister& w)
+			{
+				const auto inner = VectorAdd(VectorMultiply(w, VectorSubtract(VectorMultiply(w, VectorSetFloat1(6.0)), VectorSetFloat1(15.0))), VectorSetFloat1(10.0));
+				return VectorMultiply(VectorMultiply(VectorMultiply(w, w), w), inner);
+			};
+			const auto ux = func_quintic(VectorSubtract(x, ix));
+			const auto uy = func_quintic(VectorSubtract(y, iy));
+			const auto uz = func_quintic(VectorSubtract(z, iz));
+
+			const auto a = HashV(ix, iy, iz);
+			const auto b = HashV(ix1, iy, iz);
+			const auto c = HashV(ix, iy1, iz);
+			const auto d = HashV(ix1, iy1, iz);
+			const auto e = HashV(ix, iy, iz1);
+			const auto f = HashV(ix1, iy, iz1);
+			const auto g = HashV(ix, iy1, iz1);
+			const auto h = HashV(ix1, iy1, iz1);
+
+			const auto k0 = a;
+			const auto k1 = VectorSubtract(b, a);
+			const auto k2 = VectorSubtract(c, a);
+			const auto k3 = VectorSubtract(e, a);
+			const auto k4 = VectorAdd(VectorSubtract(VectorSubtract(a, b), c), d);
+			const auto k5 = VectorAdd(VectorSubtract(VectorSubtract(a, c), e), g);
+			const auto k6 = VectorAdd(VectorSubtract(VectorSubtract(a, b), e), f);
+			// -a + b + c - d + e - f - g + h
+			const auto k7 = VectorSubtract(VectorAdd(VectorAdd(b, c), VectorAdd(e, h)), VectorAdd(VectorAdd(a, d), VectorAdd(f, g)));
+
+			auto v = VectorAdd(k0, VectorMultiply(k1, ux));
+			v = VectorAdd(v, VectorMultiply(k2, uy));
+			v = VectorAdd(v, VectorMultiply(k3, uz));
+			v = VectorAdd(v, VectorMultiply(VectorMultiply(k4, ux), uy));
+			v = VectorAdd(v, VectorMultiply(VectorMultiply(k5, uy), uz));
+			v = VectorAdd(v, VectorMultiply(VectorMultiply(k6, uz), ux));
+			v = VectorAdd(v, VectorMultiply(VectorMultiply(VectorMultiply(k7, ux), uy), uz));
+			return v;
+		}
+	}
+
+	void TestVoxelNoise::FbmRowX(const FVector& start, float step_x, int count, int octaves, float* out_values)
+	{
+		constexpr int LANE_COUNT = 4;
+
+		// Row内でYZは一定.
+		const auto y = VectorSetFloat1(static_cast<double>(start.Y));
+		const auto z = VectorSetFloat1(static_cast<double>(start.Z));
+		const auto lane_offset = VectorMultiply(MakeVectorRegisterDouble(0.0, 1.0, 2.0, 3.0), VectorSetFloat1(static_cast<double>(step_x)));
+
+		for (int i = 0; i < count; i += LANE_COUNT)
+		{
+			const auto x = VectorAdd(VectorSetFloat1(static_cast<double>(start.X) + static_cast<double>(step_x) * i), lane_offset);
+
+			double amp = 0.5;
+			NoiseVectorRegister sum = VectorZeroDouble();
+			auto tmp_x = x;
+			auto tmp_y = y;
+			auto tmp_z = z;
+			for (int oi = 0; oi < octaves; ++oi)
+			{
+				sum = VectorAdd(sum, VectorMultiply(VectorSetFloat1(amp), NoiseV(tmp_x, tmp_y, tmp_z)));
+				amp *= 0.5;
+				tmp_x = VectorAdd(tmp_x, tmp_x);
+				tmp_y = VectorAdd(tmp_y, tmp_y);
+				tmp_z = VectorAdd(tmp_z, tmp_z);
+			}
+
+			alignas(16) float tmp[LANE_COUNT];
+			VectorStoreAligned(MakeVectorRegisterFloatFromDouble(sum), tmp);
+			const int store_count = FMath::Min(LANE_COUNT, count - i);
+			for (int li = 0; li < store_count; ++li)
+				out_values[i + li] = tmp[li];
+		}
+	}
 }
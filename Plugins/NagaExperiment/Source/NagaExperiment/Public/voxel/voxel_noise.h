@@ -98,6 +98,12 @@ namespace naga
 			return FVector4(a, d.X, d.Y, d.Z);
 		}
 
+		// X方向に等間隔に並んだcount個の位置のfbm値(勾配無し)をまとめて計算する.
+		// Fbm<false>のバッチ版. SIMDレジスタの4要素単位で処理する.
+		// start : 先頭の位置, step_x : X方向の間隔, out_values : count個の出力先.
+		// [-1, +1]
+		static void FbmRowX(const FVector& start, float step_x, int count, int octaves, float* out_values);
+
 		// returns 3D fbm and its 3 derivatives
 		// FVector4( noise, noise_grad_x, noise_grad_y, noise_grad_z)
 		// [-1, +1]